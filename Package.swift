@@ -11,6 +11,7 @@ let package = Package(
     ],
     products: [
         .library(name: "ImproveAI", targets: ["utils", "ImproveAI"]),
+        .executable(name: "improve-compile", targets: ["improve-compile"]),
     ],
     targets: [
         .target(
@@ -18,6 +19,9 @@ let package = Package(
             path: "./Sources/utils",
             cSettings: [
                 .define("ImproveAI_VERSION", to: improveAIVersion),
+            ],
+            linkerSettings: [
+                .linkedLibrary("z"),
             ]),
         .target(
             name: "ImproveAI",
@@ -26,10 +30,24 @@ let package = Package(
             swiftSettings: [
                 .define("IMPROVE_AI_DEBUG", .when(configuration: .debug))
             ]),
+        .target(
+            name: "improve-compile",
+            dependencies: ["utils"],
+            path: "./Sources/improve-compile"),
+        // generated by improve-compile from a SyntheticModels model, see TestScorer
+        .target(
+            name: "CompiledModelFixtures",
+            dependencies: ["utils"],
+            path: "Tests/CompiledModelFixtures"),
+        // counts malloc calls for the allocation benchmarks in TestPerformance
+        .target(
+            name: "MallocCounter",
+            path: "Tests/MallocCounter"),
         .testTarget(
             name: "ImproveAITests",
-            dependencies: ["ImproveAI"],
+            dependencies: ["utils", "ImproveAI", "CompiledModelFixtures", "MallocCounter"],
             path: "Tests",
+            exclude: ["CompiledModelFixtures", "MallocCounter"],
             resources: [.process("Resources")]
         )
     ]
@@ -0,0 +1,81 @@
+//
+//  FeatureColumn.swift
+//
+//
+//  Created on 2023/11/27.
+//
+
+import Foundation
+
+/**
+ One property of every item in a batch, for scoring items that are already held column by column,
+ such as rows read from a database or a data frame, without building an `Encodable` value per item.
+ 
+ `path` is the property's key in the item, with dots for nested keys, so a column at `"brand.name"`
+ scores like items of the form `{"brand": {"name": ...}}`, and an empty path is the item itself.
+ Columns whose path the model doesn't use are skipped without reading their values.
+ */
+public struct FeatureColumn {
+    enum Values {
+        case double([Double])
+        case int64([Int64])
+        case strings(bytes: [UInt8], offsets: [Int])
+    }
+    
+    /// The key of the property in each item, dots separating nested keys, empty for the item itself.
+    public let path: String
+    
+    let values: Values
+    
+    /// The number of items in the column.
+    public var count: Int {
+        switch values {
+        case .double(let values):
+            return values.count
+        case .int64(let values):
+            return values.count
+        case .strings(_, let offsets):
+            return Swift.max(offsets.count - 1, 0)
+        }
+    }
+    
+    /**
+     A column of numbers. NaN marks an item without the property.
+     */
+    public static func double(_ path: String, _ values: [Double]) -> FeatureColumn {
+        return FeatureColumn(path: path, values: .double(values))
+    }
+    
+    /**
+     A column of integers, scored like the same numbers as `Double`.
+     */
+    public static func int64(_ path: String, _ values: [Int64]) -> FeatureColumn {
+        return FeatureColumn(path: path, values: .int64(values))
+    }
+    
+    /**
+     A column of strings stored back to back as UTF-8.
+     
+     - Parameters:
+       - path: The key of the property in each item.
+       - bytes: The UTF-8 bytes of all the strings.
+       - offsets: `count + 1` increasing offsets into `bytes`, item `i` being `bytes[offsets[i]..<offsets[i + 1]]`.
+     */
+    public static func strings(_ path: String, bytes: [UInt8], offsets: [Int]) -> FeatureColumn {
+        return FeatureColumn(path: path, values: .strings(bytes: bytes, offsets: offsets))
+    }
+    
+    /**
+     A column of strings, copied into a single UTF-8 buffer.
+     */
+    public static func strings(_ path: String, _ values: [String]) -> FeatureColumn {
+        var bytes: [UInt8] = []
+        var offsets = [0]
+        offsets.reserveCapacity(values.count + 1)
+        for var value in values {
+            value.withUTF8 { bytes.append(contentsOf: $0) }
+            offsets.append(bytes.count)
+        }
+        return FeatureColumn(path: path, values: .strings(bytes: bytes, offsets: offsets))
+    }
+}
@@ -69,9 +69,95 @@ public struct Ranker {
             return items
         }
     }
+    
+    /**
+     Rank the list of items from best to worst (highest to lowest scoring), scoring chunks of
+     them on up to `threadCount` threads.
+     
+     - Parameters:
+        - items: The list of items to rank.
+        - context: Extra JSON encodable context info that will be used with each of the item to get its score.
+        - threadCount: The maximum number of threads to score with.
+     - Returns: An array of ranked items, sorted by their scores in descending order.
+    */
+    public func rank<T, U>(_ items: [T], context: U?, threadCount: Int) -> [T] where T: Encodable, U: Encodable {
+        do {
+            let scores = try self.scorer.score(items, context: context, threadCount: threadCount)
+            return Self.rank_with_score(items: items, scores: scores)
+        } catch {
+            Logger.log("failed to score items: \(error)")
+            return items
+        }
+    }
+    
+    /**
+     Rank the list of items and return the best `topK` of them.
+     
+     With the native backends, items are scored one tree at a time and items that can't make
+     the top `topK` are dropped early, so only a few items are fully scored and sorted.
+     
+     - Parameters:
+        - items: The list of items to rank.
+        - topK: The maximum number of items to return.
+     - Returns: The best `topK` items, sorted by their scores in descending order.
+    */
+    public func rank<T>(_ items: [T], topK: Int) -> [T] where T: Encodable {
+        do {
+            let noise = Double.random(in: 0...1)
+            let scored = try self.scorer.scoreTopK(items: items, topK: topK, noise: noise)
+            return Self.rank_top_k(items: items, scored: scored, topK: topK)
+        } catch {
+            Logger.log("failed to score items: \(error)")
+            return Array(items.prefix(max(topK, 0)))
+        }
+    }
+    
+    /**
+     Rank the list of items and return the best `topK` of them.
+     
+     With the native backends, items are scored one tree at a time and items that can't make
+     the top `topK` are dropped early, so only a few items are fully scored and sorted.
+     
+     - Parameters:
+        - items: The list of items to rank.
+        - context: Extra JSON encodable context info that will be used with each of the item to get its score.
+        - topK: The maximum number of items to return.
+     - Returns: The best `topK` items, sorted by their scores in descending order.
+    */
+    public func rank<T, U>(_ items: [T], context: U?, topK: Int) -> [T] where T: Encodable, U: Encodable {
+        do {
+            let noise = Double.random(in: 0...1)
+            let scored = try self.scorer.scoreTopK(items: items, context: context, topK: topK, noise: noise)
+            return Self.rank_top_k(items: items, scored: scored, topK: topK)
+        } catch {
+            Logger.log("failed to score items: \(error)")
+            return Array(items.prefix(max(topK, 0)))
+        }
+    }
 }
 
 extension Ranker {
+    /**
+     Rank the scored subset of items and keep the best `topK`.
+     
+     - Parameters:
+        - items: The list of items that were scored.
+        - scored: Indexes in `items` and scores of the items that may rank in the top `topK`.
+        - topK: The maximum number of items to return.
+     - Returns: The best `topK` items, sorted by their scores in descending order.
+    */
+    static func rank_top_k<T: Encodable>(items: [T], scored: [(index: Int, score: Double)], topK: Int) -> [T] {
+        let ranked = top_k_indices(count: scored.count, topK: topK) { scored[$0].score }
+        
+        let rankedItems = ranked.map { items[scored[$0].index] }
+        
+        #if DEBUG && IMPROVE_AI_DEBUG
+        dump(scores: ranked.map { scored[$0].score }, items: rankedItems)
+        #endif
+        
+        return rankedItems
+    }
+    
     /**
      Rank the items based on their scores.
      
@@ -86,10 +172,7 @@ extension Ranker {
     static func rank_with_score<T: Encodable>(items: [T], scores: [Double]) -> [T] {
         assert(items.count == scores.count)
         
-        var indices: [Int] = []
-        for i in 0..<items.count {
-            indices.append(i)
-        }
+        var indices = Array(0..<items.count)
 
         // descending
         indices.sort { scores[$0] > scores[$1] }
@@ -104,6 +187,55 @@ extension Ranker {
         return rankedItems
     }
 
+    /**
+     Indexes in 0..<count of the `topK` highest scores, in descending order of score.
+     */
+    static func top_k_indices(count: Int, topK: Int, score: (Int) -> Double) -> [Int] {
+        let k = min(max(topK, 0), count)
+        if k == 0 {
+            return []
+        }
+        
+        // min-heap of the best k so far, the root is the one to evict next
+        var heap = [Int]()
+        heap.reserveCapacity(k)
+        for i in 0..<count {
+            let value = score(i)
+            if heap.count < k {
+                heap.append(i)
+                var child = heap.count - 1
+                while child > 0 {
+                    let parent = (child - 1) / 2
+                    if score(heap[parent]) <= value {
+                        break
+                    }
+                    heap.swapAt(parent, child)
+                    child = parent
+                }
+            } else if value > score(heap[0]) {
+                heap[0] = i
+                var parent = 0
+                while true {
+                    let left = 2 * parent + 1
+                    if left >= k {
+                        break
+                    }
+                    let right = left + 1
+                    let child = right < k && score(heap[right]) < score(heap[left]) ? right : left
+                    if score(heap[child]) >= value {
+                        break
+                    }
+                    heap.swapAt(parent, child)
+                    parent = child
+                }
+            }
+        }
+
+        // descending
+        heap.sort { score($0) > score($1) }
+        return heap
+    }
+
     static func dump<T: Encodable>(scores: [Double], items: [T]) {
         let leadingCount = 10
         let trailingCount = 10
@@ -7,6 +7,9 @@
 
 import Foundation
 import utils
+#if canImport(FoundationNetworking)
+import FoundationNetworking
+#endif
 
 fileprivate let modelNameRegex = "^[a-zA-Z0-9][\\w\\-.]{0,63}$"
 
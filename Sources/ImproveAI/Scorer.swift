@@ -6,15 +6,41 @@
 //
 
 import Foundation
-import CoreML
+import utils
 
 /**
  Scores items with optional context using a CoreML model.
+ 
+ A Scorer can be shared by any number of threads. The model and feature encoder are immutable
+ after init and the native backends score concurrently without locking.
  */
 public struct Scorer {
-    let modelUrl: URL
+    /**
+     How the model is evaluated.
+     */
+    public enum Backend {
+        /// Compile and run the model with CoreML. Only available on Apple platforms.
+        case coreML
+        /// Evaluate the tree ensemble of the model directly, without CoreML.
+        case native
+        /// Like `.native`, but evaluates with QuickScorer leaf bitvectors instead of
+        /// walking each tree. Can be faster for large ensembles of shallow trees.
+        case quickScorer
+        /// Like `.native`, but batches of items first resolve the branches on context features
+        /// once, then evaluate only the item branches left for each item. Faster when contexts
+        /// are large and many items are scored per call.
+        case contextPruning
+        
+        #if canImport(CoreML)
+        static let defaultBackend = Backend.coreML
+        #else
+        static let defaultBackend = Backend.native
+        #endif
+    }
+    
+    let modelUrl: URL?
     
-    private var model: MLModel
+    let predictor: Predictor
     
     private let metadata: ModelMetadata
     
@@ -22,8 +48,6 @@ public struct Scorer {
     
     private let featureNames: [String]
     
-    private let lockQueue = DispatchQueue(label: "Scorer.lockQueue")
-    
     /**
      Initialize a Scorer instance.
      
@@ -32,19 +56,143 @@ public struct Scorer {
      - Throws: An error if the model cannot be loaded or if the metadata cannot be extracted.
      */
     public init(modelUrl: URL) throws {
+        try self.init(modelUrl: modelUrl, backend: Backend.defaultBackend)
+    }
+    
+    /**
+     Initialize a Scorer instance.
+     
+     - Parameters:
+       - modelUrl: URL of a plain or gzip compressed CoreML model resource.
+       - backend: `.coreML`, or `.native`/`.quickScorer`/`.contextPruning` to evaluate the model's tree ensemble without CoreML.
+     - Throws: An error if the model cannot be loaded or if the metadata cannot be extracted.
+     */
+    public init(modelUrl: URL, backend: Backend) throws {
         self.modelUrl = modelUrl
         
-        let result = Self.loadModel(url: modelUrl)
-        if let error = result.error {
-            throw error
+        switch backend {
+        case .coreML:
+            #if canImport(CoreML)
+            self.predictor = try CoreMLPredictor(modelUrl: modelUrl)
+            #else
+            throw ImproveAIError.invalidArgument(reason: "CoreML is not available on this platform")
+            #endif
+        case .native:
+            self.predictor = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        case .quickScorer:
+            self.predictor = try TreeEnsemblePredictor(modelUrl: modelUrl, quickScorer: true)
+        case .contextPruning:
+            self.predictor = try TreeEnsemblePredictor(modelUrl: modelUrl, contextPruning: true)
         }
-        self.model = result.model!
         
-        self.metadata = try ModelMetadata(from: model.modelDescription.metadata[.creatorDefinedKey] as! [String : String])
-        self.featureNames = model.modelDescription.inputDescriptionsByName.keys.map { $0 }
+        self.metadata = try ModelMetadata(from: predictor.metadata)
+        self.featureNames = predictor.featureNames
+        self.featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: metadata.stringTables, modelSeed: metadata.seed)
+    }
+    
+    /**
+     Initialize a Scorer instance with a model compiled ahead of time.
+     
+     Run `swift run improve-compile <model.mlmodel.gz> <name> <directory>` to generate a C target
+     from a model, add it to your package and pass the `<name>` constant it declares. The compiled
+     model embeds the feature names and metadata, so the model file isn't needed at runtime.
+     
+     - Parameters:
+       - compiledModel: The `compiled_model_t` declared by the generated header.
+     - Throws: An error if the embedded metadata cannot be extracted.
+     */
+    public init(compiledModel: compiled_model_t) throws {
+        self.modelUrl = nil
+        self.predictor = try CompiledModelPredictor(model: compiledModel)
+        self.metadata = try ModelMetadata(from: predictor.metadata)
+        self.featureNames = predictor.featureNames
         self.featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: metadata.stringTables, modelSeed: metadata.seed)
     }
     
+    private init(scorer: Scorer, predictor: Predictor, featureEncoder: FeatureEncoder) {
+        self.modelUrl = scorer.modelUrl
+        self.predictor = predictor
+        self.metadata = scorer.metadata
+        self.featureEncoder = featureEncoder
+        self.featureNames = scorer.featureNames
+    }
+    
+    /**
+     Returns a Scorer sharing this one's model that merges score calls made concurrently from
+     different threads into a single prediction batch. Each call may wait up to `maxDelay` for
+     others to join its batch, trading that much latency for fewer, larger predictions.
+     
+     Calls are only merged through the returned Scorer and its copies, so share one instance.
+     
+     - Parameters:
+       - maxDelay: The longest a call waits for others to join its batch, in seconds.
+       - maxItems: A batch is predicted right away once it holds this many items.
+     - Returns: A batching Scorer.
+     */
+    public func batching(maxDelay: TimeInterval = 0.0005, maxItems: Int = 1000) -> Scorer {
+        return Scorer(scorer: self, predictor: BatchingPredictor(predictor: predictor, maxDelay: maxDelay, maxItems: maxItems), featureEncoder: featureEncoder)
+    }
+    
+    /**
+     Returns a Scorer sharing this one's model that remembers the encoded values of the strings it
+     sees, up to `capacity` distinct strings per string feature. Worth it when items draw their
+     string values, such as brands, categories or locales, from a small vocabulary.
+     
+     The caches are shared by copies of the returned Scorer and are safe to use from any thread.
+     Size them from `stringCacheStatistics`.
+     
+     - Parameters:
+       - capacity: The most strings each string feature keeps.
+     - Returns: A caching Scorer.
+     */
+    public func cachingStrings(capacity: Int = 1024) -> Scorer {
+        return Scorer(scorer: self, predictor: predictor, featureEncoder: featureEncoder.cachingStrings(capacity: capacity))
+    }
+    
+    /// Hits, misses and evictions of the string caches, nil unless this Scorer came from `cachingStrings(capacity:)`.
+    public var stringCacheStatistics: StringCacheStatistics? {
+        return featureEncoder.stringCacheStatistics
+    }
+    
+    /**
+     A Scorer that remembers how up to `capacity` recent contexts encode, so scoring again with a
+     context equal to one of them skips encoding it. Contexts are matched by a hash of their value.
+     The cache is shared by copies of the returned Scorer and is safe to use from any thread.
+     
+     - Parameters:
+       - capacity: The most contexts to keep.
+     - Returns: A caching Scorer.
+     */
+    public func cachingContexts(capacity: Int = 64) -> Scorer {
+        return Scorer(scorer: self, predictor: predictor, featureEncoder: featureEncoder.cachingContexts(capacity: capacity))
+    }
+    
+    /// Hits, misses and evictions of the context cache, nil unless this Scorer came from `cachingContexts(capacity:)`.
+    public var contextCacheStatistics: CacheStatistics? {
+        return featureEncoder.contextCacheStatistics
+    }
+    
+    /**
+     A Scorer that remembers how recently scored items encode, within about `maxBytes` of memory,
+     so scoring them again only adds the noise of the call to their cached features. Items are
+     matched by a hash of their value, or by the ids given to `score(_:ids:context:)`. Hashing
+     dictionaries, strings and numbers is cheaper than encoding them, other `Encodable` items are
+     hashed through JSONEncoder and gain the most when given ids. The cache is shared by copies of
+     the returned Scorer and is safe to use from any thread.
+     
+     - Parameters:
+       - maxBytes: About the most memory the cached items may take up.
+     - Returns: A caching Scorer.
+     */
+    public func cachingItems(maxBytes: Int = 16 << 20) -> Scorer {
+        return Scorer(scorer: self, predictor: predictor, featureEncoder: featureEncoder.cachingItems(maxBytes: maxBytes))
+    }
+    
+    /// Hits, misses and evictions of the item cache, nil unless this Scorer came from `cachingItems(maxBytes:)`.
+    public var itemCacheStatistics: CacheStatistics? {
+        return featureEncoder.itemCacheStatistics
+    }
+    
     /**
      Uses the model to score a list of items with the given context.
      
@@ -54,7 +202,7 @@ public struct Scorer {
      - Returns: An array of `Double` values representing the scores of the items.
      */
     public func score<T>(_ items: [T]) throws -> [Double] where T: Encodable {
-        let noise = Double(arc4random()) / Double(UINT32_MAX)
+        let noise = Double.random(in: 0...1)
         return try scoreInternal(items: items, context: nil, noise: noise)
     }
     
@@ -68,53 +216,229 @@ public struct Scorer {
      - Returns: An array of `Double` values representing the scores of the items.
      */
     public func score<T, U>(_ items: [T], context: U?) throws -> [Double] where T: Encodable, U: Encodable {
-        let noise = Double(arc4random()) / Double(UINT32_MAX)
+        let noise = Double.random(in: 0...1)
         return try scoreInternal(items: items, context: context, noise: noise)
     }
+    
+    /**
+     Uses the model to score a list of items, looking items up in the item cache by their ids instead
+     of by their value. An id has to keep naming the same content, give an item a new id when it
+     changes. Without `cachingItems(maxBytes:)` the ids are not used.
+     
+     - Parameters:
+      - items: The list of items to score.
+      - ids: An id for each of the items.
+     - Throws: An error if the items list is empty, if ids and items differ in count or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score<T, ID>(_ items: [T], ids: [ID]) throws -> [Double] where T: Encodable, ID: Hashable {
+        if ids.count != items.count {
+            throw ImproveAIError.invalidArgument(reason: "ids and items must have the same count")
+        }
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(items: items, ids: ids.map { AnyHashable($0) }, context: nil, noise: noise)
+    }
+    
+    /**
+     Uses the model to score a list of items with the given context, looking items up in the item
+     cache by their ids instead of by their value. An id has to keep naming the same content, give
+     an item a new id when it changes. Without `cachingItems(maxBytes:)` the ids are not used.
+     
+     - Parameters:
+      - items: The list of items to score.
+      - ids: An id for each of the items.
+      - context: Extra JSON encodable context info that will be used with each of the item to get its score.
+     - Throws: An error if the items list is empty, if ids and items differ in count or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score<T, U, ID>(_ items: [T], ids: [ID], context: U?) throws -> [Double] where T: Encodable, U: Encodable, ID: Hashable {
+        if ids.count != items.count {
+            throw ImproveAIError.invalidArgument(reason: "ids and items must have the same count")
+        }
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(items: items, ids: ids.map { AnyHashable($0) }, context: context, noise: noise)
+    }
+    
+    /**
+     Uses the model to score a list of items, encoding and evaluating chunks of them on up to
+     `threadCount` threads. Scores are the same as the single threaded `score(_:)`.
+     
+     - Parameters:
+      - items: The list of items to score.
+      - threadCount: The maximum number of threads to use.
+     - Throws: An error if the items list is empty or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score<T>(_ items: [T], threadCount: Int) throws -> [Double] where T: Encodable {
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(items: items, context: nil, noise: noise, threadCount: threadCount)
+    }
+    
+    /**
+     Uses the model to score a list of items with the given context, encoding and evaluating
+     chunks of them on up to `threadCount` threads. Scores are the same as the single threaded
+     `score(_:context:)`.
+     
+     - Parameters:
+      - items: The list of items to score.
+      - context: Extra JSON encodable context info that will be used with each of the item to get its score.
+      - threadCount: The maximum number of threads to use.
+     - Throws: An error if the items list is empty or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score<T, U>(_ items: [T], context: U?, threadCount: Int) throws -> [Double] where T: Encodable, U: Encodable {
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(items: items, context: context, noise: noise, threadCount: threadCount)
+    }
+    
+    /**
+     Uses the model to score items received as JSON, without decoding them into Swift values first.
+     The JSON is parsed straight into the model's features, and scores are the same as decoding
+     it with JSONSerialization and calling `score(_:context:)`.
+     
+     - Parameters:
+      - itemsJSON: A UTF-8 JSON array of the items to score.
+      - contextJSON: Optional UTF-8 JSON of the context, any JSON value.
+     - Throws: An error if the items list is empty, if either is not valid JSON or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score(itemsJSON: Data, contextJSON: Data? = nil) throws -> [Double] {
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(itemsJSON: itemsJSON, contextJSON: contextJSON, noise: noise)
+    }
+    
+    /**
+     Uses the model to score items given as columns, one per property, encoding each column in a
+     single pass instead of visiting the items one by one. Scores are the same as calling `score(_:)`
+     with items holding the same properties.
+     
+     - Parameters:
+      - columns: The properties of the items to score, all with the same count.
+     - Throws: An error if there are no items, if the columns differ in count or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score(columns: [FeatureColumn]) throws -> [Double] {
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(columns: columns, context: nil, noise: noise)
+    }
+    
+    /**
+     Uses the model to score items given as columns with the given context, encoding each column in
+     a single pass instead of visiting the items one by one. Scores are the same as calling
+     `score(_:context:)` with items holding the same properties.
+     
+     - Parameters:
+      - columns: The properties of the items to score, all with the same count.
+      - context: Extra JSON encodable context info that will be used with each of the item to get its score.
+     - Throws: An error if there are no items, if the columns differ in count or if there's an issue with the prediction.
+     - Returns: An array of `Double` values representing the scores of the items.
+     */
+    public func score<U>(columns: [FeatureColumn], context: U?) throws -> [Double] where U: Encodable {
+        let noise = Double.random(in: 0...1)
+        return try scoreInternal(columns: columns, context: context, noise: noise)
+    }
 }
 
 extension Scorer {
-    func scoreInternal(items: [Any], context: Any? = nil, noise: Double) throws -> [Double] {
+    // Items per chunk when scoring on multiple threads
+    static let parallelChunkSize = 512
+    
+    func scoreInternal(items: [Any], ids: [AnyHashable]? = nil, context: Any? = nil, noise: Double) throws -> [Double] {
         if items.isEmpty {
             throw ImproveAIError.emptyVariants
         }
                       
-        return try lockQueue.sync {
-            var featureVectors = try self.featureEncoder.encodeFeatureVectors(items: items, context: context, noise: noise)
-            
-            let batchProvider = MLArrayBatchProvider(array: featureVectors.map{ FeatureProvider(featureVector: $0, featureNames: featureNames, indexes: self.featureEncoder.featureIndexes) })
-            let predictions = try self.model.predictions(fromBatch: batchProvider)
-
-            var result = [Double](repeating: 0, count: predictions.count)
-            for i in 0..<predictions.count {
-                var value = predictions.features(at: i).featureValue(for: "target")!.doubleValue
-                // add a very small random number to randomly break ties
-                value += (Double(arc4random()) / Double(UINT32_MAX)) * pow(2, -23)
-                result[i] = value
-            }
-            return result
+        let features = try encodeSparseFeatures(items: items, ids: ids, context: context, noise: noise)
+        
+        var result = try self.predictor.predict(sparseFeatures: features)
+        for i in 0..<result.count {
+            // add a very small random number to randomly break ties
+            result[i] += Double.random(in: 0...1) * pow(2, -23)
         }
+        return result
     }
     
-    private static func loadModel(url: URL) -> (model: MLModel?, error: Error?) {
-        var model: MLModel?
-        var loadError: Error?
-        let group = DispatchGroup()
-        group.enter()
-        ModelLoader(url: url).loadAsync(url) { compiledModelURL, error in
-            if error != nil {
-                loadError = error
-                return
-            }
-            
-            do {
-                model = try MLModel(contentsOf: compiledModelURL!)
-            } catch {
-                loadError = error
+    func scoreInternal(items: [Any], context: Any? = nil, noise: Double, threadCount: Int) throws -> [Double] {
+        if items.count <= Self.parallelChunkSize || threadCount <= 1 {
+            return try scoreInternal(items: items, context: context, noise: noise)
+        }
+        
+        // the context is encoded once and shared by all chunks
+        let contextVector = try self.featureEncoder.encodeContextVector(context: context, noise: noise)
+        let items: [Any?] = items
+        
+        var result = [Double](repeating: 0, count: items.count)
+        try result.withUnsafeMutableBufferPointer { result in
+            try forEachChunk(count: items.count, chunkSize: Self.parallelChunkSize, threadCount: threadCount) { chunk in
+                let features = try self.featureEncoder.encodeSparseFeatures(items: items[chunk], contextVector: contextVector, noise: noise)
+                
+                let scores = try self.predictor.predict(sparseFeatures: features)
+                for (i, score) in zip(chunk, scores) {
+                    // add a very small random number to randomly break ties
+                    result[i] = score + Double.random(in: 0...1) * pow(2, -23)
+                }
             }
-            group.leave()
         }
-        group.wait()
-        return (model, loadError)
+        return result
+    }
+    
+    func scoreInternal(itemsJSON: Data, contextJSON: Data?, noise: Double) throws -> [Double] {
+        let features = try self.featureEncoder.encodeFeatureMatrix(itemsJSON: itemsJSON, contextJSON: contextJSON, noise: noise)
+        if features.rowCount == 0 {
+            throw ImproveAIError.emptyVariants
+        }
+        
+        var result = try self.predictor.predict(features: features)
+        for i in 0..<result.count {
+            // add a very small random number to randomly break ties
+            result[i] += Double.random(in: 0...1) * pow(2, -23)
+        }
+        return result
+    }
+    
+    func scoreInternal(columns: [FeatureColumn], context: Any? = nil, noise: Double) throws -> [Double] {
+        if columns.isEmpty || columns[0].count == 0 {
+            throw ImproveAIError.emptyVariants
+        }
+        
+        let contextVector = try self.featureEncoder.encodeContextVector(context: context, noise: noise)
+        let features = try self.featureEncoder.encodeFeatureMatrix(columns: columns, contextVector: contextVector, noise: noise)
+        
+        var result = try self.predictor.predict(features: features)
+        for i in 0..<result.count {
+            // add a very small random number to randomly break ties
+            result[i] += Double.random(in: 0...1) * pow(2, -23)
+        }
+        return result
+    }
+    
+    private func encodeSparseFeatures(items: [Any], ids: [AnyHashable]? = nil, context: Any?, noise: Double) throws -> SparseFeatureMatrix {
+        let contextVector = try self.featureEncoder.encodeContextVector(context: context, noise: noise)
+        let items: [Any?] = items
+        return try self.featureEncoder.encodeSparseFeatures(items: items[...], ids: ids?[...], contextVector: contextVector, noise: noise)
+    }
+    
+    /**
+     Scores the items that can still rank in the top `topK` once the tie breaking noise is added,
+     which may leave out items the predictor can prove to score lower.
+     
+     - Returns: Indexes in `items` and scores, unordered.
+     */
+    func scoreTopK(items: [Any], context: Any? = nil, topK: Int, noise: Double) throws -> [(index: Int, score: Double)] {
+        if items.isEmpty {
+            throw ImproveAIError.emptyVariants
+        }
+        if topK <= 0 {
+            throw ImproveAIError.invalidArgument(reason: "topK must be positive")
+        }
+        
+        let features = try encodeSparseFeatures(items: items, context: context, noise: noise)
+        
+        var result = try self.predictor.predictTopK(sparseFeatures: features, k: topK, margin: pow(2, -23))
+        for i in 0..<result.count {
+            // add a very small random number to randomly break ties
+            result[i].score += Double.random(in: 0...1) * pow(2, -23)
+        }
+        return result
     }
 }
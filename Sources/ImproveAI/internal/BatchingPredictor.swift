@@ -0,0 +1,170 @@
+//
+//  BatchingPredictor.swift
+//
+//
+//  Created on 2023/9/4.
+//
+
+import Foundation
+
+/**
+ Merges concurrent predict calls into one batch for the wrapped predictor.
+ 
+ The first call to arrive while no batch is collecting becomes the leader. It waits until
+ `maxDelay` has passed or `maxItems` feature vectors are pending, predicts every pending call
+ in one batch and hands each caller its slice of the results. Calls arriving while a batch is
+ being predicted start the next batch.
+ 
+ A predictor that prunes context branches reads the context of a whole batch from its first row,
+ so for one of those only calls with the same context values are merged.
+ */
+final class BatchingPredictor: Predictor {
+    private final class Request {
+        let features: FeatureMatrix
+        
+        var result: Result<[Double], Error>?
+        
+        init(features: FeatureMatrix) {
+            self.features = features
+        }
+    }
+    
+    let predictor: Predictor
+    
+    let maxDelay: TimeInterval
+    
+    let maxItems: Int
+    
+    // 1 for the features the wrapped predictor prunes as context, nil if it doesn't prune
+    private let contextFeatures: [UInt8]?
+    
+    var featureNames: [String] {
+        predictor.featureNames
+    }
+    
+    var metadata: [String : String] {
+        predictor.metadata
+    }
+    
+    private let condition = NSCondition()
+    
+    // guarded by condition
+    private var pending: [Request] = []
+    
+    private var pendingItems = 0
+    
+    private var collecting = false
+    
+    private var predictedBatches = 0
+    
+    /// Number of batches predicted so far
+    var batchCount: Int {
+        condition.lock()
+        defer { condition.unlock() }
+        return predictedBatches
+    }
+    
+    init(predictor: Predictor, maxDelay: TimeInterval, maxItems: Int) {
+        self.predictor = predictor
+        self.maxDelay = maxDelay
+        self.maxItems = maxItems
+        self.contextFeatures = (predictor as? TreeEnsemblePredictor)?.contextFeatures
+    }
+    
+    func predict(featureVectors: [[Double]]) throws -> [Double] {
+        return try predict(features: FeatureMatrix(featureVectors: featureVectors, featureCount: featureNames.count))
+    }
+    
+    func predict(features: FeatureMatrix) throws -> [Double] {
+        let request = Request(features: features)
+        
+        condition.lock()
+        pending.append(request)
+        pendingItems += features.rowCount
+        
+        if collecting {
+            if pendingItems >= maxItems {
+                // wake the leader early
+                condition.broadcast()
+            }
+            while request.result == nil {
+                condition.wait()
+            }
+            condition.unlock()
+            return try request.result!.get()
+        }
+        
+        collecting = true
+        let deadline = Date(timeIntervalSinceNow: maxDelay)
+        while pendingItems < maxItems && condition.wait(until: deadline) {
+        }
+        let batch = pending
+        pending = []
+        pendingItems = 0
+        collecting = false
+        predictedBatches += 1
+        condition.unlock()
+        
+        var results = [Result<[Double], Error>](repeating: .success([]), count: batch.count)
+        if batch.count == 1 {
+            results[0] = Result { try predictor.predict(features: features) }
+        } else {
+            for group in mergeableGroups(batch) {
+                do {
+                    let merged = FeatureMatrix(concatenating: group.map { batch[$0].features }, featureCount: features.featureCount)
+                    let scores = try predictor.predict(features: merged)
+                    var offset = 0
+                    for i in group {
+                        let rowCount = batch[i].features.rowCount
+                        results[i] = .success(Array(scores[offset..<offset + rowCount]))
+                        offset += rowCount
+                    }
+                } catch {
+                    for i in group {
+                        results[i] = .failure(error)
+                    }
+                }
+            }
+        }
+        
+        condition.lock()
+        for (request, result) in zip(batch, results) {
+            request.result = result
+        }
+        condition.broadcast()
+        condition.unlock()
+        
+        return try request.result!.get()
+    }
+    
+    // Indexes into batch of the requests that can be predicted together, in order of arrival
+    private func mergeableGroups(_ batch: [Request]) -> [[Int]] {
+        guard let contextFeatures = contextFeatures else {
+            return [Array(batch.indices)]
+        }
+        var groups: [[Int]] = []
+        var groupOfContext: [[UInt32] : Int] = [:]
+        for (i, request) in batch.enumerated() {
+            // bit patterns, so that missing (NaN) context features compare equal
+            let context: [UInt32] = request.features.rowCount == 0 ? [] : zip(request.features.row(0), contextFeatures).compactMap { value, isContext in
+                isContext != 0 ? value.bitPattern : nil
+            }
+            if let group = groupOfContext[context] {
+                groups[group].append(i)
+            } else {
+                groupOfContext[context] = groups.count
+                groups.append([i])
+            }
+        }
+        return groups
+    }
+    
+    func predictTopK(featureVectors: [[Double]], k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        // early exit ranking works per call, there's nothing to gain from merging
+        return try predictor.predictTopK(featureVectors: featureVectors, k: k, margin: margin)
+    }
+    
+    func predictTopK(features: FeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        return try predictor.predictTopK(features: features, k: k, margin: margin)
+    }
+}
@@ -0,0 +1,56 @@
+//
+//  CompiledModelPredictor.swift
+//
+//
+//  Created on 2023/8/14.
+//
+
+import Foundation
+import utils
+
+/**
+ Evaluates a tree ensemble compiled ahead of time by improve-compile.
+ */
+struct CompiledModelPredictor: Predictor {
+    let model: compiled_model_t
+    
+    let featureNames: [String]
+    
+    let metadata: [String : String]
+    
+    init(model: compiled_model_t) throws {
+        guard model.score != nil else {
+            throw ImproveAIError.invalidModel(reason: "compiled model has no score function")
+        }
+        self.model = model
+        self.featureNames = (0..<model.feature_count).map { String(cString: model.feature_names[$0]!) }
+        self.metadata = (0..<model.metadata_count).reduce(into: [String : String]()) { partialResult, i in
+            partialResult[String(cString: model.metadata_keys[i]!)] = String(cString: model.metadata_values[i]!)
+        }
+    }
+    
+    func predict(featureVectors: [[Double]]) throws -> [Double] {
+        return try predict(features: FeatureMatrix(featureVectors: featureVectors, featureCount: featureNames.count))
+    }
+    
+    func predict(features: FeatureMatrix) throws -> [Double] {
+        var result = [Double](repeating: 0, count: features.rowCount)
+        features.values.withUnsafeBufferPointer { rows in
+            result.withUnsafeMutableBufferPointer { out in
+                model.score(rows.baseAddress, features.rowCount, out.baseAddress)
+            }
+        }
+        return result
+    }
+    
+    func predict(sparseFeatures features: SparseFeatureMatrix) throws -> [Double] {
+        var result = [Double](repeating: 0, count: features.rowCount)
+        try result.withUnsafeMutableBufferPointer { out in
+            // one row at a time, so only the features of each item are written
+            try features.forEachRow { r, row in
+                model.score(row.baseAddress, 1, out.baseAddress! + r)
+            }
+        }
+        return result
+    }
+}
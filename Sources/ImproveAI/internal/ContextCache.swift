@@ -0,0 +1,88 @@
+//
+//  ContextCache.swift
+//
+//
+//  Created on 2023/12/11.
+//
+
+import Foundation
+import utils
+
+/**
+ Encoded contexts of a Scorer, keyed by a fingerprint of the context value, up to capacity of them.
+ 
+ A context is cached as the features it writes without noise, so a hit only has to add the noise
+ of the current call. Eviction works like StringCache, in two generations, which keeps contexts in
+ steady use and drops the least recently used ones first.
+ */
+final class ContextCache {
+    /**
+     The features a context writes, before noise.
+     */
+    struct Row {
+        let indexes: [Int]
+        
+        let values: [Double]
+    }
+    
+    let capacity: Int
+    
+    private var recent: [UInt64 : Row] = [:]
+    
+    private var older: [UInt64 : Row] = [:]
+    
+    private var hits = 0
+    
+    private var misses = 0
+    
+    private var evictions = 0
+    
+    private let lock = NSLock()
+    
+    init(capacity: Int) {
+        self.capacity = max(capacity, 2)
+    }
+    
+    /**
+     The cached row of the context with this fingerprint, or encode() remembered for next time.
+     */
+    func row(for fingerprint: UInt64, encode: () throws -> Row) rethrows -> Row {
+        lock.lock()
+        if let row = recent[fingerprint] {
+            hits += 1
+            lock.unlock()
+            return row
+        }
+        if let row = older.removeValue(forKey: fingerprint) {
+            hits += 1
+            insert(fingerprint, row)
+            lock.unlock()
+            return row
+        }
+        misses += 1
+        lock.unlock()
+        
+        // encoded outside the lock, a racing thread at worst encodes the same context twice
+        let row = try encode()
+        
+        lock.lock()
+        insert(fingerprint, row)
+        lock.unlock()
+        return row
+    }
+    
+    var statistics: CacheStatistics {
+        lock.lock()
+        defer { lock.unlock() }
+        return CacheStatistics(hits: hits, misses: misses, evictions: evictions, count: recent.count + older.count)
+    }
+    
+    private func insert(_ fingerprint: UInt64, _ row: Row) {
+        if recent.count >= capacity / 2 {
+            evictions += older.count
+            older = recent
+            recent = [:]
+        }
+        recent[fingerprint] = row
+    }
+}
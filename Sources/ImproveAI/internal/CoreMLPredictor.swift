@@ -0,0 +1,121 @@
+//
+//  CoreMLPredictor.swift
+//
+//
+//  Created on 2023/7/24.
+//
+
+#if canImport(CoreML)
+import Foundation
+import CoreML
+
+struct CoreMLPredictor: Predictor {
+    private enum Input {
+        // a double input per feature, looked up by name
+        case features(FeatureSchema)
+        
+        // the feature vector as a single Float32 MLMultiArray input
+        case multiArray(name: String, names: Set<String>, shape: [NSNumber])
+    }
+    
+    let model: MLModel
+    
+    let featureNames: [String]
+    
+    let metadata: [String : String]
+    
+    private let input: Input
+    
+    // MLModel instances are only documented safe for use by one thread at a time
+    private let lockQueue = DispatchQueue(label: "CoreMLPredictor.lockQueue")
+    
+    init(modelUrl: URL) throws {
+        let result = Self.loadModel(url: modelUrl)
+        if let error = result.error {
+            throw error
+        }
+        self.model = result.model!
+        self.metadata = model.modelDescription.metadata[.creatorDefinedKey] as! [String : String]
+        
+        let inputs = model.modelDescription.inputDescriptionsByName
+        // without the feature names a single input is taken for a feature like any other, as it always was
+        if inputs.count == 1, let only = inputs.first, only.value.type == .multiArray, let json = metadata[ModelMetadata.featureNamesKey] {
+            let (name, description) = only
+            guard let names = try? JSONDecoder().decode([String].self, from: Data(json.utf8)) else {
+                throw ImproveAIError.invalidModel(reason: "'\(ModelMetadata.featureNamesKey)' is not a JSON array of strings")
+            }
+            let constraintShape = description.multiArrayConstraint?.shape ?? []
+            let shape = constraintShape.isEmpty ? [NSNumber(value: names.count)] : constraintShape
+            guard shape.reduce(1, { $0 * $1.intValue }) == names.count else {
+                throw ImproveAIError.invalidModel(reason: "input '\(name)' of shape \(shape) doesn't hold \(names.count) features")
+            }
+            self.featureNames = names
+            self.input = .multiArray(name: name, names: [name], shape: shape)
+        } else {
+            self.featureNames = inputs.keys.map { $0 }
+            self.input = .features(FeatureSchema(names: featureNames))
+        }
+    }
+    
+    func predict(featureVectors: [[Double]]) throws -> [Double] {
+        // narrowed to Float32 like CoreML does with double inputs
+        return try predict(features: FeatureMatrix(featureVectors: featureVectors, featureCount: featureNames.count))
+    }
+    
+    func predict(features: FeatureMatrix) throws -> [Double] {
+        let providers: [MLFeatureProvider]
+        switch input {
+        case .features(let schema):
+            providers = (0..<features.rowCount).map { FeatureProvider(features: features, row: $0, schema: schema) }
+        case let .multiArray(name, names, shape):
+            // the whole batch in one array, each provider a view of its row
+            let batch = try MLMultiArray(shape: [NSNumber(value: features.rowCount), NSNumber(value: features.featureCount)], dataType: .float32)
+            let rowStride = batch.strides[0].intValue
+            features.values.withUnsafeBufferPointer { values in
+                guard let values = values.baseAddress else {
+                    return
+                }
+                let rows = batch.dataPointer.bindMemory(to: Float.self, capacity: features.rowCount * rowStride)
+                for r in 0..<features.rowCount {
+                    (rows + r * rowStride).assign(from: values + r * features.featureCount, count: features.featureCount)
+                }
+            }
+            providers = try (0..<features.rowCount).map {
+                try MultiArrayFeatureProvider(batch: batch, row: $0, inputName: name, inputNames: names, shape: shape)
+            }
+        }
+        let batchProvider = MLArrayBatchProvider(array: providers)
+        let predictions = try lockQueue.sync {
+            try self.model.predictions(fromBatch: batchProvider)
+        }
+        
+        var result = [Double](repeating: 0, count: predictions.count)
+        for i in 0..<predictions.count {
+            result[i] = predictions.features(at: i).featureValue(for: "target")!.doubleValue
+        }
+        return result
+    }
+    
+    private static func loadModel(url: URL) -> (model: MLModel?, error: Error?) {
+        var model: MLModel?
+        var loadError: Error?
+        let group = DispatchGroup()
+        group.enter()
+        ModelLoader(url: url).loadAsync(url) { compiledModelURL, error in
+            if error != nil {
+                loadError = error
+                return
+            }
+            
+            do {
+                model = try MLModel(contentsOf: compiledModelURL!)
+            } catch {
+                loadError = error
+            }
+            group.leave()
+        }
+        group.wait()
+        return (model, loadError)
+    }
+}
+#endif
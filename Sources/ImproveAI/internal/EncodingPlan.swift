@@ -0,0 +1,130 @@
+//
+//  EncodingPlan.swift
+//
+//
+//  Created on 2023/9/25.
+//
+
+import Foundation
+
+/**
+ The key paths an Encodable type has emitted under a path, with their feature indexes resolved.
+ 
+ Each node is a path. Keyed children are kept in the order they were encoded, so an item of the
+ same type usually finds its next key at the next position and only compares two short strings.
+ A key out of order is looked up by name. Nothing here builds a path string or hashes a full
+ path once the plan exists.
+ 
+ A plan is only mutated while it's being recorded and is read only once published, so published
+ plans can be shared by threads without locking.
+ */
+final class EncodingPlan {
+    let path: String
+    
+    // featureIndexes[path], nil when the model doesn't use it
+    let featureIndex: Int?
+    
+    private var keys: [String] = []
+    
+    private var keyed: [EncodingPlan] = []
+    
+    private var keyedPositions: [String : Int] = [:]
+    
+    private var unkeyed: [EncodingPlan] = []
+    
+    init(path: String, featureIndexes: [String : Int]) {
+        self.path = path
+        self.featureIndex = featureIndexes[path]
+    }
+    
+    private init(copying plan: EncodingPlan) {
+        self.path = plan.path
+        self.featureIndex = plan.featureIndex
+        self.keys = plan.keys
+        self.keyed = plan.keyed.map { EncodingPlan(copying: $0) }
+        self.keyedPositions = plan.keyedPositions
+        self.unkeyed = plan.unkeyed.map { EncodingPlan(copying: $0) }
+    }
+    
+    /**
+     A deep copy to record more paths into without touching a published plan.
+     */
+    func copy() -> EncodingPlan {
+        return EncodingPlan(copying: self)
+    }
+    
+    /**
+     The child for key, expected at position. position moves past the child that was found.
+     */
+    func child(forKey key: String, position: inout Int) -> EncodingPlan? {
+        if position < keys.count && keys[position] == key {
+            position += 1
+            return keyed[position - 1]
+        }
+        guard let found = keyedPositions[key] else {
+            return nil
+        }
+        position = found + 1
+        return keyed[found]
+    }
+    
+    func child(at index: Int) -> EncodingPlan? {
+        return index < unkeyed.count ? unkeyed[index] : nil
+    }
+    
+    /**
+     Records a new child for key at position, the order the item being recorded encodes it in.
+     */
+    func addChild(forKey key: String, position: inout Int, featureIndexes: [String : Int]) -> EncodingPlan {
+        let child = EncodingPlan(path: "\(path).\(key)", featureIndexes: featureIndexes)
+        position = min(position, keys.count)
+        keys.insert(key, at: position)
+        keyed.insert(child, at: position)
+        for i in position..<keys.count {
+            keyedPositions[keys[i]] = i
+        }
+        position += 1
+        return child
+    }
+    
+    /**
+     Records a new child for index. Unkeyed containers encode their elements in order, so index
+     is always the next one.
+     */
+    func addChild(at index: Int, featureIndexes: [String : Int]) -> EncodingPlan {
+        let child = EncodingPlan(path: "\(path).\(index)", featureIndexes: featureIndexes)
+        unkeyed.append(child)
+        return child
+    }
+}
+
+/**
+ Published plans by item type and path. A plan is recorded from the first item of a type and
+ re-recorded from an item that emits paths it doesn't have, up to maxRevisions times, which
+ covers optionals that were nil and arrays that were shorter in earlier items. Types whose shape
+ keeps changing stop being re-recorded and encode their unplanned paths by string.
+ */
+final class EncodingPlanCache {
+    static let maxRevisions = 8
+    
+    private struct Key: Hashable {
+        let type: ObjectIdentifier
+        let path: String
+    }
+    
+    private var plans: [Key : (plan: EncodingPlan, revision: Int)] = [:]
+    
+    private let lock = NSLock()
+    
+    func plan(for type: Any.Type, path: String) -> (plan: EncodingPlan, revision: Int)? {
+        lock.lock()
+        defer { lock.unlock() }
+        return plans[Key(type: ObjectIdentifier(type), path: path)]
+    }
+    
+    func publish(_ plan: EncodingPlan, revision: Int, for type: Any.Type, path: String) {
+        lock.lock()
+        defer { lock.unlock() }
+        plans[Key(type: ObjectIdentifier(type), path: path)] = (plan, revision)
+    }
+}
@@ -6,7 +6,6 @@
 //
 
 import Foundation
-import CoreML
 import utils
 
 fileprivate let ITEM_FEATURE_KEY = "item"
@@ -21,11 +20,26 @@ struct FeatureEncoder {
     
     let modelSeed: UInt32
     
-    let stringTables: [StringTable]
+    private(set) var stringTables: [StringTable]
     
     let featureIndexes: [String : Int]
     
-    let plistEncoder = PListEncoder()
+    let paths: FeaturePathIndex
+    
+    let itemNode: Int
+    
+    let contextNode: Int
+    
+    // shared by copies of the encoder
+    let plans = EncodingPlanCache()
+    
+    let jsonFeatures: JSONFeatures
+    
+    // shared by copies of the encoder, nil unless caching contexts
+    private(set) var contextCache: ContextCache? = nil
+    
+    // shared by copies of the encoder, nil unless caching items
+    private(set) var itemCache: ItemCache? = nil
     
     public init(featureNames: [String], stringTables: [String : [UInt64]], modelSeed: UInt32) throws {
         self.featureNames = featureNames
@@ -33,6 +47,11 @@ struct FeatureEncoder {
         self.featureIndexes = featureNames.reduce(into: [String : Int]()) { partialResult, value in
             partialResult[value] = partialResult.count
         }
+        let paths = FeaturePathIndex(featureNames: featureNames)
+        self.paths = paths
+        self.itemNode = paths.node(ITEM_FEATURE_KEY)
+        self.contextNode = paths.node(CONTEXT_FEATURE_KEY)
+        self.jsonFeatures = try JSONFeatures(paths: paths, featureCount: featureNames.count)
         
         var tmp = Array(repeating: StringTable(stringTable: [], modelSeed: modelSeed), count: featureNames.count)
         for (featureName, table) in stringTables {
@@ -44,14 +63,87 @@ struct FeatureEncoder {
         self.stringTables = tmp
     }
     
+    /**
+     A copy of the encoder where each string feature caches the encoded values of up to capacity strings.
+     */
+    func cachingStrings(capacity: Int) -> FeatureEncoder {
+        var encoder = self
+        encoder.stringTables = stringTables.map { $0.caching(capacity: capacity) }
+        return encoder
+    }
+    
+    // nil unless caching strings
+    var stringCacheStatistics: StringCacheStatistics? {
+        let caches = stringTables.compactMap { $0.cache }
+        if caches.isEmpty {
+            return nil
+        }
+        return caches.map { $0.statistics }.reduce(StringCacheStatistics(hits: 0, misses: 0, evictions: 0, count: 0), +)
+    }
+    
+    /**
+     A copy of the encoder that keeps the encoded rows of up to capacity recent contexts.
+     */
+    func cachingContexts(capacity: Int) -> FeatureEncoder {
+        var encoder = self
+        encoder.contextCache = ContextCache(capacity: capacity)
+        return encoder
+    }
+    
+    var contextCacheStatistics: CacheStatistics? {
+        return contextCache?.statistics
+    }
+    
+    /**
+     A copy of the encoder that keeps the encoded features of recent items within maxBytes.
+     */
+    func cachingItems(maxBytes: Int) -> FeatureEncoder {
+        var encoder = self
+        encoder.itemCache = ItemCache(maxBytes: maxBytes)
+        return encoder
+    }
+    
+    var itemCacheStatistics: CacheStatistics? {
+        return itemCache?.statistics
+    }
+    
     func encodeFeatureVectors(items: [Any?], context: Any?, noise: Double) throws -> [[Double]] {
-        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
-
         // Compute context vector once
+        let contextVector = try encodeContextVector(context: context, noise: noise)
+        
+        return try encodeFeatureVectors(items: items[...], contextVector: contextVector, noise: noise)
+    }
+    
+    func encodeContextVector(context: Any?, noise: Double) throws -> [Double] {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        
         var contextVector = [Double](repeating: Double.nan, count: self.featureNames.count)
-
+        
+        if let cache = contextCache, let fingerprint = Self.fingerprint(context) {
+            // cached without noise, sprinkled the same way encodeContext would
+            let row = try cache.row(for: fingerprint) { try encodeContextRow(context: context) }
+            for (featureIndex, value) in zip(row.indexes, row.values) {
+                contextVector[featureIndex] = sprinkle(x: value, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+            }
+            return contextVector
+        }
+        
         try self.encodeContext(context: context, into: &contextVector, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
-
+        
+        return contextVector
+    }
+    
+    private func encodeContextRow(context: Any?) throws -> ContextCache.Row {
+        var contextVector = [Double](repeating: Double.nan, count: self.featureNames.count)
+        try self.encodeContext(context: context, into: &contextVector)
+        let indexes = contextVector.indices.filter { !contextVector[$0].isNaN }
+        return ContextCache.Row(indexes: indexes, values: indexes.map { contextVector[$0] })
+    }
+    
+    // Encodes a slice of the items on top of a context vector from encodeContextVector with the same noise
+    func encodeFeatureVectors(items: ArraySlice<Any?>, contextVector: [Double], noise: Double) throws -> [[Double]] {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        
         // Initialize featureVectors with contextVector
         var featureVectors = [[Double]](repeating: contextVector, count: items.count)
 
@@ -63,68 +155,297 @@ struct FeatureEncoder {
         
         return featureVectors
     }
+    
+    // Without an id the key is the fingerprint, which hashes Encodable items as they stream
+    // through FingerprintEncoder, so looking an item up costs less than encoding it
+    private static func itemCacheKey(item: Any?, id: AnyHashable?) -> ItemCache.Key? {
+        if let id = id {
+            return .id(id)
+        }
+        return fingerprint(item).map { .fingerprint($0) }
+    }
+    
+    // Encodes the item without noise in the scratch row and copies what it wrote, strings looked up
+    private func encodeItemRow(item: Any?, into row: inout SparseRow) throws -> ItemCache.Row {
+        row.removeAll()
+        try self.encodeItem(item: item, into: &row)
+        var values = row.values
+        for (position, string) in row.strings.enumerated() {
+            if let string = string {
+                values[position] = stringTables[row.indexes[position]].encode(string: string)
+            }
+        }
+        return ItemCache.Row(indexes: row.indexes.map { Int32($0) }, values: values)
+    }
+    
+    /**
+     Same as encodeFeatureVectors narrowed to Float32, written into one contiguous buffer instead of
+     an array per item. Each item is encoded without noise into a single reused Double row, then
+     feature_sprinkle adds the noise and fills its missing features from the context in one pass.
+     */
+    func encodeFeatureMatrix(items: ArraySlice<Any?>, contextVector: [Double], noise: Double) throws -> FeatureMatrix {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        // sprinkle rounds the noise to Float first
+        let noiseShift = Double(Float(p.noiseShift)), noiseScale = Double(Float(p.noiseScale))
+        
+        let featureCount = featureNames.count
+        var matrix = FeatureMatrix(rowCount: items.count, featureCount: featureCount)
+        let context = contextVector.map { Float($0) }
+        var row = [Double](repeating: Double.nan, count: featureCount)
+        
+        try matrix.values.withUnsafeMutableBufferPointer { values in
+            for (index, item) in items.enumerated() {
+                row.withUnsafeMutableBufferPointer { row in
+                    feature_fill_f64(row.baseAddress, featureCount, Double.nan)
+                }
+                try self.encodeItem(item: item, into: &row)
+                
+                feature_sprinkle(row, featureCount, noiseShift, noiseScale, context, values.baseAddress.map { $0 + index * featureCount })
+            }
+        }
+        return matrix
+    }
+    
+    /**
+     Encodes the items as overlays on the context vector, without copying it per item. With an item
+     cache, items are looked up by their id in ids, the same length as items, or else by fingerprint.
+     */
+    func encodeSparseFeatures(items: ArraySlice<Any?>, ids: ArraySlice<AnyHashable>? = nil, contextVector: [Double], noise: Double) throws -> SparseFeatureMatrix {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        
+        var features = SparseFeatureMatrix(context: contextVector.map { Float($0) })
+        try ScratchBuffer.current.withSparseRow(featureCount: featureNames.count) { row in
+            for (i, item) in items.enumerated() {
+                if let cache = itemCache, let key = Self.itemCacheKey(item: item, id: ids.map { $0[$0.startIndex + i] }) {
+                    let cached = try cache.row(for: key) { try encodeItemRow(item: item, into: &row) }
+                    features.append(cached, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+                    continue
+                }
+                row.removeAll()
+                try self.encodeItem(item: item, into: &row)
+                features.append(row, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+            }
+        }
+        features.resolveStrings(seed: UInt64(modelSeed)) { featureIndex, hash in
+            sprinkle(x: stringTables[featureIndex].encode(hash: hash), noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+        }
+        return features
+    }
+    
+    /**
+     Same as encodeFeatureMatrix for items given as a UTF-8 JSON array and a context as UTF-8 JSON,
+     parsed by json_features in utils straight into the matrix without building Swift values.
+     */
+    func encodeFeatureMatrix(itemsJSON: Data, contextJSON: Data?, noise: Double) throws -> FeatureMatrix {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        // sprinkle rounds the noise to Float first
+        let noiseShift = Double(Float(p.noiseShift)), noiseScale = Double(Float(p.noiseScale))
+        let featureCount = featureNames.count
+        
+        return try ScratchBuffer.current.withArena { arena in
+            var context = [Float](repeating: Float.nan, count: featureCount)
+            if let contextJSON = contextJSON {
+                var strings = json_strings_t()
+                let status = contextJSON.withUnsafeBytes { (json: UnsafeRawBufferPointer) in
+                    context.withUnsafeMutableBufferPointer { row in
+                        json_encode(jsonFeatures.pointer, json.bindMemory(to: UInt8.self).baseAddress, json.count, contextNode, noiseShift, noiseScale, row.baseAddress, arena, &strings)
+                    }
+                }
+                try JSONFeatures.check(status, "context")
+                resolveStrings(strings, into: &context, featureCount: featureCount, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+            }
+            
+            let rowCount = itemsJSON.withUnsafeBytes { (json: UnsafeRawBufferPointer) in
+                json_array_count(json.bindMemory(to: UInt8.self).baseAddress, json.count)
+            }
+            if rowCount < 0 {
+                try JSONFeatures.check(Int32(rowCount), "items")
+            }
+            
+            var matrix = FeatureMatrix(rowCount: rowCount, featureCount: featureCount)
+            var strings = json_strings_t()
+            let status = itemsJSON.withUnsafeBytes { (json: UnsafeRawBufferPointer) in
+                context.withUnsafeBufferPointer { context in
+                    matrix.values.withUnsafeMutableBufferPointer { out in
+                        json_encode_array(jsonFeatures.pointer, json.bindMemory(to: UInt8.self).baseAddress, json.count, itemNode, context.baseAddress, noiseShift, noiseScale, out.baseAddress, rowCount, arena, &strings)
+                    }
+                }
+            }
+            try JSONFeatures.check(status, "items")
+            resolveStrings(strings, into: &matrix.values, featureCount: featureCount, noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale))
+            return matrix
+        }
+    }
+    
+    /**
+     Same as encodeFeatureMatrix for items given as columns, with each column written into the matrix
+     in a single strided pass. Columns the model doesn't use are never read, later columns with the same
+     path overwrite earlier ones.
+     */
+    func encodeFeatureMatrix(columns: [FeatureColumn], contextVector: [Double], noise: Double) throws -> FeatureMatrix {
+        let p: (noiseShift: Double, noiseScale: Double) = getNoiseAndShiftScale(noise: noise)
+        // sprinkle rounds the noise to Float first
+        let noiseShift = Double(Float(p.noiseShift)), noiseScale = Double(Float(p.noiseScale))
+        let featureCount = featureNames.count
+        
+        let rowCount = columns.first?.count ?? 0
+        for column in columns {
+            guard column.count == rowCount else {
+                throw ImproveAIError.invalidArgument(reason: "column \(column.path) has \(column.count) items, expected \(rowCount)")
+            }
+            // count + 1 non-decreasing offsets within bytes
+            if case .strings(let bytes, let offsets) = column.values {
+                guard offsets.count == rowCount + 1, offsets[0] >= 0, offsets[rowCount] <= bytes.count, zip(offsets, offsets.dropFirst()).allSatisfy({ $0 <= $1 }) else {
+                    throw ImproveAIError.invalidArgument(reason: "column \(column.path) has invalid string offsets")
+                }
+            }
+        }
+        
+        var matrix = FeatureMatrix(rowCount: rowCount, repeating: contextVector.map { Float($0) })
+        if rowCount == 0 {
+            return matrix
+        }
+        
+        for column in columns {
+            let node = column.path.isEmpty ? itemNode : paths.child(of: itemNode, key: column.path)
+            guard let featureIndex = paths.featureIndex(of: node) else {
+                continue
+            }
+            switch column.values {
+            case .double(let doubles):
+                matrix.values.withUnsafeMutableBufferPointer { values in
+                    for (row, x) in doubles.enumerated() where !x.isNaN {
+                        values[row * featureCount + featureIndex] = Float((x + noiseShift) * noiseScale)
+                    }
+                }
+            case .int64(let integers):
+                matrix.values.withUnsafeMutableBufferPointer { values in
+                    for (row, x) in integers.enumerated() {
+                        values[row * featureCount + featureIndex] = Float((Double(x) + noiseShift) * noiseScale)
+                    }
+                }
+            case .strings(let bytes, let offsets):
+                var hashes = [UInt64](repeating: 0, count: rowCount)
+                bytes.withUnsafeBufferPointer { bytes in
+                    offsets.withUnsafeBufferPointer { offsets in
+                        hashes.withUnsafeMutableBufferPointer { hashes in
+                            xxh3_64_batch(bytes.baseAddress, offsets.baseAddress, rowCount, UInt64(modelSeed), hashes.baseAddress)
+                        }
+                    }
+                }
+                let stringTable = stringTables[featureIndex]
+                matrix.values.withUnsafeMutableBufferPointer { values in
+                    for (row, hash) in hashes.enumerated() {
+                        values[row * featureCount + featureIndex] = Float(sprinkle(x: stringTable.encode(hash: hash), noiseShift: Float(p.noiseShift), noiseScale: Float(p.noiseScale)))
+                    }
+                }
+            }
+        }
+        return matrix
+    }
+    
+    // Hashes the strings json_features collected in one batch and writes their table values
+    private func resolveStrings(_ strings: json_strings_t, into values: inout [Float], featureCount: Int, noiseShift: Float, noiseScale: Float) {
+        // a model without features has no string to write, nor a feature index to divide by
+        guard strings.count > 0, featureCount > 0 else {
+            return
+        }
+        var hashes = [UInt64](repeating: 0, count: strings.count)
+        hashes.withUnsafeMutableBufferPointer { hashes in
+            xxh3_64_batch(strings.bytes, strings.offsets, strings.count, UInt64(modelSeed), hashes.baseAddress)
+        }
+        for i in 0..<strings.count {
+            // SIZE_MAX, read as -1, once a later value replaced the string
+            let position = strings.positions[i]
+            guard position >= 0 else {
+                continue
+            }
+            let featureIndex = position % featureCount
+            values[position] = Float(sprinkle(x: stringTables[featureIndex].encode(hash: hashes[i]), noiseShift: noiseShift, noiseScale: noiseScale))
+        }
+    }
 }
 
 extension FeatureEncoder {
-    private func encodeItem(item: Any?, into: inout [Double], noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
-        try self.encode(obj: item, path: ITEM_FEATURE_KEY, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    private func encodeItem<V: FeatureStorage>(item: Any?, into: inout V, noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
+        try self.encode(obj: item, node: itemNode, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    }
+    
+    private func encodeContext<V: FeatureStorage>(context: Any?, into: inout V, noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
+        try self.encode(obj: context, node: contextNode, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
     }
     
-    private func encodeContext(context: Any?, into: inout [Double], noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
-        try self.encode(obj: context, path: CONTEXT_FEATURE_KEY, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    func encode<V: FeatureStorage>(obj: Any?, path: String, into: inout V, noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
+        try self.encode(obj: obj, node: paths.node(path), into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
     }
     
-    func encode(obj: Any?, path: String, into: inout [Double], noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
+    // node is a FeaturePathIndex node, nested keys and indexes resolve from it without building paths
+    func encode<V: FeatureStorage>(obj: Any?, node: Int, into: inout V, noiseShift: Float = 0.0, noiseScale: Float = 1.0) throws {
         guard let obj = obj else {
             return
         }
         
+        if let value = Self.doubleValue(of: obj) {
+            encodeDouble(value, node: node, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return
+        }
+        
         switch obj {
         case is NSNull:
             break
+        case let obj as String:
+            if let featureIndex = paths.featureIndex(of: node) {
+                encodeString(obj: obj, featureIndex: featureIndex, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            }
+        case let array as [Any?]:
+            try encodeArray(array: array, node: node, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+        case let dict as [String : Any]:
+            try encodeDict(dict: dict, node: node, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+        case let encodable as Encodable:
+            try encodeEncodable(encodable: encodable, path: paths.path(of: node), into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+        default:
+            throw ImproveAIError.typeNotSupported
+        }
+    }
+    
+    // The value a number encodes as, nil when obj isn't a number
+    static func doubleValue(of obj: Any) -> Double? {
+        switch obj {
         case let obj as Int8:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as UInt8:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Int16:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as UInt16:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Int32:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as UInt32:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Int64:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as UInt64:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Int:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as UInt:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Float:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return Double(obj)
         case let obj as Double:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return obj
         case let obj as Bool:
-            encodeNumber(obj: NSNumber(value: obj), path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return obj ? 1 : 0
         case let obj as NSNumber:
-            encodeNumber(obj: obj, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
-        case let obj as String:
-            encodeString(obj: obj, path: path, into: &into, noiseShift: noiseShift, noiseScale:noiseScale)
-        case let array as [Any?]:
-            try encodeArray(array: array, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
-        case let dict as [String : Any]:
-            try encodeDict(dict: dict, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
-        case let encodable as Encodable:
-            try encodeEncodable(encodable: encodable, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            return obj.doubleValue
         default:
-            throw ImproveAIError.typeNotSupported
+            return nil
         }
     }
     
-    func encodeNumber(obj: NSNumber, path: String, into: inout [Double], noiseShift: Float, noiseScale: Float) {
-        if obj.doubleValue.isNaN {
+    func encodeDouble<V: FeatureStorage>(_ value: Double, path: String, into: inout V, noiseShift: Float, noiseScale: Float) {
+        if value.isNaN {
             return
         }
         
@@ -132,34 +453,56 @@ extension FeatureEncoder {
             return
         }
         
-        into[featureIndex] = sprinkle(x: obj.doubleValue, noiseShift: noiseShift, noiseScale: noiseScale)
+        into.set(sprinkle(x: value, noiseShift: noiseShift, noiseScale: noiseScale), at: featureIndex)
+    }
+    
+    func encodeDouble<V: FeatureStorage>(_ value: Double, node: Int, into: inout V, noiseShift: Float, noiseScale: Float) {
+        if let featureIndex = paths.featureIndex(of: node) {
+            encodeDouble(value, featureIndex: featureIndex, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+        }
+    }
+    
+    func encodeDouble<V: FeatureStorage>(_ value: Double, featureIndex: Int, into: inout V, noiseShift: Float, noiseScale: Float) {
+        if value.isNaN {
+            return
+        }
+        
+        into.set(sprinkle(x: value, noiseShift: noiseShift, noiseScale: noiseScale), at: featureIndex)
     }
     
-    func encodeString(obj: String, path: String, into: inout [Double], noiseShift: Float, noiseScale: Float) {
+    func encodeString<V: FeatureStorage>(obj: String, path: String, into: inout V, noiseShift: Float, noiseScale: Float) {
         guard let featureIndex = self.featureIndexes[path] else {
             return
         }
         
+        encodeString(obj: obj, featureIndex: featureIndex, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    }
+    
+    func encodeString<V: FeatureStorage>(obj: String, featureIndex: Int, into: inout V, noiseShift: Float, noiseScale: Float) {
         let stringTable = self.stringTables[featureIndex]
+        // hashed later with the rest of the batch unless the table caches strings
+        if stringTable.cache == nil && into.deferString(obj, at: featureIndex) {
+            return
+        }
         
-        into[featureIndex] = sprinkle(x: stringTable.encode(string: obj), noiseShift: noiseShift, noiseScale: noiseScale)
+        into.set(sprinkle(x: stringTable.encode(string: obj), noiseShift: noiseShift, noiseScale: noiseScale), at: featureIndex)
     }
     
-    func encodeArray(array: [Any?], path: String, into: inout [Double], noiseShift: Float, noiseScale: Float) throws {
+    func encodeArray<V: FeatureStorage>(array: [Any?], node: Int, into: inout V, noiseShift: Float, noiseScale: Float) throws {
         for (index, item) in array.enumerated() {
-            try self.encode(obj: item, path: "\(path).\(index)", into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            try self.encode(obj: item, node: paths.child(of: node, index: index), into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
         }
     }
     
-    func encodeDict(dict: [String : Any], path: String, into: inout [Double], noiseShift: Float, noiseScale: Float) throws {
+    func encodeDict<V: FeatureStorage>(dict: [String : Any], node: Int, into: inout V, noiseShift: Float, noiseScale: Float) throws {
         for (key, value) in dict {
-            try self.encode(obj: value, path: "\(path).\(key)", into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+            try self.encode(obj: value, node: paths.child(of: node, key: key), into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
         }
     }
     
-    func encodeEncodable<T: Encodable>(encodable: T, path: String, into: inout [Double], noiseShift: Float, noiseScale: Float) throws {
-        let obj = try plistEncoder.encode(encodable)
-        try encode(obj: obj, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    func encodeEncodable<T: Encodable, V: FeatureStorage>(encodable: T, path: String, into: inout V, noiseShift: Float, noiseScale: Float) throws {
+        let encoder = FeatureVectorEncoder<V>(featureEncoder: self, noiseShift: noiseShift, noiseScale: noiseScale)
+        try encoder.encode(encodable, path: path, into: &into)
     }
     
     private func getNoiseAndShiftScale(noise: Double) -> (Double, Double) {
@@ -182,7 +525,10 @@ struct StringTable {
     
     let missWidth: Double
     
-    let valueTable: [UInt64 : Double]
+    let valueTable: PerfectHashTable
+    
+    // shared by copies of the table, nil unless caching
+    private(set) var cache: StringCache?
     
     init(stringTable: [UInt64], modelSeed: UInt32) {
         self.modelSeed = modelSeed
@@ -193,14 +539,35 @@ struct StringTable {
         let maxPosition = stringTable.count - 1
         self.missWidth = maxPosition < 1 ? 1 : 2.0 / Double(maxPosition)
         
-        self.valueTable = stringTable.reversed().reduce(into: [UInt64 : Double]()) { partialResult, value in
+        let valueTable = stringTable.reversed().reduce(into: [UInt64 : Double]()) { partialResult, value in
             partialResult[value] = maxPosition == 0 ? 1.0 : Self.scale(value: Double(partialResult.count) / Double(maxPosition))
         }
+        self.valueTable = PerfectHashTable(valueTable)
+    }
+    
+    /**
+     A copy of the table remembering the encoded values of up to capacity strings.
+     */
+    func caching(capacity: Int) -> StringTable {
+        var table = self
+        table.cache = StringCache(capacity: capacity)
+        return table
     }
     
     func encode(string: String) -> Double {
-        let stringHash = xxhash3(string, UInt64(self.modelSeed))
-        if let value = self.valueTable[stringHash & UInt64(self.mask)] {
+        if let cache = cache {
+            return cache.value(for: string) { encodeUncached(string: $0) }
+        }
+        return encodeUncached(string: string)
+    }
+    
+    func encodeUncached(string: String) -> Double {
+        return encode(hash: xxhash3(string, UInt64(self.modelSeed)))
+    }
+    
+    // The value of a string hashed with the model seed
+    func encode(hash stringHash: UInt64) -> Double {
+        if let value = self.valueTable.value(for: stringHash & UInt64(self.mask)) {
             return value
         }
         return self.encodeMiss(stringHash: stringHash)
@@ -213,9 +580,10 @@ struct StringTable {
     }
     
     func xxhash3(_ value: String, _ seed: UInt64) -> UInt64 {
-        let bytes = value.utf8CString
-        return bytes.withUnsafeBufferPointer { p in
-            XXH3_64bits_withSeed(p.baseAddress!, value.utf8.count, seed)
+        // hashes the string's own UTF-8 storage, without copying it into a C string
+        var value = value
+        return value.withUTF8 { p in
+            XXH3_64bits_withSeed(p.baseAddress, p.count, seed)
         }
     }
     
@@ -0,0 +1,78 @@
+//
+//  FeatureMatrix.swift
+//
+//
+//  Created on 2023/10/16.
+//
+
+import Foundation
+import utils
+
+/**
+ Encoded feature vectors of a batch in one contiguous row-major Float32 buffer, the precision
+ every predictor evaluates at. The value of feature f for row r is values[r * featureCount + f].
+ */
+struct FeatureMatrix {
+    let rowCount: Int
+    
+    let featureCount: Int
+    
+    var values: [Float]
+    
+    init(rowCount: Int, featureCount: Int) {
+        self.rowCount = rowCount
+        self.featureCount = featureCount
+        self.values = [Float](unsafeUninitializedCapacity: rowCount * featureCount) { values, count in
+            feature_fill(values.baseAddress, rowCount * featureCount, Float.nan)
+            count = rowCount * featureCount
+        }
+    }
+    
+    /**
+     Every row a copy of row, such as the encoded context.
+     */
+    init(rowCount: Int, repeating row: [Float]) {
+        self.rowCount = rowCount
+        self.featureCount = row.count
+        self.values = [Float](unsafeUninitializedCapacity: rowCount * row.count) { values, count in
+            feature_fill_rows(values.baseAddress, rowCount, row, row.count)
+            count = rowCount * row.count
+        }
+    }
+    
+    /**
+     Narrows feature vectors the same way predictors do.
+     */
+    init(featureVectors: [[Double]], featureCount: Int) {
+        self.init(rowCount: featureVectors.count, featureCount: featureCount)
+        for (row, featureVector) in featureVectors.enumerated() {
+            for (i, value) in featureVector.enumerated() {
+                values[row * featureCount + i] = Float(value)
+            }
+        }
+    }
+    
+    /**
+     The rows of matrices one after the other.
+     */
+    init(concatenating matrices: [FeatureMatrix], featureCount: Int) {
+        self.rowCount = matrices.reduce(0) { $0 + $1.rowCount }
+        self.featureCount = featureCount
+        self.values = []
+        values.reserveCapacity(rowCount * featureCount)
+        for matrix in matrices {
+            values.append(contentsOf: matrix.values)
+        }
+    }
+    
+    func row(_ row: Int) -> ArraySlice<Float> {
+        return values[row * featureCount..<(row + 1) * featureCount]
+    }
+    
+    /**
+     The rows widened back to Double, exactly, for predictors that only take feature vectors.
+     */
+    func featureVectors() -> [[Double]] {
+        return (0..<rowCount).map { row in self.row(row).map { Double($0) } }
+    }
+}
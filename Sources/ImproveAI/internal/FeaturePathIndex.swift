@@ -0,0 +1,200 @@
+//
+//  FeaturePathIndex.swift
+//
+//
+//  Created on 2023/10/2.
+//
+
+import Foundation
+import utils
+
+/**
+ Resolves feature paths one key at a time, without building path strings.
+ 
+ Every prefix of every feature name, split on ".", is a node. The hash of a node is the xxhash3
+ of its last segment seeded with the hash of its parent, so a child is found from its parent and
+ the bytes of the key alone. Nodes keep their parent and segment and a hash hit only counts when
+ both match, which makes a collision impossible to resolve to the wrong feature. Anything below a
+ path that isn't a prefix of a feature name is missing without hashing.
+ */
+struct FeaturePathIndex {
+    static let missing = -1
+    
+    static let root = 0
+    
+    private let hashes: [UInt64]
+    
+    private let parents: [Int]
+    
+    // the segment of node i is segmentBytes[segmentOffsets[i]..<segmentOffsets[i + 1]]
+    private let segmentOffsets: [Int]
+    
+    private let segmentBytes: [UInt8]
+    
+    private let featureIndexes: [Int]
+    
+    private let paths: [String]
+    
+    // first node with a hash, the rest are chained through nextWithHash
+    private let nodes: [UInt64 : Int]
+    
+    private let nextWithHash: [Int]
+    
+    // not a prefix of any feature name, stands in for the path of a missing node
+    let unmatchedPath: String
+    
+    init(featureNames: [String]) {
+        var hashes: [UInt64] = [0]
+        var parents = [Self.missing]
+        var segmentOffsets = [0, 0]
+        var segmentBytes: [UInt8] = []
+        var featureIndexes = [Self.missing]
+        var paths = [""]
+        var nodes: [UInt64 : Int] = [:]
+        var nextWithHash = [Self.missing]
+        var nodesByPath: [String : Int] = [:]
+        
+        for (featureIndex, featureName) in featureNames.enumerated() {
+            var node = Self.root
+            var path = ""
+            for (i, segment) in featureName.split(separator: ".", omittingEmptySubsequences: false).enumerated() {
+                path = i == 0 ? String(segment) : "\(path).\(segment)"
+                if let existing = nodesByPath[path] {
+                    node = existing
+                    continue
+                }
+                let bytes = Array(segment.utf8)
+                let hash = bytes.withUnsafeBytes { XXH3_64bits_withSeed($0.baseAddress, $0.count, hashes[node]) }
+                
+                let child = hashes.count
+                hashes.append(hash)
+                parents.append(node)
+                segmentBytes.append(contentsOf: bytes)
+                segmentOffsets.append(segmentBytes.count)
+                featureIndexes.append(Self.missing)
+                paths.append(path)
+                nextWithHash.append(nodes[hash] ?? Self.missing)
+                nodes[hash] = child
+                nodesByPath[path] = child
+                node = child
+            }
+            featureIndexes[node] = featureIndex
+        }
+        
+        self.hashes = hashes
+        self.parents = parents
+        self.segmentOffsets = segmentOffsets
+        self.segmentBytes = segmentBytes
+        self.featureIndexes = featureIndexes
+        self.paths = paths
+        self.nodes = nodes
+        self.nextWithHash = nextWithHash
+        
+        var unmatchedPath = "\u{0}"
+        while featureNames.contains(where: { $0.hasPrefix(unmatchedPath) }) {
+            unmatchedPath += "\u{0}"
+        }
+        self.unmatchedPath = unmatchedPath
+    }
+    
+    /**
+     The node of path, which may span several segments.
+     */
+    func node(_ path: String) -> Int {
+        return child(of: Self.root, key: path)
+    }
+    
+    /**
+     The node of "\(path of node).\(key)". A key containing dots spans several segments.
+     */
+    func child(of node: Int, key: String) -> Int {
+        if node == Self.missing {
+            return node
+        }
+        // native strings are contiguous, so this doesn't copy
+        var key = key
+        return key.withUTF8 { bytes in
+            var node = node
+            var start = 0
+            for i in 0..<bytes.count where bytes[i] == UInt8(ascii: ".") {
+                node = child(of: node, segment: UnsafeRawBufferPointer(UnsafeBufferPointer(rebasing: bytes[start..<i])))
+                start = i + 1
+            }
+            return child(of: node, segment: UnsafeRawBufferPointer(UnsafeBufferPointer(rebasing: bytes[start...])))
+        }
+    }
+    
+    /**
+     The node of "\(path of node).\(index)".
+     */
+    func child(of node: Int, index: Int) -> Int {
+        if node == Self.missing {
+            return node
+        }
+        // decimal digits of the index, written backwards from the end of a stack buffer
+        var digits: (UInt64, UInt64, UInt64) = (0, 0, 0)
+        return withUnsafeMutableBytes(of: &digits) { buffer in
+            var value = index.magnitude
+            var start = buffer.count
+            repeat {
+                start -= 1
+                buffer[start] = UInt8(ascii: "0") + UInt8(value % 10)
+                value /= 10
+            } while value > 0
+            return child(of: node, segment: UnsafeRawBufferPointer(rebasing: buffer[start...]))
+        }
+    }
+    
+    private func child(of node: Int, segment: UnsafeRawBufferPointer) -> Int {
+        if node == Self.missing {
+            return node
+        }
+        let hash = XXH3_64bits_withSeed(segment.baseAddress, segment.count, hashes[node])
+        var candidate = nodes[hash] ?? Self.missing
+        while candidate != Self.missing {
+            if parents[candidate] == node && segmentEquals(candidate, segment) {
+                return candidate
+            }
+            candidate = nextWithHash[candidate]
+        }
+        return Self.missing
+    }
+    
+    private func segmentEquals(_ node: Int, _ segment: UnsafeRawBufferPointer) -> Bool {
+        let start = segmentOffsets[node], end = segmentOffsets[node + 1]
+        guard end - start == segment.count else {
+            return false
+        }
+        return segmentBytes.withUnsafeBytes { bytes in
+            segment.count == 0 || memcmp(bytes.baseAddress! + start, segment.baseAddress!, segment.count) == 0
+        }
+    }
+    
+    func featureIndex(of node: Int) -> Int? {
+        if node == Self.missing || featureIndexes[node] == Self.missing {
+            return nil
+        }
+        return featureIndexes[node]
+    }
+    
+    func path(of node: Int) -> String {
+        return node == Self.missing ? unmatchedPath : paths[node]
+    }
+    
+    /**
+     The nodes copied into a json_features_t, nil when out of memory. Free with json_features_free.
+     */
+    func makeJSONFeatures(featureCount: Int) -> OpaquePointer? {
+        return hashes.withUnsafeBufferPointer { hashes in
+            parents.withUnsafeBufferPointer { parents in
+                segmentOffsets.withUnsafeBufferPointer { segmentOffsets in
+                    segmentBytes.withUnsafeBufferPointer { segmentBytes in
+                        featureIndexes.withUnsafeBufferPointer { featureIndexes in
+                            json_features_create(hashes.count, hashes.baseAddress, parents.baseAddress, segmentOffsets.baseAddress, segmentBytes.baseAddress, featureIndexes.baseAddress, featureCount)
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -5,24 +5,89 @@
 //  Created by Hongxi Pan on 2023/4/3.
 //
 
+#if canImport(CoreML)
 import Foundation
 import CoreML
 
+/**
+ The input feature names of a model and where each one is in a feature vector. Built once per
+ model and shared by every provider instead of per item.
+ */
+final class FeatureSchema {
+    let names: [String]
+    
+    let nameSet: Set<String>
+    
+    let indexes: [String : Int]
+    
+    init(names: [String]) {
+        self.names = names
+        self.nameSet = Set(names)
+        self.indexes = names.enumerated().reduce(into: [String : Int]()) { partialResult, name in
+            partialResult[name.element] = name.offset
+        }
+    }
+}
+
+/**
+ One row of a batch, for models that take every feature as a separate input.
+ */
 class FeatureProvider: MLFeatureProvider {
-    let featureVector: [Double]
+    // shared by all the rows of the batch
+    let features: FeatureMatrix
+    
+    let row: Int
+    
+    let schema: FeatureSchema
+    
+    var featureNames: Set<String> {
+        return schema.nameSet
+    }
+    
+    init(features: FeatureMatrix, row: Int, schema: FeatureSchema) {
+        self.features = features
+        self.row = row
+        self.schema = schema
+    }
+    
+    func featureValue(for featureName: String) -> MLFeatureValue? {
+        guard let index = schema.indexes[featureName] else {
+            return nil
+        }
+        return MLFeatureValue(double: Double(features.values[row * features.featureCount + index]))
+    }
+}
+
+/**
+ One row of a batch, for models that take the feature vector as a single MLMultiArray input.
+ The row is a view into an array holding the whole batch, so no per feature lookups or copies.
+ */
+class MultiArrayFeatureProvider: MLFeatureProvider {
+    let inputName: String
+    
+    let featureNames: Set<String>
     
-    var featureNames: Set<String>
+    // keeps the memory value points into alive
+    private let batch: MLMultiArray
     
-    let featureIndexes: [String : Int]
+    private let value: MLFeatureValue
     
-    init(featureVector: [Double], featureNames: [String], indexes: [String : Int]) {
-        self.featureVector = featureVector
-        self.featureNames = Set(featureNames)
-        self.featureIndexes = indexes
+    init(batch: MLMultiArray, row: Int, inputName: String, inputNames: Set<String>, shape: [NSNumber]) throws {
+        let rowStride = batch.strides[0].intValue
+        // contiguous, each dimension of shape nested in the next one
+        var strides = [NSNumber](repeating: 1, count: shape.count)
+        for i in stride(from: shape.count - 2, through: 0, by: -1) {
+            strides[i] = NSNumber(value: strides[i + 1].intValue * shape[i + 1].intValue)
+        }
+        let array = try MLMultiArray(dataPointer: batch.dataPointer + row * rowStride * MemoryLayout<Float>.stride, shape: shape, dataType: .float32, strides: strides, deallocator: nil)
+        self.inputName = inputName
+        self.featureNames = inputNames
+        self.batch = batch
+        self.value = MLFeatureValue(multiArray: array)
     }
     
     func featureValue(for featureName: String) -> MLFeatureValue? {
-        let index = self.featureIndexes[featureName]!
-        return MLFeatureValue(double: Double(Float32(self.featureVector[index])))
+        return featureName == inputName ? value : nil
     }
 }
+#endif
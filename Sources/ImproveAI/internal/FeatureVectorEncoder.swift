@@ -0,0 +1,341 @@
+//
+//  FeatureVectorEncoder.swift
+//
+//
+//  Created on 2023/9/18.
+//
+
+import Foundation
+
+fileprivate protocol _Optional {
+    var isNil: Bool { get }
+}
+
+extension Optional: _Optional {
+    var isNil: Bool { return self == nil }
+}
+
+func isNil (_ input: Any) -> Bool {
+    return (input as? _Optional)?.isNil ?? false
+}
+
+/**
+ An `Encoder` that writes each value of an `Encodable` straight into its feature vector slot
+ as it's emitted, instead of building a property list and walking it afterwards.
+ 
+ Produces the same features as encoding to a property list and then `FeatureEncoder.encode(obj:)`:
+ nil values are skipped and don't take up an index in unkeyed containers, Date, Data and URL
+ throw `typeNotSupported`, and a top-level value that encodes nothing is an error. Coding paths
+ aren't tracked, `codingPath` is always empty.
+ 
+ Feature indexes come from the `EncodingPlan` of the item's type, so items after the first
+ don't build path strings. Paths missing from the plan fall back to string paths.
+ */
+final class FeatureVectorEncoder<V: FeatureStorage> {
+    let featureEncoder: FeatureEncoder
+    
+    let noiseShift: Float
+    
+    let noiseScale: Float
+    
+    var vector = V()
+    
+    // set once anything requests a container or encodes a single value
+    fileprivate var didEncode = false
+    
+    // adding paths missing from the plan instead of falling back to strings
+    fileprivate var recording = false
+    
+    // a path wasn't in the plan
+    fileprivate var missed = false
+    
+    init(featureEncoder: FeatureEncoder, noiseShift: Float, noiseScale: Float) {
+        self.featureEncoder = featureEncoder
+        self.noiseShift = noiseShift
+        self.noiseScale = noiseScale
+    }
+    
+    /**
+     Encodes value at path on top of the features already in into.
+     */
+    func encode<T: Encodable>(_ value: T, path: String, into: inout V) throws {
+        if isNil(value) {
+            return
+        }
+        // move the vector in and back out so that it's never copied
+        swap(&vector, &into)
+        defer { swap(&vector, &into) }
+        
+        let plans = featureEncoder.plans
+        guard let cached = plans.plan(for: T.self, path: path) else {
+            let plan = EncodingPlan(path: path, featureIndexes: featureEncoder.featureIndexes)
+            try encode(value, plan: plan, recording: true)
+            plans.publish(plan, revision: 0, for: T.self, path: path)
+            return
+        }
+        
+        try encode(value, plan: cached.plan, recording: false)
+        if missed && cached.revision < EncodingPlanCache.maxRevisions {
+            // writes the same features again, this time recording the missing paths
+            let revised = cached.plan.copy()
+            try encode(value, plan: revised, recording: true)
+            plans.publish(revised, revision: cached.revision + 1, for: T.self, path: path)
+        }
+    }
+    
+    private func encode<T: Encodable>(_ value: T, plan: EncodingPlan, recording: Bool) throws {
+        self.recording = recording
+        didEncode = false
+        missed = false
+        try encodeValue(value, at: Location(plan: plan, path: plan.path))
+        if !didEncode {
+            throw EncodingError.invalidValue(value, EncodingError.Context(codingPath: [], debugDescription: "Top-level \(T.self) did not encode any values."))
+        }
+    }
+    
+    fileprivate func encodeValue<T: Encodable>(_ value: T, at location: Location) throws {
+        if T.self == Date.self || T.self == NSDate.self || T.self == Data.self || T.self == NSData.self || T.self == URL.self || T.self == NSURL.self {
+            throw ImproveAIError.typeNotSupported
+        }
+        try value.encode(to: _FeatureVectorEncoder(encoder: self, location: location))
+    }
+    
+    fileprivate func childLocation(_ location: Location, key: String, position: inout Int) -> Location {
+        guard let plan = location.plan else {
+            return Location(plan: nil, path: "\(location.path).\(key)")
+        }
+        if let child = plan.child(forKey: key, position: &position) {
+            return Location(plan: child, path: child.path)
+        }
+        if recording {
+            let child = plan.addChild(forKey: key, position: &position, featureIndexes: featureEncoder.featureIndexes)
+            return Location(plan: child, path: child.path)
+        }
+        missed = true
+        return Location(plan: nil, path: "\(location.path).\(key)")
+    }
+    
+    fileprivate func childLocation(_ location: Location, index: Int) -> Location {
+        guard let plan = location.plan else {
+            return Location(plan: nil, path: "\(location.path).\(index)")
+        }
+        if let child = plan.child(at: index) {
+            return Location(plan: child, path: child.path)
+        }
+        if recording {
+            let child = plan.addChild(at: index, featureIndexes: featureEncoder.featureIndexes)
+            return Location(plan: child, path: child.path)
+        }
+        missed = true
+        return Location(plan: nil, path: "\(location.path).\(index)")
+    }
+    
+    fileprivate func encodeNumber(_ value: Double, at location: Location) {
+        if let plan = location.plan {
+            if let featureIndex = plan.featureIndex {
+                featureEncoder.encodeDouble(value, featureIndex: featureIndex, into: &vector, noiseShift: noiseShift, noiseScale: noiseScale)
+            }
+        } else {
+            featureEncoder.encodeDouble(value, path: location.path, into: &vector, noiseShift: noiseShift, noiseScale: noiseScale)
+        }
+    }
+    
+    fileprivate func encodeString(_ value: String, at location: Location) {
+        if let plan = location.plan {
+            if let featureIndex = plan.featureIndex {
+                featureEncoder.encodeString(obj: value, featureIndex: featureIndex, into: &vector, noiseShift: noiseShift, noiseScale: noiseScale)
+            }
+        } else {
+            featureEncoder.encodeString(obj: value, path: location.path, into: &vector, noiseShift: noiseShift, noiseScale: noiseScale)
+        }
+    }
+}
+
+/**
+ Where a value goes: its plan node, or only its path once it's off the plan.
+ */
+fileprivate struct Location {
+    let plan: EncodingPlan?
+    
+    let path: String
+}
+
+fileprivate struct _FeatureVectorEncoder<V: FeatureStorage>: Encoder {
+    let encoder: FeatureVectorEncoder<V>
+    
+    let location: Location
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    var userInfo: [CodingUserInfoKey : Any] {
+        return [:]
+    }
+    
+    func container<Key>(keyedBy type: Key.Type) -> KeyedEncodingContainer<Key> where Key : CodingKey {
+        encoder.didEncode = true
+        return KeyedEncodingContainer(_KeyedContainer<Key, V>(encoder: encoder, location: location))
+    }
+    
+    func unkeyedContainer() -> UnkeyedEncodingContainer {
+        encoder.didEncode = true
+        return _UnkeyedContainer(encoder: encoder, location: location)
+    }
+    
+    func singleValueContainer() -> SingleValueEncodingContainer {
+        return _SingleValueContainer(encoder: encoder, location: location)
+    }
+}
+
+fileprivate struct _KeyedContainer<Key: CodingKey, V: FeatureStorage>: KeyedEncodingContainerProtocol {
+    let encoder: FeatureVectorEncoder<V>
+    
+    let location: Location
+    
+    // where the next key is expected in the plan
+    private var position = 0
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    init(encoder: FeatureVectorEncoder<V>, location: Location) {
+        self.encoder = encoder
+        self.location = location
+    }
+    
+    private mutating func childLocation(_ key: Key) -> Location {
+        return encoder.childLocation(location, key: key.stringValue, position: &position)
+    }
+    
+    private mutating func childLocation(_ key: String) -> Location {
+        return encoder.childLocation(location, key: key, position: &position)
+    }
+    
+    mutating func encodeNil(forKey key: Key) throws {}
+    mutating func encode(_ value: Bool, forKey key: Key) throws { encoder.encodeNumber(value ? 1 : 0, at: childLocation(key)) }
+    mutating func encode(_ value: String, forKey key: Key) throws { encoder.encodeString(value, at: childLocation(key)) }
+    mutating func encode(_ value: Double, forKey key: Key) throws { encoder.encodeNumber(value, at: childLocation(key)) }
+    mutating func encode(_ value: Float, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int8, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int16, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int32, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int64, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt8, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt16, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt32, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt64, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    
+    mutating func encode<T: Encodable>(_ value: T, forKey key: Key) throws {
+        if !isNil(value) {
+            try encoder.encodeValue(value, at: childLocation(key))
+        }
+    }
+    
+    mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type, forKey key: Key) -> KeyedEncodingContainer<NestedKey> {
+        return KeyedEncodingContainer(_KeyedContainer<NestedKey, V>(encoder: encoder, location: childLocation(key)))
+    }
+    
+    mutating func nestedUnkeyedContainer(forKey key: Key) -> UnkeyedEncodingContainer {
+        return _UnkeyedContainer(encoder: encoder, location: childLocation(key))
+    }
+    
+    mutating func superEncoder() -> Encoder {
+        return _FeatureVectorEncoder(encoder: encoder, location: childLocation("super"))
+    }
+    
+    mutating func superEncoder(forKey key: Key) -> Encoder {
+        return _FeatureVectorEncoder(encoder: encoder, location: childLocation(key))
+    }
+}
+
+fileprivate struct _UnkeyedContainer<V: FeatureStorage>: UnkeyedEncodingContainer {
+    let encoder: FeatureVectorEncoder<V>
+    
+    let location: Location
+    
+    // nil values aren't counted, like the property list encoding leaves them out of the array
+    private(set) var count = 0
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    init(encoder: FeatureVectorEncoder<V>, location: Location) {
+        self.encoder = encoder
+        self.location = location
+    }
+    
+    private mutating func nextLocation() -> Location {
+        defer { count += 1 }
+        return encoder.childLocation(location, index: count)
+    }
+    
+    mutating func encodeNil() throws {}
+    mutating func encode(_ value: Bool) throws { encoder.encodeNumber(value ? 1 : 0, at: nextLocation()) }
+    mutating func encode(_ value: String) throws { encoder.encodeString(value, at: nextLocation()) }
+    mutating func encode(_ value: Double) throws { encoder.encodeNumber(value, at: nextLocation()) }
+    mutating func encode(_ value: Float) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int8) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int16) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int32) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int64) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt8) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt16) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt32) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt64) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    
+    mutating func encode<T: Encodable>(_ value: T) throws {
+        if !isNil(value) {
+            try encoder.encodeValue(value, at: nextLocation())
+        }
+    }
+    
+    mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type) -> KeyedEncodingContainer<NestedKey> {
+        return KeyedEncodingContainer(_KeyedContainer<NestedKey, V>(encoder: encoder, location: nextLocation()))
+    }
+    
+    mutating func nestedUnkeyedContainer() -> UnkeyedEncodingContainer {
+        return _UnkeyedContainer(encoder: encoder, location: nextLocation())
+    }
+    
+    mutating func superEncoder() -> Encoder {
+        return _FeatureVectorEncoder(encoder: encoder, location: nextLocation())
+    }
+}
+
+fileprivate struct _SingleValueContainer<V: FeatureStorage>: SingleValueEncodingContainer {
+    let encoder: FeatureVectorEncoder<V>
+    
+    let location: Location
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    mutating func encodeNil() throws { encoder.didEncode = true }
+    mutating func encode(_ value: Bool) throws { encoder.didEncode = true; encoder.encodeNumber(value ? 1 : 0, at: location) }
+    mutating func encode(_ value: String) throws { encoder.didEncode = true; encoder.encodeString(value, at: location) }
+    mutating func encode(_ value: Double) throws { encoder.didEncode = true; encoder.encodeNumber(value, at: location) }
+    mutating func encode(_ value: Float) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int8) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int16) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int32) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int64) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt8) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt16) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt32) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt64) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    
+    mutating func encode<T: Encodable>(_ value: T) throws {
+        encoder.didEncode = true
+        try encoder.encodeValue(value, at: location)
+    }
+}
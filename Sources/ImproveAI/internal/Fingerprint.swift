@@ -0,0 +1,82 @@
+//
+//  Fingerprint.swift
+//
+//
+//  Created on 2023/12/18.
+//
+
+import Foundation
+import utils
+
+extension FeatureEncoder {
+    private static let nullTag: UInt64 = 1
+    
+    private static let numberTag: UInt64 = 2
+    
+    private static let stringTag: UInt64 = 3
+    
+    private static let arrayTag: UInt64 = 4
+    
+    private static let dictTag: UInt64 = 5
+    
+    private static let encodableTag: UInt64 = 6
+    
+    /**
+     A 64 bit hash of an item or context value, walked in the order encode tries the types so that
+     values with the same fingerprint encode the same. Dictionary entries are combined independently
+     of their order. Encodable values other than the Foundation ones are streamed through
+     FingerprintEncoder, without serializing them. nil for values that can't be hashed, which are
+     then encoded every time.
+     */
+    static func fingerprint(_ obj: Any?) -> UInt64? {
+        guard let obj = obj else {
+            return combine(nullTag, 0)
+        }
+        if let value = doubleValue(of: obj) {
+            return combine(numberTag, value.bitPattern)
+        }
+        
+        switch obj {
+        case is NSNull:
+            return combine(nullTag, 0)
+        case let string as String:
+            return hash(string, seed: stringTag)
+        case let array as [Any?]:
+            var result = combine(arrayTag, UInt64(array.count))
+            for element in array {
+                guard let value = fingerprint(element) else {
+                    return nil
+                }
+                result = combine(result, value)
+            }
+            return result
+        case let dict as [String : Any]:
+            var sum: UInt64 = 0
+            for (key, value) in dict {
+                guard let value = fingerprint(value) else {
+                    return nil
+                }
+                sum = sum &+ combine(hash(key, seed: stringTag), value)
+            }
+            return combine(combine(dictTag, UInt64(dict.count)), sum)
+        case let encodable as Encodable:
+            if isNil(encodable) {
+                return combine(nullTag, 0)
+            }
+            return FingerprintEncoder.fingerprint(encodable, seed: encodableTag)
+        default:
+            return nil
+        }
+    }
+    
+    private static func hash(_ string: String, seed: UInt64) -> UInt64 {
+        // native strings are contiguous, so this doesn't copy
+        var string = string
+        return string.withUTF8 { XXH3_64bits_withSeed($0.baseAddress, $0.count, seed) }
+    }
+    
+    private static func combine(_ a: UInt64, _ b: UInt64) -> UInt64 {
+        var pair = (a, b)
+        return withUnsafeBytes(of: &pair) { XXH3_64bits_withSeed($0.baseAddress, $0.count, 0) }
+    }
+}
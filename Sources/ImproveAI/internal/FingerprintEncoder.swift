@@ -0,0 +1,277 @@
+//
+//  FingerprintEncoder.swift
+//
+//
+//  Created on 2023/12/21.
+//
+
+import Foundation
+import utils
+
+/**
+ An `Encoder` that streams the keys and values of an `Encodable` into XXH3 state as they're emitted,
+ for `FeatureEncoder.fingerprint(_:)`, instead of serializing the value first.
+ 
+ Follows `FeatureVectorEncoder`: nil values are skipped and don't take up an index in unkeyed
+ containers, numbers are hashed as the Double they encode as, Date, Data and URL can't be hashed,
+ and a top-level value that encodes nothing has no fingerprint. Every key and index is hashed with
+ the id of the container it's in, so values that hash the same write the same features.
+ 
+ Keys are hashed in the order they're encoded, so a dictionary property that iterates in another
+ order gets another fingerprint and only misses the cache.
+ */
+final class FingerprintEncoder {
+    // what a record is, so that records of different kinds can't hash the same
+    fileprivate enum Tag: UInt64 {
+        case key = 1
+        case index = 2
+        case number = 3
+        case string = 4
+    }
+    
+    private let state: OpaquePointer
+    
+    // ids handed out to keys and indexes so far, the top-level value is 0
+    private var locationCount: UInt64 = 1
+    
+    // set once anything requests a container or encodes a single value
+    fileprivate var didEncode = false
+    
+    private init(state: OpaquePointer) {
+        self.state = state
+    }
+    
+    /**
+     The hash of value, nil when it can't be hashed or encodes nothing, which fails to encode as well.
+     */
+    static func fingerprint<T: Encodable>(_ value: T, seed: UInt64) -> UInt64? {
+        return try? ScratchBuffer.current.withHashState(seed: seed) { state in
+            let encoder = FingerprintEncoder(state: state)
+            try encoder.encodeValue(value, at: 0)
+            if !encoder.didEncode {
+                return nil
+            }
+            return XXH3_64bits_digest(state)
+        }
+    }
+    
+    fileprivate func encodeValue<T: Encodable>(_ value: T, at location: UInt64) throws {
+        if T.self == Date.self || T.self == NSDate.self || T.self == Data.self || T.self == NSData.self || T.self == URL.self || T.self == NSURL.self {
+            throw ImproveAIError.typeNotSupported
+        }
+        try value.encode(to: _FingerprintEncoder(encoder: self, location: location))
+    }
+    
+    fileprivate func childLocation(_ location: UInt64, key: String) -> UInt64 {
+        hash(.key, location, key)
+        return nextLocation()
+    }
+    
+    fileprivate func childLocation(_ location: UInt64, index: Int) -> UInt64 {
+        hash(.index, location, UInt64(index))
+        return nextLocation()
+    }
+    
+    fileprivate func encodeNumber(_ value: Double, at location: UInt64) {
+        hash(.number, location, value.bitPattern)
+    }
+    
+    fileprivate func encodeString(_ value: String, at location: UInt64) {
+        hash(.string, location, value)
+    }
+    
+    private func nextLocation() -> UInt64 {
+        defer { locationCount += 1 }
+        return locationCount
+    }
+    
+    private func hash(_ tag: Tag, _ location: UInt64, _ payload: UInt64) {
+        var record = (tag.rawValue, location, payload)
+        withUnsafeBytes(of: &record) { bytes in
+            _ = XXH3_64bits_update(state, bytes.baseAddress, bytes.count)
+        }
+    }
+    
+    private func hash(_ tag: Tag, _ location: UInt64, _ string: String) {
+        // native strings are contiguous, so this doesn't copy
+        var string = string
+        string.withUTF8 { bytes in
+            // the length first, so that the bytes can't run into the next record
+            hash(tag, location, UInt64(bytes.count))
+            _ = XXH3_64bits_update(state, bytes.baseAddress, bytes.count)
+        }
+    }
+}
+
+fileprivate struct _FingerprintEncoder: Encoder {
+    let encoder: FingerprintEncoder
+    
+    let location: UInt64
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    var userInfo: [CodingUserInfoKey : Any] {
+        return [:]
+    }
+    
+    func container<Key>(keyedBy type: Key.Type) -> KeyedEncodingContainer<Key> where Key : CodingKey {
+        encoder.didEncode = true
+        return KeyedEncodingContainer(_KeyedContainer<Key>(encoder: encoder, location: location))
+    }
+    
+    func unkeyedContainer() -> UnkeyedEncodingContainer {
+        encoder.didEncode = true
+        return _UnkeyedContainer(encoder: encoder, location: location)
+    }
+    
+    func singleValueContainer() -> SingleValueEncodingContainer {
+        return _SingleValueContainer(encoder: encoder, location: location)
+    }
+}
+
+fileprivate struct _KeyedContainer<Key: CodingKey>: KeyedEncodingContainerProtocol {
+    let encoder: FingerprintEncoder
+    
+    let location: UInt64
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    init(encoder: FingerprintEncoder, location: UInt64) {
+        self.encoder = encoder
+        self.location = location
+    }
+    
+    private func childLocation(_ key: Key) -> UInt64 {
+        return encoder.childLocation(location, key: key.stringValue)
+    }
+    
+    mutating func encodeNil(forKey key: Key) throws {}
+    mutating func encode(_ value: Bool, forKey key: Key) throws { encoder.encodeNumber(value ? 1 : 0, at: childLocation(key)) }
+    mutating func encode(_ value: String, forKey key: Key) throws { encoder.encodeString(value, at: childLocation(key)) }
+    mutating func encode(_ value: Double, forKey key: Key) throws { encoder.encodeNumber(value, at: childLocation(key)) }
+    mutating func encode(_ value: Float, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int8, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int16, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int32, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: Int64, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt8, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt16, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt32, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    mutating func encode(_ value: UInt64, forKey key: Key) throws { encoder.encodeNumber(Double(value), at: childLocation(key)) }
+    
+    mutating func encode<T: Encodable>(_ value: T, forKey key: Key) throws {
+        if !isNil(value) {
+            try encoder.encodeValue(value, at: childLocation(key))
+        }
+    }
+    
+    mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type, forKey key: Key) -> KeyedEncodingContainer<NestedKey> {
+        return KeyedEncodingContainer(_KeyedContainer<NestedKey>(encoder: encoder, location: childLocation(key)))
+    }
+    
+    mutating func nestedUnkeyedContainer(forKey key: Key) -> UnkeyedEncodingContainer {
+        return _UnkeyedContainer(encoder: encoder, location: childLocation(key))
+    }
+    
+    mutating func superEncoder() -> Encoder {
+        return _FingerprintEncoder(encoder: encoder, location: encoder.childLocation(location, key: "super"))
+    }
+    
+    mutating func superEncoder(forKey key: Key) -> Encoder {
+        return _FingerprintEncoder(encoder: encoder, location: childLocation(key))
+    }
+}
+
+fileprivate struct _UnkeyedContainer: UnkeyedEncodingContainer {
+    let encoder: FingerprintEncoder
+    
+    let location: UInt64
+    
+    // nil values aren't counted, like FeatureVectorEncoder doesn't give them an index
+    private(set) var count = 0
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    init(encoder: FingerprintEncoder, location: UInt64) {
+        self.encoder = encoder
+        self.location = location
+    }
+    
+    private mutating func nextLocation() -> UInt64 {
+        defer { count += 1 }
+        return encoder.childLocation(location, index: count)
+    }
+    
+    mutating func encodeNil() throws {}
+    mutating func encode(_ value: Bool) throws { encoder.encodeNumber(value ? 1 : 0, at: nextLocation()) }
+    mutating func encode(_ value: String) throws { encoder.encodeString(value, at: nextLocation()) }
+    mutating func encode(_ value: Double) throws { encoder.encodeNumber(value, at: nextLocation()) }
+    mutating func encode(_ value: Float) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int8) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int16) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int32) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: Int64) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt8) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt16) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt32) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    mutating func encode(_ value: UInt64) throws { encoder.encodeNumber(Double(value), at: nextLocation()) }
+    
+    mutating func encode<T: Encodable>(_ value: T) throws {
+        if !isNil(value) {
+            try encoder.encodeValue(value, at: nextLocation())
+        }
+    }
+    
+    mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type) -> KeyedEncodingContainer<NestedKey> {
+        return KeyedEncodingContainer(_KeyedContainer<NestedKey>(encoder: encoder, location: nextLocation()))
+    }
+    
+    mutating func nestedUnkeyedContainer() -> UnkeyedEncodingContainer {
+        return _UnkeyedContainer(encoder: encoder, location: nextLocation())
+    }
+    
+    mutating func superEncoder() -> Encoder {
+        return _FingerprintEncoder(encoder: encoder, location: nextLocation())
+    }
+}
+
+fileprivate struct _SingleValueContainer: SingleValueEncodingContainer {
+    let encoder: FingerprintEncoder
+    
+    let location: UInt64
+    
+    var codingPath: [CodingKey] {
+        return []
+    }
+    
+    mutating func encodeNil() throws { encoder.didEncode = true }
+    mutating func encode(_ value: Bool) throws { encoder.didEncode = true; encoder.encodeNumber(value ? 1 : 0, at: location) }
+    mutating func encode(_ value: String) throws { encoder.didEncode = true; encoder.encodeString(value, at: location) }
+    mutating func encode(_ value: Double) throws { encoder.didEncode = true; encoder.encodeNumber(value, at: location) }
+    mutating func encode(_ value: Float) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int8) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int16) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int32) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: Int64) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt8) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt16) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt32) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    mutating func encode(_ value: UInt64) throws { encoder.didEncode = true; encoder.encodeNumber(Double(value), at: location) }
+    
+    mutating func encode<T: Encodable>(_ value: T) throws {
+        encoder.didEncode = true
+        try encoder.encodeValue(value, at: location)
+    }
+}
@@ -0,0 +1,114 @@
+//
+//  ItemCache.swift
+//
+//
+//  Created on 2023/12/18.
+//
+
+import Foundation
+
+/**
+ Encoded items of a Scorer, the features each writes without noise, kept within a memory budget.
+ 
+ Items are keyed by an id the caller gives them or else by their fingerprint. Eviction works like
+ StringCache, in two generations, except that a generation fills up at half of maxBytes rather than
+ at a number of entries, so large items take up more of the cache than small ones.
+ */
+final class ItemCache {
+    enum Key: Hashable {
+        case id(AnyHashable)
+        case fingerprint(UInt64)
+    }
+    
+    /**
+     The features an item writes, before noise, string features already looked up.
+     */
+    struct Row {
+        let indexes: [Int32]
+        
+        let values: [Double]
+        
+        // what the row takes up in the cache, roughly, with its key and dictionary slot
+        var bytes: Int {
+            return 96 + indexes.count * (MemoryLayout<Int32>.stride + MemoryLayout<Double>.stride)
+        }
+    }
+    
+    let maxBytes: Int
+    
+    private var recent: [Key : Row] = [:]
+    
+    private var older: [Key : Row] = [:]
+    
+    private var recentBytes = 0
+    
+    private var olderBytes = 0
+    
+    private var hits = 0
+    
+    private var misses = 0
+    
+    private var evictions = 0
+    
+    private let lock = NSLock()
+    
+    init(maxBytes: Int) {
+        self.maxBytes = max(maxBytes, 2)
+    }
+    
+    /**
+     The cached row of the item with this key, or encode() remembered for next time.
+     */
+    func row(for key: Key, encode: () throws -> Row) rethrows -> Row {
+        lock.lock()
+        if let row = recent[key] {
+            hits += 1
+            lock.unlock()
+            return row
+        }
+        if let row = older.removeValue(forKey: key) {
+            hits += 1
+            olderBytes -= row.bytes
+            insert(key, row)
+            lock.unlock()
+            return row
+        }
+        misses += 1
+        lock.unlock()
+        
+        // encoded outside the lock, a racing thread at worst encodes the same item twice
+        let row = try encode()
+        
+        lock.lock()
+        insert(key, row)
+        lock.unlock()
+        return row
+    }
+    
+    var statistics: CacheStatistics {
+        lock.lock()
+        defer { lock.unlock() }
+        return CacheStatistics(hits: hits, misses: misses, evictions: evictions, count: recent.count + older.count)
+    }
+    
+    // Bytes the cached rows take up
+    var bytes: Int {
+        lock.lock()
+        defer { lock.unlock() }
+        return recentBytes + olderBytes
+    }
+    
+    private func insert(_ key: Key, _ row: Row) {
+        if let replaced = recent.updateValue(row, forKey: key) {
+            recentBytes -= replaced.bytes
+        }
+        recentBytes += row.bytes
+        if recentBytes >= maxBytes / 2 {
+            evictions += older.count
+            older = recent
+            olderBytes = recentBytes
+            recent = [:]
+            recentBytes = 0
+        }
+    }
+}
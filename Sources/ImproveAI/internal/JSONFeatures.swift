@@ -0,0 +1,43 @@
+//
+//  JSONFeatures.swift
+//
+//
+//  Created on 2023/11/20.
+//
+
+import Foundation
+import utils
+
+/**
+ Owns the json_features_t that lets utils resolve feature paths while it parses JSON, a copy of
+ the nodes of a FeaturePathIndex.
+ */
+final class JSONFeatures {
+    let pointer: OpaquePointer
+    
+    init(paths: FeaturePathIndex, featureCount: Int) throws {
+        guard let pointer = paths.makeJSONFeatures(featureCount: featureCount) else {
+            throw ImproveAIError.internalError(reason: "out of memory indexing feature paths for JSON")
+        }
+        self.pointer = pointer
+    }
+    
+    deinit {
+        json_features_free(pointer)
+    }
+    
+    static func check(_ status: Int32, _ what: String) throws {
+        switch status {
+        case 0:
+            return
+        case ERR_JSON_OUT_OF_MEMORY:
+            throw ImproveAIError.internalError(reason: "out of memory encoding \(what)")
+        case ERR_JSON_TOO_DEEP:
+            throw ImproveAIError.invalidArgument(reason: "\(what) nested deeper than \(JSON_MAX_DEPTH) levels")
+        case ERR_JSON_NOT_AN_ARRAY:
+            throw ImproveAIError.invalidArgument(reason: "\(what) is not a JSON array")
+        default:
+            throw ImproveAIError.invalidArgument(reason: "\(what) is not valid JSON")
+        }
+    }
+}
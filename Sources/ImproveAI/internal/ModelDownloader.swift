@@ -5,6 +5,7 @@
 //  Created by Hongxi Pan on 2022/11/23.
 //
 
+#if canImport(CoreML)
 import Foundation
 import CoreML
 import zlib
@@ -181,3 +182,4 @@ extension ModelLoader : URLSessionDataDelegate {
         static let stream = MemoryLayout<z_stream>.size
     }
 }
+#endif
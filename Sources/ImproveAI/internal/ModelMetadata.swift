@@ -8,6 +8,13 @@
 import Foundation
 
 struct ModelMetadata : Decodable {
+    /**
+     Optional. A JSON array of the feature names, in column order, for a model whose features are a single
+     MLMultiArray input, as CoreML doesn't name the columns of an array. Written by whatever converts such
+     a model, see "Model Metadata" in the README.
+     */
+    static let featureNamesKey = "ai.improve.feature_names"
+    
     var name: String
     var seed: UInt32
     var stringTables: [String : [UInt64]]
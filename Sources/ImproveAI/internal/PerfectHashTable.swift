@@ -0,0 +1,126 @@
+//
+//  PerfectHashTable.swift
+//
+//
+//  Created on 2023/10/9.
+//
+
+import Foundation
+
+/**
+ A read only UInt64 to Double map stored as a minimal perfect hash, in the style of CHD (hash,
+ displace and compress).
+ 
+ Keys are hashed into buckets of about four. Buckets are placed largest first, each with the first
+ seed that sends all of its keys to free slots of a table exactly the size of the key set. In the
+ unlikely case a bucket runs out of seeds, everything is placed again with a different salt. A
+ lookup is two hashes, one bucket seed and one slot, with no probing. The slot keeps its key, so a
+ key that isn't in the map is reported missing rather than landing on someone else's value.
+ */
+struct PerfectHashTable {
+    private struct Entry {
+        let key: UInt64
+        let value: Double
+    }
+    
+    // mixed into every key, changed when a set of keys can't be placed
+    private let salt: UInt64
+    
+    private let seeds: [UInt32]
+    
+    private let entries: [Entry]
+    
+    init(_ map: [UInt64 : Double]) {
+        let keys = Array(map.keys)
+        var salt: UInt64 = 0
+        while true {
+            if let seeds = Self.place(keys: keys, salt: salt) {
+                var entries = [Entry](repeating: Entry(key: 0, value: 0), count: keys.count)
+                for key in keys {
+                    entries[Self.slot(key, salt: salt, seeds: seeds, count: keys.count)] = Entry(key: key, value: map[key]!)
+                }
+                self.salt = salt
+                self.seeds = seeds
+                self.entries = entries
+                return
+            }
+            salt += 1
+        }
+    }
+    
+    func value(for key: UInt64) -> Double? {
+        if entries.isEmpty {
+            return nil
+        }
+        let entry = entries[Self.slot(key, salt: salt, seeds: seeds, count: entries.count)]
+        return entry.key == key ? entry.value : nil
+    }
+    
+    private static func place(keys: [UInt64], salt: UInt64) -> [UInt32]? {
+        let bucketCount = max(1, (keys.count + 3) / 4)
+        var buckets = [[UInt64]](repeating: [], count: bucketCount)
+        for key in keys {
+            buckets[bucket(mix(key ^ salt), bucketCount)].append(mix(key ^ salt))
+        }
+        
+        // the last buckets placed are single keys looking for the few free slots left
+        let maxSeed = UInt32(clamping: max(1 << 20, keys.count * 16))
+        var seeds = [UInt32](repeating: 0, count: bucketCount)
+        var occupied = [Bool](repeating: false, count: keys.count)
+        var placed: [Int] = []
+        for b in buckets.indices.sorted(by: { buckets[$0].count > buckets[$1].count }) {
+            if buckets[b].isEmpty {
+                break
+            }
+            var seed: UInt32 = 0
+            while true {
+                placed.removeAll(keepingCapacity: true)
+                for hash in buckets[b] {
+                    let position = slot(hash, seed: seed, count: keys.count)
+                    if occupied[position] || placed.contains(position) {
+                        break
+                    }
+                    placed.append(position)
+                }
+                if placed.count == buckets[b].count {
+                    break
+                }
+                if seed == maxSeed {
+                    return nil
+                }
+                seed += 1
+            }
+            seeds[b] = seed
+            for position in placed {
+                occupied[position] = true
+            }
+        }
+        return seeds
+    }
+    
+    private static func slot(_ key: UInt64, salt: UInt64, seeds: [UInt32], count: Int) -> Int {
+        let hash = mix(key ^ salt)
+        return slot(hash, seed: seeds[bucket(hash, seeds.count)], count: count)
+    }
+    
+    private static func bucket(_ hash: UInt64, _ bucketCount: Int) -> Int {
+        return reduce(UInt32(truncatingIfNeeded: hash >> 32), bucketCount)
+    }
+    
+    private static func slot(_ hash: UInt64, seed: UInt32, count: Int) -> Int {
+        return reduce(UInt32(truncatingIfNeeded: mix(hash ^ (UInt64(seed) &* 0x9e3779b97f4a7c15))), count)
+    }
+    
+    // maps x to [0, n) with a multiply instead of a division
+    private static func reduce(_ x: UInt32, _ n: Int) -> Int {
+        return Int((UInt64(x) &* UInt64(n)) >> 32)
+    }
+    
+    // splitmix64 finalizer, a bijection so distinct keys never share a hash
+    private static func mix(_ x: UInt64) -> UInt64 {
+        var z = x
+        z = (z ^ (z >> 30)) &* 0xbf58476d1ce4e5b9
+        z = (z ^ (z >> 27)) &* 0x94d049bb133111eb
+        return z ^ (z >> 31)
+    }
+}
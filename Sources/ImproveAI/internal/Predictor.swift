@@ -0,0 +1,59 @@
+//
+//  Predictor.swift
+//
+//
+//  Created on 2023/7/24.
+//
+
+import Foundation
+
+/**
+ A loaded model that turns encoded feature vectors into raw scores.
+ */
+protocol Predictor {
+    /// Input feature names. Feature vectors passed to `predict` are indexed in this order.
+    var featureNames: [String] { get }
+    
+    /// User defined model metadata, the `ai.improve.*` keys.
+    var metadata: [String : String] { get }
+    
+    func predict(featureVectors: [[Double]]) throws -> [Double]
+    
+    /// Same as `predict(featureVectors:)` for feature vectors already narrowed to Float32.
+    func predict(features: FeatureMatrix) throws -> [Double]
+    
+    /// Same as `predict(features:)` for items stored as overlays on a shared context row.
+    func predict(sparseFeatures: SparseFeatureMatrix) throws -> [Double]
+    
+    /// Scores of the `k` best feature vectors and possibly some others, by index in `featureVectors`.
+    /// Only vectors that trail the k-th best by more than `margin` may be left out.
+    func predictTopK(featureVectors: [[Double]], k: Int, margin: Double) throws -> [(index: Int, score: Double)]
+    
+    /// Same as `predictTopK(featureVectors:k:margin:)` for feature vectors already narrowed to Float32.
+    func predictTopK(features: FeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)]
+    
+    /// Same as `predictTopK(features:k:margin:)` for items stored as overlays on a shared context row.
+    func predictTopK(sparseFeatures: SparseFeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)]
+}
+
+extension Predictor {
+    func predictTopK(featureVectors: [[Double]], k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        return try predict(featureVectors: featureVectors).enumerated().map { ($0.offset, $0.element) }
+    }
+    
+    func predict(features: FeatureMatrix) throws -> [Double] {
+        return try predict(featureVectors: features.featureVectors())
+    }
+    
+    func predictTopK(features: FeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        return try predictTopK(featureVectors: features.featureVectors(), k: k, margin: margin)
+    }
+    
+    func predict(sparseFeatures: SparseFeatureMatrix) throws -> [Double] {
+        return try predict(features: sparseFeatures.dense())
+    }
+    
+    func predictTopK(sparseFeatures: SparseFeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        return try predictTopK(features: sparseFeatures.dense(), k: k, margin: margin)
+    }
+}
@@ -0,0 +1,131 @@
+//
+//  ScratchBuffer.swift
+//
+//
+//  Created on 2023/8/28.
+//
+
+import Foundation
+import utils
+
+/**
+ Per-thread storage reused across predictions. A thread runs one prediction at a time, so
+ every predictor on the thread can share its buffer, while concurrent predictions on other
+ threads each get their own.
+ 
+ Scratch memory comes from an arena in utils that is reset when the outermost `withArena`
+ returns, so once a thread has seen requests of a given size scoring them doesn't call malloc.
+ */
+final class ScratchBuffer {
+    private static let threadDictionaryKey = "ai.improve.ScratchBuffer"
+    
+    private static let initialArenaCapacity = 1 << 16
+    
+    private let arena: OpaquePointer
+    
+    // nesting of withArena, the outermost resets the arena
+    private var depth = 0
+    
+    private var sparseRow = SparseRow()
+    
+    // XXH3 state for fingerprints, created on first use
+    private var hashState: OpaquePointer? = nil
+    
+    // hashState is in use, a fingerprint taken inside another gets state of its own
+    private var hashing = false
+    
+    static var current: ScratchBuffer {
+        let threadDictionary = Thread.current.threadDictionary
+        if let buffer = threadDictionary[threadDictionaryKey] as? ScratchBuffer {
+            return buffer
+        }
+        let buffer = ScratchBuffer()
+        threadDictionary[threadDictionaryKey] = buffer
+        return buffer
+    }
+    
+    private init() {
+        guard let arena = arena_create(Self.initialArenaCapacity) else {
+            fatalError("out of memory creating scratch arena")
+        }
+        self.arena = arena
+    }
+    
+    deinit {
+        arena_destroy(arena)
+        XXH3_freeState(hashState)
+    }
+    
+    // Counters of this thread's arena
+    var arenaStats: arena_stats_t {
+        var stats = arena_stats_t()
+        arena_stats(arena, &stats)
+        return stats
+    }
+    
+    /**
+     Calls body with the arena. Whatever body allocates from it is released when body returns.
+     */
+    func withArena<R>(_ body: (OpaquePointer) throws -> R) rethrows -> R {
+        let mark = arena_mark(arena)
+        depth += 1
+        defer {
+            depth -= 1
+            if depth == 0 {
+                arena_reset(arena)
+            } else {
+                arena_release(arena, mark)
+            }
+        }
+        return try body(arena)
+    }
+    
+    /**
+     Calls body with count floats, all NaN. Don't keep the pointer past body.
+     */
+    func withFeatures<R>(count: Int, _ body: (UnsafeMutableBufferPointer<Float>) throws -> R) throws -> R {
+        return try withArena { arena in
+            guard let p = arena_alloc(arena, max(count, 1) * MemoryLayout<Float>.stride, 64) else {
+                throw ImproveAIError.internalError(reason: "out of memory allocating \(count) features")
+            }
+            let features = UnsafeMutableBufferPointer(start: p.bindMemory(to: Float.self, capacity: count), count: count)
+            features.assign(repeating: Float.nan)
+            return try body(features)
+        }
+    }
+    
+    /**
+     Calls body with XXH3 state reset to seed, reused from call to call. Take the digest within body.
+     */
+    func withHashState<R>(seed: UInt64, _ body: (OpaquePointer) throws -> R) throws -> R {
+        if hashing {
+            guard let state = XXH3_createState() else {
+                throw ImproveAIError.internalError(reason: "out of memory creating hash state")
+            }
+            defer { XXH3_freeState(state) }
+            XXH3_64bits_reset_withSeed(state, seed)
+            return try body(state)
+        }
+        if hashState == nil {
+            hashState = XXH3_createState()
+        }
+        guard let state = hashState else {
+            throw ImproveAIError.internalError(reason: "out of memory creating hash state")
+        }
+        hashing = true
+        defer { hashing = false }
+        XXH3_64bits_reset_withSeed(state, seed)
+        return try body(state)
+    }
+    
+    /**
+     Calls body with an empty row for featureCount features, reused from call to call.
+     */
+    func withSparseRow<R>(featureCount: Int, _ body: (inout SparseRow) throws -> R) rethrows -> R {
+        if sparseRow.featureCount != featureCount {
+            sparseRow = SparseRow(featureCount: featureCount)
+        }
+        sparseRow.removeAll()
+        return try body(&sparseRow)
+    }
+}
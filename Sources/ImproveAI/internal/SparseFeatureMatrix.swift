@@ -0,0 +1,241 @@
+//
+//  SparseFeatureMatrix.swift
+//
+//
+//  Created on 2023/10/23.
+//
+
+import Foundation
+import utils
+
+/**
+ Where FeatureEncoder writes feature values, by feature index.
+ */
+protocol FeatureStorage {
+    init()
+    
+    mutating func set(_ value: Double, at featureIndex: Int)
+    
+    /**
+     Takes a string feature to be hashed later along with the rest of the batch. Returns false,
+     the default, when the storage doesn't collect strings and the value has to be set right away.
+     */
+    mutating func deferString(_ string: String, at featureIndex: Int) -> Bool
+}
+
+extension FeatureStorage {
+    mutating func deferString(_ string: String, at featureIndex: Int) -> Bool {
+        return false
+    }
+}
+
+extension Array: FeatureStorage where Element == Double {
+    mutating func set(_ value: Double, at featureIndex: Int) {
+        self[featureIndex] = value
+    }
+}
+
+/**
+ The features one item writes, in the order they were first written. Reused from item to item,
+ clearing only what the last item wrote. String features are kept as strings, NaN in values,
+ until `SparseFeatureMatrix.resolveStrings` hashes them for the whole batch.
+ */
+struct SparseRow: FeatureStorage {
+    private(set) var indexes: [Int] = []
+    
+    private(set) var values: [Double] = []
+    
+    // the string at each position still waiting to be hashed, nil for values
+    private(set) var strings: [String?] = []
+    
+    // position in indexes of each written feature, -1 for the others
+    private var positions: [Int] = []
+    
+    var featureCount: Int {
+        return positions.count
+    }
+    
+    init() {
+    }
+    
+    init(featureCount: Int) {
+        self.positions = [Int](repeating: -1, count: featureCount)
+    }
+    
+    mutating func set(_ value: Double, at featureIndex: Int) {
+        let position = positions[featureIndex]
+        if position >= 0 {
+            values[position] = value
+            strings[position] = nil
+        } else {
+            positions[featureIndex] = indexes.count
+            indexes.append(featureIndex)
+            values.append(value)
+            strings.append(nil)
+        }
+    }
+    
+    mutating func deferString(_ string: String, at featureIndex: Int) -> Bool {
+        set(Double.nan, at: featureIndex)
+        strings[positions[featureIndex]] = string
+        return true
+    }
+    
+    mutating func removeAll() {
+        for featureIndex in indexes {
+            positions[featureIndex] = -1
+        }
+        indexes.removeAll(keepingCapacity: true)
+        values.removeAll(keepingCapacity: true)
+        strings.removeAll(keepingCapacity: true)
+    }
+}
+
+/**
+ A batch as one dense context row shared by every item plus, per item, the (index, value) pairs
+ its own features overlay on it. Its size grows with the features items actually have rather
+ than with the width of the model. Values are Float32 like in `FeatureMatrix`.
+ */
+struct SparseFeatureMatrix {
+    let featureCount: Int
+    
+    let context: [Float]
+    
+    // the overlay of row r is [rowOffsets[r], rowOffsets[r + 1]) of indexes and values
+    private(set) var rowOffsets: [Int] = [0]
+    
+    private(set) var indexes: [Int32] = []
+    
+    private(set) var values: [Float] = []
+    
+    // UTF-8 of the deferred strings packed back to back, string i is [stringOffsets[i], stringOffsets[i + 1])
+    private var stringBytes: [UInt8] = []
+    
+    private var stringOffsets: [Int] = [0]
+    
+    // where in values each deferred string goes
+    private var stringPositions: [Int] = []
+    
+    var rowCount: Int {
+        return rowOffsets.count - 1
+    }
+    
+    init(context: [Float]) {
+        self.featureCount = context.count
+        self.context = context
+    }
+    
+    /**
+     Appends a row encoded without noise, adding the noise to all its values in one feature_sprinkle
+     pass. Deferred strings stay NaN until `resolveStrings`.
+     */
+    mutating func append(_ row: SparseRow, noiseShift: Float, noiseScale: Float) {
+        let start = values.count
+        for (position, featureIndex) in row.indexes.enumerated() {
+            if var string = row.strings[position] {
+                string.withUTF8 { stringBytes.append(contentsOf: $0) }
+                stringOffsets.append(stringBytes.count)
+                stringPositions.append(start + position)
+            }
+            indexes.append(Int32(featureIndex))
+        }
+        values.append(contentsOf: repeatElement(Float.nan, count: row.values.count))
+        values.withUnsafeMutableBufferPointer { values in
+            feature_sprinkle(row.values, row.values.count, Double(noiseShift), Double(noiseScale), nil, values.baseAddress.map { $0 + start })
+        }
+        rowOffsets.append(indexes.count)
+    }
+    
+    /**
+     Appends a row from an ItemCache, adding the noise like the other append.
+     */
+    mutating func append(_ row: ItemCache.Row, noiseShift: Float, noiseScale: Float) {
+        let start = values.count
+        indexes.append(contentsOf: row.indexes)
+        values.append(contentsOf: repeatElement(Float.nan, count: row.values.count))
+        values.withUnsafeMutableBufferPointer { values in
+            feature_sprinkle(row.values, row.values.count, Double(noiseShift), Double(noiseScale), nil, values.baseAddress.map { $0 + start })
+        }
+        rowOffsets.append(indexes.count)
+    }
+    
+    /**
+     Hashes every deferred string in one xxh3_64_batch call with seed and stores what value returns
+     for its feature index and hash.
+     */
+    mutating func resolveStrings(seed: UInt64, _ value: (_ featureIndex: Int, _ hash: UInt64) -> Double) {
+        guard !stringPositions.isEmpty else {
+            return
+        }
+        var hashes = [UInt64](repeating: 0, count: stringPositions.count)
+        stringBytes.withUnsafeBufferPointer { bytes in
+            stringOffsets.withUnsafeBufferPointer { offsets in
+                hashes.withUnsafeMutableBufferPointer { hashes in
+                    xxh3_64_batch(bytes.baseAddress, offsets.baseAddress, hashes.count, seed, hashes.baseAddress)
+                }
+            }
+        }
+        for (position, hash) in zip(stringPositions, hashes) {
+            values[position] = Float(value(Int(indexes[position]), hash))
+        }
+        stringBytes.removeAll()
+        stringOffsets.removeAll()
+        stringOffsets.append(0)
+        stringPositions.removeAll()
+    }
+    
+    /**
+     Calls body with each row in turn materialized in one dense buffer. Only the overlay of a row is
+     written and then restored, so the cost per row is the number of its features.
+     */
+    func forEachRow(_ body: (Int, UnsafeBufferPointer<Float>) throws -> Void) throws {
+        try ScratchBuffer.current.withFeatures(count: featureCount) { row in
+            _ = row.initialize(from: context)
+            for r in 0..<rowCount {
+                let overlay = rowOffsets[r]..<rowOffsets[r + 1]
+                for i in overlay {
+                    row[Int(indexes[i])] = values[i]
+                }
+                try body(r, UnsafeBufferPointer(row))
+                for i in overlay {
+                    row[Int(indexes[i])] = context[Int(indexes[i])]
+                }
+            }
+        }
+    }
+    
+    /**
+     Writes the rows into buffer with the given strides, value of feature f for row r at
+     r * rowStride + f * featureStride.
+     */
+    func densify(into buffer: UnsafeMutableBufferPointer<Float>, rowStride: Int, featureStride: Int) {
+        guard rowCount > 0 && featureCount > 0, let base = buffer.baseAddress else {
+            return
+        }
+        if featureStride == 1 {
+            context.withUnsafeBufferPointer { context in
+                for r in 0..<rowCount {
+                    (base + r * rowStride).assign(from: context.baseAddress!, count: featureCount)
+                }
+            }
+        } else {
+            // feature-major, each column is the context value repeated
+            for f in 0..<featureCount {
+                (base + f * featureStride).assign(repeating: context[f], count: rowCount)
+            }
+        }
+        for r in 0..<rowCount {
+            for i in rowOffsets[r]..<rowOffsets[r + 1] {
+                base[r * rowStride + Int(indexes[i]) * featureStride] = values[i]
+            }
+        }
+    }
+    
+    func dense() -> FeatureMatrix {
+        var matrix = FeatureMatrix(rowCount: rowCount, featureCount: featureCount)
+        matrix.values.withUnsafeMutableBufferPointer { values in
+            densify(into: values, rowStride: featureCount, featureStride: 1)
+        }
+        return matrix
+    }
+}
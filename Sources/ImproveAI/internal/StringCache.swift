@@ -0,0 +1,109 @@
+//
+//  StringCache.swift
+//
+//
+//  Created on 2023/11/6.
+//
+
+import Foundation
+
+/**
+ Counters of a Scorer's string or context caches, for string caches summed over its string features.
+ */
+public struct CacheStatistics {
+    /// Lookups answered from a cache.
+    public let hits: Int
+    
+    /// Lookups that had to encode the value.
+    public let misses: Int
+    
+    /// Entries dropped to stay within capacity.
+    public let evictions: Int
+    
+    /// Entries currently cached.
+    public let count: Int
+    
+    /// hits / (hits + misses), 0 before any lookup.
+    public var hitRate: Double {
+        let lookups = hits + misses
+        return lookups == 0 ? 0 : Double(hits) / Double(lookups)
+    }
+    
+    static func + (lhs: CacheStatistics, rhs: CacheStatistics) -> CacheStatistics {
+        return CacheStatistics(hits: lhs.hits + rhs.hits, misses: lhs.misses + rhs.misses, evictions: lhs.evictions + rhs.evictions, count: lhs.count + rhs.count)
+    }
+}
+
+/// The statistics of the string caches, from before the context cache shared them.
+public typealias StringCacheStatistics = CacheStatistics
+
+/**
+ Encoded values of recently seen strings of one string table, up to capacity of them.
+ 
+ Strings live in two generations. New strings go into the recent one, and once it holds half the
+ capacity the older generation is dropped and the recent one takes its place. A hit in the older
+ generation moves the string back into the recent one, so strings in steady use are never evicted
+ and the cache as a whole behaves close to LRU without any per entry bookkeeping.
+ */
+final class StringCache {
+    let capacity: Int
+    
+    private var recent: [String : Double] = [:]
+    
+    private var older: [String : Double] = [:]
+    
+    private var hits = 0
+    
+    private var misses = 0
+    
+    private var evictions = 0
+    
+    private let lock = NSLock()
+    
+    init(capacity: Int) {
+        self.capacity = max(capacity, 2)
+    }
+    
+    /**
+     The cached value of string, or encode(string) remembered for next time.
+     */
+    func value(for string: String, encode: (String) -> Double) -> Double {
+        lock.lock()
+        if let value = recent[string] {
+            hits += 1
+            lock.unlock()
+            return value
+        }
+        if let value = older.removeValue(forKey: string) {
+            hits += 1
+            insert(string, value)
+            lock.unlock()
+            return value
+        }
+        misses += 1
+        lock.unlock()
+        
+        // hashed outside the lock, a racing thread at worst computes the same value twice
+        let value = encode(string)
+        
+        lock.lock()
+        insert(string, value)
+        lock.unlock()
+        return value
+    }
+    
+    var statistics: CacheStatistics {
+        lock.lock()
+        defer { lock.unlock() }
+        return CacheStatistics(hits: hits, misses: misses, evictions: evictions, count: recent.count + older.count)
+    }
+    
+    private func insert(_ string: String, _ value: Double) {
+        if recent.count >= capacity / 2 {
+            evictions += older.count
+            older = recent
+            recent = [:]
+        }
+        recent[string] = value
+    }
+}
@@ -0,0 +1,202 @@
+//
+//  TreeEnsemblePredictor.swift
+//
+//
+//  Created on 2023/7/24.
+//
+
+import Foundation
+import utils
+
+/**
+ Evaluates the TreeEnsembleRegressor of a plain or gzip compressed .mlmodel with the
+ tree_ensemble engine in utils, without CoreML. Batches are scored feature-major with
+ the SIMD kernel, or optionally row by row with the QuickScorer layout.
+ 
+ With context pruning, large batches first resolve every branch on a context feature,
+ which has the same value for all items of a call, and only walk the item branches left.
+ */
+final class TreeEnsemblePredictor: Predictor {
+    let model: UnsafeMutablePointer<tree_ensemble_t>
+    
+    let quickScorer: UnsafeMutablePointer<quickscorer_t>?
+    
+    let simd: UnsafeMutablePointer<tree_simd_t>?
+    
+    // 1 for features encoded from the context, set when pruning
+    let contextFeatures: [UInt8]?
+    
+    // Below this many rows pruning costs more than walking the context branches of each row
+    static let contextPruningMinRows = 32
+    
+    // Tree at a time evaluation only pays off when most rows can be dropped early
+    static let topKMaxFraction = 0.25
+    
+    let featureNames: [String]
+    
+    let metadata: [String : String]
+    
+    init(modelUrl: URL, quickScorer: Bool = false, contextPruning: Bool = false) throws {
+        let data = try Data(contentsOf: modelUrl)
+        var model: UnsafeMutablePointer<tree_ensemble_t>?
+        let status = data.withUnsafeBytes { (p: UnsafeRawBufferPointer) in
+            tree_ensemble_load(p.bindMemory(to: UInt8.self).baseAddress, p.count, &model)
+        }
+        switch status {
+        case 0:
+            break
+        case ERR_TE_UNSUPPORTED_MODEL:
+            throw ImproveAIError.invalidModel(reason: "\(modelUrl) is not a tree ensemble regressor")
+        case ERR_TE_OUT_OF_MEMORY:
+            throw ImproveAIError.internalError(reason: "out of memory loading \(modelUrl)")
+        default:
+            throw ImproveAIError.invalidModel(reason: "failed to parse \(modelUrl) (\(status)). Is it a valid model?")
+        }
+        self.model = model!
+        
+        if quickScorer {
+            var scorer: UnsafeMutablePointer<quickscorer_t>?
+            guard quickscorer_build(model, &scorer) == 0 else {
+                tree_ensemble_free(model)
+                throw ImproveAIError.internalError(reason: "out of memory building QuickScorer layout")
+            }
+            self.quickScorer = scorer
+            self.simd = nil
+        } else {
+            var simd: UnsafeMutablePointer<tree_simd_t>?
+            guard tree_simd_build(model, &simd) == 0 else {
+                tree_ensemble_free(model)
+                throw ImproveAIError.internalError(reason: "out of memory building SIMD layout")
+            }
+            self.quickScorer = nil
+            self.simd = simd
+        }
+        
+        let m = model!.pointee
+        self.featureNames = (0..<m.feature_count).map { String(cString: m.feature_names[$0]!) }
+        self.metadata = (0..<m.metadata_count).reduce(into: [String : String]()) { partialResult, i in
+            partialResult[String(cString: m.metadata_keys[i]!)] = String(cString: m.metadata_values[i]!)
+        }
+        // FeatureEncoder encodes the context under the "context" path
+        self.contextFeatures = contextPruning ? featureNames.map { $0 == "context" || $0.hasPrefix("context.") ? 1 : 0 } : nil
+    }
+    
+    deinit {
+        quickscorer_free(quickScorer)
+        tree_simd_free(simd)
+        tree_ensemble_free(model)
+    }
+    
+    func predict(featureVectors: [[Double]]) throws -> [Double] {
+        // narrow to Float32 like FeatureProvider does for CoreML
+        return try predict(features: FeatureMatrix(featureVectors: featureVectors, featureCount: featureNames.count))
+    }
+    
+    func predict(features: FeatureMatrix) throws -> [Double] {
+        let rowCount = features.rowCount
+        let featureCount = features.featureCount
+        var result = [Double](repeating: 0, count: rowCount)
+        try features.values.withUnsafeBufferPointer { rows in
+            try result.withUnsafeMutableBufferPointer { out in
+                if let quickScorer = quickScorer {
+                    // QuickScorer reads row-major like the matrix
+                    quickscorer_predict(quickScorer, rows.baseAddress, rowCount, out.baseAddress)
+                    return
+                }
+                // the SIMD kernel reads feature-major
+                try ScratchBuffer.current.withFeatures(count: rowCount * featureCount) { columns in
+                    for row in 0..<rowCount {
+                        for i in 0..<featureCount {
+                            columns[i * rowCount + row] = rows[row * featureCount + i]
+                        }
+                    }
+                    
+                    let x = UnsafePointer(columns.baseAddress)
+                    if let contextFeatures = contextFeatures, rowCount >= Self.contextPruningMinRows {
+                        // items are encoded on top of a copy of the context vector, any row has its values
+                        try predictPruned(context: rows.baseAddress, contextFeatures: contextFeatures, columns: x, rowCount: rowCount, out: out.baseAddress)
+                    } else {
+                        tree_simd_predict(simd, x, rowCount, out.baseAddress)
+                    }
+                }
+            }
+        }
+        return result
+    }
+    
+    func predict(sparseFeatures features: SparseFeatureMatrix) throws -> [Double] {
+        let rowCount = features.rowCount
+        let featureCount = features.featureCount
+        // QuickScorer reads row-major, the SIMD kernel reads feature-major
+        let (rowStride, featureStride) = quickScorer != nil ? (featureCount, 1) : (1, rowCount)
+        var result = [Double](repeating: 0, count: rowCount)
+        try ScratchBuffer.current.withFeatures(count: rowCount * featureCount) { buffer in
+            features.densify(into: buffer, rowStride: rowStride, featureStride: featureStride)
+            
+            let x = UnsafePointer(buffer.baseAddress)
+            try result.withUnsafeMutableBufferPointer { out in
+                if let quickScorer = quickScorer {
+                    quickscorer_predict(quickScorer, x, rowCount, out.baseAddress)
+                } else if let contextFeatures = contextFeatures, rowCount >= Self.contextPruningMinRows {
+                    try features.context.withUnsafeBufferPointer { context in
+                        try predictPruned(context: context.baseAddress, contextFeatures: contextFeatures, columns: x, rowCount: rowCount, out: out.baseAddress)
+                    }
+                } else {
+                    tree_simd_predict(simd, x, rowCount, out.baseAddress)
+                }
+            }
+        }
+        return result
+    }
+    
+    func predictTopK(featureVectors: [[Double]], k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        return try predictTopK(features: FeatureMatrix(featureVectors: featureVectors, featureCount: featureNames.count), k: k, margin: margin)
+    }
+    
+    func predictTopK(features: FeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        let rowCount = features.rowCount
+        guard Double(k) <= Double(rowCount) * Self.topKMaxFraction else {
+            return try predict(features: features).enumerated().map { ($0.offset, $0.element) }
+        }
+        
+        var rows = [Int](repeating: 0, count: rowCount)
+        var scores = [Double](repeating: 0, count: rowCount)
+        let count = ScratchBuffer.current.withArena { arena in
+            features.values.withUnsafeBufferPointer { x in
+                rows.withUnsafeMutableBufferPointer { rows in
+                    scores.withUnsafeMutableBufferPointer { scores in
+                        tree_ensemble_top_k_arena(model, x.baseAddress, rowCount, k, margin, arena, rows.baseAddress, scores.baseAddress)
+                    }
+                }
+            }
+        }
+        guard count >= 0 else {
+            throw ImproveAIError.internalError(reason: "out of memory ranking top \(k)")
+        }
+        return (0..<count).map { (rows[$0], scores[$0]) }
+    }
+    
+    func predictTopK(sparseFeatures features: SparseFeatureMatrix, k: Int, margin: Double) throws -> [(index: Int, score: Double)] {
+        guard Double(k) <= Double(features.rowCount) * Self.topKMaxFraction else {
+            return try predict(sparseFeatures: features).enumerated().map { ($0.offset, $0.element) }
+        }
+        return try predictTopK(features: features.dense(), k: k, margin: margin)
+    }
+    
+    private func predictPruned(context: UnsafePointer<Float>?, contextFeatures: [UInt8], columns: UnsafePointer<Float>?, rowCount: Int, out: UnsafeMutablePointer<Double>?) throws {
+        // the partial ensemble and its layout only live for this call
+        try ScratchBuffer.current.withArena { arena in
+            var partial: UnsafeMutablePointer<tree_ensemble_t>?
+            guard tree_ensemble_partial_arena(model, context, contextFeatures, arena, &partial) == 0 else {
+                throw ImproveAIError.internalError(reason: "out of memory pruning context branches")
+            }
+            
+            var simd: UnsafeMutablePointer<tree_simd_t>?
+            guard tree_simd_build_arena(partial, arena, &simd) == 0 else {
+                throw ImproveAIError.internalError(reason: "out of memory building SIMD layout")
+            }
+            
+            tree_simd_predict(simd, columns, rowCount, out)
+        }
+    }
+}
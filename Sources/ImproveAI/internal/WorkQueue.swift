@@ -0,0 +1,49 @@
+//
+//  WorkQueue.swift
+//
+//
+//  Created on 2023/9/11.
+//
+
+import Foundation
+
+/**
+ Splits 0..<count into chunks of chunkSize and runs body over them on up to threadCount threads.
+ Each worker claims the next unclaimed chunk whenever it finishes one, so threads that draw
+ cheap chunks take over the remaining work instead of idling behind a slow one.
+ 
+ After the first error no new chunks are started, and that error is rethrown once every
+ running chunk has finished.
+ */
+func forEachChunk(count: Int, chunkSize: Int, threadCount: Int, _ body: (Range<Int>) throws -> Void) throws {
+    let chunkCount = (count + chunkSize - 1) / chunkSize
+    let lock = NSLock()
+    var nextChunk = 0
+    var firstError: Error?
+    
+    DispatchQueue.concurrentPerform(iterations: max(1, min(threadCount, chunkCount))) { _ in
+        while true {
+            lock.lock()
+            let chunk = firstError == nil ? nextChunk : chunkCount
+            nextChunk += 1
+            lock.unlock()
+            if chunk >= chunkCount {
+                return
+            }
+            
+            do {
+                try body(chunk * chunkSize..<min(count, (chunk + 1) * chunkSize))
+            } catch {
+                lock.lock()
+                if firstError == nil {
+                    firstError = error
+                }
+                lock.unlock()
+            }
+        }
+    }
+    
+    if let error = firstError {
+        throw error
+    }
+}
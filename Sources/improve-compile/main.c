@@ -0,0 +1,280 @@
+//
+//  main.c
+//  improve-compile
+//
+//  Created on 2023/8/14.
+//
+//  Compiles the tree ensemble of a plain or gzip compressed .mlmodel into a C
+//  translation unit with one function of nested if/else branches per tree, the
+//  feature indexes and thresholds folded in as constants.
+//
+//  usage: improve-compile <model.mlmodel[.gz]> <name> <output directory>
+//
+//  Writes <output directory>/<name>.c and <output directory>/include/<name>.h,
+//  which is the layout of a SwiftPM C target. The header declares
+//
+//      extern const compiled_model_t <name>;
+//      void <name>_score(const float *features, size_t n, double *out);
+//
+//  Add the directory as a target depending on ImproveAI and pass <name> to
+//  Scorer(compiledModel:). Everything else the unit defines is static and
+//  prefixed with <name>_, so several compiled models can link into one binary.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "tree_ensemble.h"
+
+static int read_file(const char *path, uint8_t **data, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    size_t capacity = 1 << 20, length = 0;
+    uint8_t *buffer = malloc(capacity);
+    while (buffer) {
+        length += fread(buffer + length, 1, capacity - length, f);
+        if (length < capacity) {
+            break;
+        }
+        uint8_t *grown = realloc(buffer, capacity * 2);
+        if (!grown) {
+            free(buffer);
+            buffer = NULL;
+            break;
+        }
+        buffer = grown;
+        capacity *= 2;
+    }
+    int failed = !buffer || ferror(f);
+    fclose(f);
+    if (failed) {
+        free(buffer);
+        return -1;
+    }
+    *data = buffer;
+    *size = length;
+    return 0;
+}
+
+static int is_identifier(const char *name) {
+    if (!(*name == '_' || (*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z'))) {
+        return 0;
+    }
+    for (const char *c = name; *c; c++) {
+        if (!(*c == '_' || (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Identifiers the generated unit would clash with: C keywords and what it uses from its headers
+static const char *const reserved_names[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+    "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+    "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+    "volatile", "while", "exp", "NAN", "NULL", "size_t", "compiled_model", "compiled_model_t",
+};
+
+static int is_reserved(const char *name) {
+    // names starting with an underscore and an uppercase letter or a second underscore are the implementation's
+    if (name[0] == '_' && (name[1] == '_' || (name[1] >= 'A' && name[1] <= 'Z'))) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(reserved_names) / sizeof(reserved_names[0]); i++) {
+        if (strcmp(name, reserved_names[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Hex floating point literals round trip exactly
+static void write_number(FILE *out, double value, const char *suffix) {
+    if (value != value) {
+        fprintf(out, "NAN");
+    } else if (isinf(value)) {
+        fprintf(out, value < 0 ? "-INFINITY" : "INFINITY");
+    } else {
+        fprintf(out, "%a%s", value, suffix);
+    }
+}
+
+static void write_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (size_t column = 0; *s; s++, column++) {
+        if (column == 100) {
+            // long metadata values like string tables are split into adjacent literals
+            fprintf(out, "\"\n        \"");
+            column = 0;
+        }
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\' || c == '?') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_strings(FILE *out, const char *name, const char *declaration, char **strings, size_t count) {
+    fprintf(out, "static const char *const %s_%s[] = {\n", name, declaration);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "    ");
+        write_string(out, strings[i]);
+        fprintf(out, ",\n");
+    }
+    // an empty initializer list isn't valid C
+    fprintf(out, "%s};\n\n", count == 0 ? "    NULL,\n" : "");
+}
+
+static void write_subtree(FILE *out, const tree_ensemble_t *model, int32_t ref, int indent) {
+    if (ref < 0) {
+        fprintf(out, "%*sreturn ", indent, "");
+        write_number(out, model->leaves[~ref], "");
+        fprintf(out, ";\n");
+        return;
+    }
+    const tree_node_t *node = &model->nodes[ref];
+    fprintf(out, "%*sif (", indent, "");
+    // NaN fails both comparisons, so negating >= sends it left
+    if (node->feature & TREE_NODE_MISSING_LEFT) {
+        fprintf(out, "!(x[%u] >= ", node->feature & TREE_NODE_FEATURE_MASK);
+        write_number(out, node->threshold, "f");
+        fprintf(out, ")");
+    } else {
+        fprintf(out, "x[%u] < ", node->feature & TREE_NODE_FEATURE_MASK);
+        write_number(out, node->threshold, "f");
+    }
+    fprintf(out, ") {\n");
+    write_subtree(out, model, node->left, indent + 4);
+    fprintf(out, "%*s}\n", indent, "");
+    write_subtree(out, model, node->right, indent);
+}
+
+static void write_source(FILE *out, const tree_ensemble_t *model, const char *name, const char *model_path) {
+    fprintf(out, "//\n//  %s.c\n//\n//  Generated by improve-compile from %s. Do not edit.\n//\n\n", name, model_path);
+    fprintf(out, "#include <math.h>\n#include <stddef.h>\n\n#include \"%s.h\"\n\n", name);
+
+    write_strings(out, name, "feature_names", model->feature_names, model->feature_count);
+    write_strings(out, name, "metadata_keys", model->metadata_keys, model->metadata_count);
+    write_strings(out, name, "metadata_values", model->metadata_values, model->metadata_count);
+
+    for (size_t t = 0; t < model->tree_count; t++) {
+        fprintf(out, "static double %s_tree_%zu(const float *x) {\n", name, t);
+        if (model->roots[t] < 0) {
+            fprintf(out, "    (void)x;\n");
+        }
+        write_subtree(out, model, model->roots[t], 4);
+        fprintf(out, "}\n\n");
+    }
+
+    fprintf(out, "void %s_score(const float *features, size_t n, double *out) {\n", name);
+    fprintf(out, "    for (size_t i = 0; i < n; i++) {\n");
+    fprintf(out, "        const float *x = features + i * %zu;\n", model->feature_count);
+    fprintf(out, "        double sum = ");
+    write_number(out, model->base_value, "");
+    fprintf(out, ";\n");
+    // same order of additions as tree_ensemble_predict
+    for (size_t t = 0; t < model->tree_count; t++) {
+        fprintf(out, "        sum += %s_tree_%zu(x);\n", name, t);
+    }
+    if (model->transform == TREE_ENSEMBLE_TRANSFORM_LOGISTIC) {
+        fprintf(out, "        out[i] = 1.0 / (1.0 + exp(-sum));\n");
+    } else {
+        fprintf(out, "        out[i] = sum;\n");
+    }
+    fprintf(out, "    }\n}\n\n");
+
+    fprintf(out, "const compiled_model_t %s = {\n", name);
+    fprintf(out, "    %zu,\n    %s_feature_names,\n", model->feature_count, name);
+    fprintf(out, "    %zu,\n    %s_metadata_keys,\n    %s_metadata_values,\n", model->metadata_count, name, name);
+    fprintf(out, "    %s_score,\n};\n", name);
+}
+
+static void write_header(FILE *out, const char *name, const char *model_path) {
+    fprintf(out, "//\n//  %s.h\n//\n//  Generated by improve-compile from %s. Do not edit.\n//\n\n", name, model_path);
+    fprintf(out, "#ifndef %s_h\n#define %s_h\n\n", name, name);
+    fprintf(out, "#include <stddef.h>\n\n#include \"compiled_model.h\"\n\n");
+    fprintf(out, "extern const compiled_model_t %s;\n\n", name);
+    fprintf(out, "void %s_score(const float *features, size_t n, double *out);\n\n", name);
+    fprintf(out, "#endif /* %s_h */\n", name);
+}
+
+static int write_file(const char *path, const tree_ensemble_t *model, const char *name, const char *model_path, int header) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        return -1;
+    }
+    if (header) {
+        write_header(out, name, model_path);
+    } else {
+        write_source(out, model, name, model_path);
+    }
+    int failed = ferror(out);
+    return fclose(out) != 0 || failed ? -1 : 0;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: improve-compile <model.mlmodel[.gz]> <name> <output directory>\n");
+        return 2;
+    }
+    const char *model_path = argv[1], *name = argv[2], *directory = argv[3];
+    if (!is_identifier(name)) {
+        fprintf(stderr, "improve-compile: %s is not a valid C identifier\n", name);
+        return 2;
+    }
+    if (is_reserved(name)) {
+        fprintf(stderr, "improve-compile: %s is reserved, choose another name\n", name);
+        return 2;
+    }
+
+    uint8_t *data;
+    size_t size;
+    if (read_file(model_path, &data, &size) != 0) {
+        fprintf(stderr, "improve-compile: failed to read %s: %s\n", model_path, strerror(errno));
+        return 1;
+    }
+    tree_ensemble_t *model;
+    int status = tree_ensemble_load(data, size, &model);
+    free(data);
+    if (status != 0) {
+        fprintf(stderr, "improve-compile: failed to load %s (%d). Is it a tree ensemble regressor?\n", model_path, status);
+        return 1;
+    }
+
+    size_t length = strlen(directory) + strlen(name) + 16;
+    char *include = malloc(length), *source = malloc(length), *header = malloc(length);
+    if (!include || !source || !header) {
+        fprintf(stderr, "improve-compile: out of memory\n");
+        return 1;
+    }
+    snprintf(include, length, "%s/include", directory);
+    snprintf(source, length, "%s/%s.c", directory, name);
+    snprintf(header, length, "%s/include/%s.h", directory, name);
+
+    if ((mkdir(directory, 0755) != 0 && errno != EEXIST) || (mkdir(include, 0755) != 0 && errno != EEXIST)) {
+        fprintf(stderr, "improve-compile: failed to create %s: %s\n", include, strerror(errno));
+        return 1;
+    }
+    if (write_file(source, model, name, model_path, 0) != 0 || write_file(header, model, name, model_path, 1) != 0) {
+        fprintf(stderr, "improve-compile: failed to write %s: %s\n", directory, strerror(errno));
+        return 1;
+    }
+
+    tree_ensemble_free(model);
+    free(include);
+    free(source);
+    free(header);
+    return 0;
+}
@@ -0,0 +1,199 @@
+//
+//  arena.c
+//
+//
+//  Created on 2023/10/30.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define MIN_BLOCK_CAPACITY 4096
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t capacity;
+    size_t used;
+    // data follows, aligned to max_align_t
+} arena_block_t;
+
+struct arena {
+    arena_block_t *first;
+    arena_block_t *current;
+
+    size_t system_allocations;
+    size_t system_frees;
+    size_t allocations;
+    size_t resets;
+    size_t used;
+    size_t high_water;
+};
+
+#define BLOCK_HEADER ((sizeof(arena_block_t) + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t))
+
+static uint8_t *block_data(arena_block_t *block) {
+    return (uint8_t *)block + BLOCK_HEADER;
+}
+
+static arena_block_t *new_block(arena_t *arena, size_t capacity) {
+    arena_block_t *block = malloc(BLOCK_HEADER + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    arena->system_allocations++;
+    return block;
+}
+
+arena_t *arena_create(size_t capacity) {
+    arena_t *arena = calloc(1, sizeof(arena_t));
+    if (!arena) {
+        return NULL;
+    }
+    arena->first = arena->current = new_block(arena, capacity < MIN_BLOCK_CAPACITY ? MIN_BLOCK_CAPACITY : capacity);
+    if (!arena->first) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+static void free_blocks(arena_t *arena) {
+    arena_block_t *block = arena->first;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        arena->system_frees++;
+        block = next;
+    }
+    arena->first = arena->current = NULL;
+}
+
+void arena_destroy(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+    free_blocks(arena);
+    free(arena);
+}
+
+// offset of the first byte at or after used whose address is aligned
+static size_t aligned_offset(arena_block_t *block, size_t align) {
+    uintptr_t address = (uintptr_t)(block_data(block) + block->used);
+    return block->used + ((align - (address & (align - 1))) & (align - 1));
+}
+
+static int fits(arena_block_t *block, size_t size, size_t align, size_t *offset) {
+    *offset = aligned_offset(block, align);
+    return *offset <= block->capacity && size <= block->capacity - *offset;
+}
+
+void *arena_alloc(arena_t *arena, size_t size, size_t align) {
+    arena_block_t *block = arena->current;
+    size_t offset;
+    while (!fits(block, size, align, &offset)) {
+        arena_block_t *next = block->next;
+        if (next) {
+            // a spare block kept from before a release, dropped when too small
+            next->used = 0;
+            if (fits(next, size, align, &offset)) {
+                block = next;
+                break;
+            }
+            block->next = next->next;
+            free(next);
+            arena->system_frees++;
+            continue;
+        }
+        size_t capacity = block->capacity * 2;
+        if (capacity < size + align) {
+            capacity = size + align;
+        }
+        next = new_block(arena, capacity);
+        if (!next) {
+            return NULL;
+        }
+        block->next = next;
+        block = next;
+    }
+    arena->current = block;
+
+    size_t previous = block->used;
+    block->used = offset + size;
+    arena->used += block->used - previous;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    arena->allocations++;
+    return block_data(block) + offset;
+}
+
+void *arena_calloc(arena_t *arena, size_t size, size_t align) {
+    void *p = arena_alloc(arena, size, align);
+    if (p) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+arena_mark_t arena_mark(const arena_t *arena) {
+    arena_mark_t mark = { arena->current, arena->current->used };
+    return mark;
+}
+
+void arena_release(arena_t *arena, arena_mark_t mark) {
+    arena_block_t *block = mark.block;
+    // bytes allocated since the mark, in the block it was taken in and every block after it up to current
+    size_t released = block->used - mark.used;
+    for (arena_block_t *b = block; b != arena->current; ) {
+        b = b->next;
+        released += b->used;
+        b->used = 0;
+    }
+    arena->used -= released;
+    block->used = mark.used;
+    arena->current = block;
+}
+
+void arena_reset(arena_t *arena) {
+    arena->resets++;
+    arena->used = 0;
+    if (arena->first->next) {
+        // one block for the most this arena has needed, plus room for alignment
+        size_t capacity = 0;
+        for (arena_block_t *b = arena->first; b; b = b->next) {
+            capacity += b->capacity;
+        }
+        if (capacity < arena->high_water * 2) {
+            capacity = arena->high_water * 2;
+        }
+        arena_block_t *merged = new_block(arena, capacity);
+        if (merged) {
+            free_blocks(arena);
+            arena->first = arena->current = merged;
+            return;
+        }
+    }
+    for (arena_block_t *b = arena->first; b; b = b->next) {
+        b->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+void arena_stats(const arena_t *arena, arena_stats_t *stats) {
+    stats->system_allocations = arena->system_allocations;
+    stats->system_frees = arena->system_frees;
+    stats->allocations = arena->allocations;
+    stats->resets = arena->resets;
+    stats->capacity = 0;
+    for (arena_block_t *b = arena->first; b; b = b->next) {
+        stats->capacity += b->capacity;
+    }
+    stats->used = arena->used;
+    stats->high_water = arena->high_water;
+}
@@ -0,0 +1,123 @@
+//
+//  feature_kernels.c
+//
+//
+//  Created on 2023/12/4.
+//
+
+#include <string.h>
+
+#include "feature_kernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FEATURE_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define FEATURE_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Values written one at a time before the rest is copied from them in doubling chunks
+#define FILL_SEED 16
+
+void feature_fill(float *values, size_t count, float value) {
+    size_t filled = count < FILL_SEED ? count : FILL_SEED;
+    for (size_t i = 0; i < filled; i++) {
+        values[i] = value;
+    }
+    while (filled < count) {
+        size_t n = count - filled < filled ? count - filled : filled;
+        memcpy(values + filled, values, n * sizeof(float));
+        filled += n;
+    }
+}
+
+void feature_fill_f64(double *values, size_t count, double value) {
+    size_t filled = count < FILL_SEED ? count : FILL_SEED;
+    for (size_t i = 0; i < filled; i++) {
+        values[i] = value;
+    }
+    while (filled < count) {
+        size_t n = count - filled < filled ? count - filled : filled;
+        memcpy(values + filled, values, n * sizeof(double));
+        filled += n;
+    }
+}
+
+void feature_fill_rows(float *matrix, size_t row_count, const float *row, size_t feature_count) {
+    if (row_count == 0 || feature_count == 0) {
+        return;
+    }
+    memcpy(matrix, row, feature_count * sizeof(float));
+    size_t filled = 1;
+    while (filled < row_count) {
+        size_t n = row_count - filled < filled ? row_count - filled : filled;
+        memcpy(matrix + filled * feature_count, matrix, n * feature_count * sizeof(float));
+        filled += n;
+    }
+}
+
+// The result is NaN exactly where x is, shift is tiny and scale is close to 1
+static inline float sprinkle(double x, double shift, double scale) {
+    return (float)((x + shift) * scale);
+}
+
+#ifdef FEATURE_KERNELS_X86
+
+static int has_avx(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+}
+
+// sprinkles the first multiple of 4 values, returns how many
+__attribute__((target("avx")))
+static size_t sprinkle_avx(const double *x, size_t count, double shift, double scale, const float *base, float *out) {
+    const __m256d s = _mm256_set1_pd(shift);
+    const __m256d c = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 y = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(x + i), s), c));
+        if (base) {
+            y = _mm_blendv_ps(y, _mm_loadu_ps(base + i), _mm_cmpunord_ps(y, y));
+        }
+        _mm_storeu_ps(out + i, y);
+    }
+    return i;
+}
+
+#endif
+
+#ifdef FEATURE_KERNELS_NEON
+
+static size_t sprinkle_neon(const double *x, size_t count, double shift, double scale, const float *base, float *out) {
+    const float64x2_t s = vdupq_n_f64(shift);
+    const float64x2_t c = vdupq_n_f64(scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x2_t lo = vcvt_f32_f64(vmulq_f64(vaddq_f64(vld1q_f64(x + i), s), c));
+        float32x2_t hi = vcvt_f32_f64(vmulq_f64(vaddq_f64(vld1q_f64(x + i + 2), s), c));
+        float32x4_t y = vcombine_f32(lo, hi);
+        if (base) {
+            y = vbslq_f32(vceqq_f32(y, y), y, vld1q_f32(base + i));
+        }
+        vst1q_f32(out + i, y);
+    }
+    return i;
+}
+
+#endif
+
+void feature_sprinkle(const double *x, size_t count, double shift, double scale, const float *base, float *out) {
+    size_t i = 0;
+#if defined(FEATURE_KERNELS_X86)
+    if (count >= 4 && has_avx()) {
+        i = sprinkle_avx(x, count, shift, scale, base, out);
+    }
+#elif defined(FEATURE_KERNELS_NEON)
+    i = sprinkle_neon(x, count, shift, scale, base, out);
+#endif
+    for (; i < count; i++) {
+        float y = sprinkle(x[i], shift, scale);
+        out[i] = (y != y && base) ? base[i] : y;
+    }
+}
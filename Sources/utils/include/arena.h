@@ -0,0 +1,76 @@
+//
+//  arena.h
+//
+//
+//  Created on 2023/10/30.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+
+/*
+ A bump allocator for scratch memory that lives for one request. Allocations
+ are never freed one by one; the arena is released back to a mark or reset as
+ a whole and its memory reused by the next request.
+
+ Memory comes in blocks. When a block fills up a bigger one is added, earlier
+ blocks stay valid, and arena_reset merges them into a single block big enough
+ for everything the arena held at its fullest. After a few requests of similar
+ size an arena stops calling malloc and free altogether, which the counters in
+ arena_stats_t show.
+
+ An arena is not thread safe, use one per thread.
+ */
+typedef struct arena arena_t;
+
+typedef struct arena_mark {
+    void *block;
+    size_t used;
+} arena_mark_t;
+
+typedef struct arena_stats {
+    // calls to malloc and free for blocks since the arena was created
+    size_t system_allocations;
+    size_t system_frees;
+
+    size_t allocations;
+    size_t resets;
+
+    // bytes in all blocks, bytes allocated since the last reset and the most ever allocated between resets
+    size_t capacity;
+    size_t used;
+    size_t high_water;
+} arena_stats_t;
+
+// NULL when out of memory
+arena_t *arena_create(size_t capacity);
+
+void arena_destroy(arena_t *arena);
+
+/*
+ Returns size bytes aligned to align, a power of two up to 4096, or NULL when
+ out of memory. The memory is uninitialized.
+ */
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+
+// Same as arena_alloc with zeroed memory
+void *arena_calloc(arena_t *arena, size_t size, size_t align);
+
+arena_mark_t arena_mark(const arena_t *arena);
+
+/*
+ Frees everything allocated after mark was taken. Blocks added since are kept
+ for the allocations that follow.
+ */
+void arena_release(arena_t *arena, arena_mark_t mark);
+
+/*
+ Frees everything, merging the blocks into one when there is more than one.
+ */
+void arena_reset(arena_t *arena);
+
+void arena_stats(const arena_t *arena, arena_stats_t *stats);
+
+#endif /* arena_h */
@@ -0,0 +1,34 @@
+//
+//  compiled_model.h
+//
+//
+//  Created on 2023/8/14.
+//
+
+#ifndef compiled_model_h
+#define compiled_model_h
+
+#include <stddef.h>
+
+/*
+ A tree ensemble compiled ahead of time by improve-compile. The generated
+ translation unit defines one of these per model along with the input feature
+ names and user defined metadata of the .mlmodel it was compiled from, so that
+ a Scorer can be created from it without the model file.
+ */
+typedef struct compiled_model {
+    size_t feature_count;
+    const char *const *feature_names;
+
+    size_t metadata_count;
+    const char *const *metadata_keys;
+    const char *const *metadata_values;
+
+    /*
+     Scores n row-major feature vectors of feature_count floats each, NaN marking
+     a missing feature. Results are bit identical to tree_ensemble_predict.
+     */
+    void (*score)(const float *features, size_t n, double *out);
+} compiled_model_t;
+
+#endif /* compiled_model_h */
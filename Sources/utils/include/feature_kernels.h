@@ -0,0 +1,39 @@
+//
+//  feature_kernels.h
+//
+//
+//  Created on 2023/12/4.
+//
+
+#ifndef feature_kernels_h
+#define feature_kernels_h
+
+#include <stddef.h>
+
+/*
+ Sets count floats to value, usually NaN for features that are missing.
+ */
+void feature_fill(float *values, size_t count, float value);
+
+/*
+ Sets count doubles to value.
+ */
+void feature_fill_f64(double *values, size_t count, double value);
+
+/*
+ Copies row, feature_count floats, into each of the row_count rows of matrix,
+ which are stored one after the other.
+ */
+void feature_fill_rows(float *matrix, size_t row_count, const float *row, size_t feature_count);
+
+/*
+ Adds the encoder's noise to count values encoded without it and narrows them,
+ out[i] = (float)((x[i] + shift) * scale), rounded exactly as that expression is
+ in C or Swift. Where x[i] is NaN, a missing feature, out[i] is base[i] instead,
+ or NaN when base is NULL. out may be base.
+
+ Uses AVX on x86_64 CPUs that have it and NEON on arm64.
+ */
+void feature_sprinkle(const double *x, size_t count, double shift, double scale, const float *base, float *out);
+
+#endif /* feature_kernels_h */
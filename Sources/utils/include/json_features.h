@@ -0,0 +1,80 @@
+//
+//  json_features.h
+//
+//
+//  Created on 2023/11/20.
+//
+
+#ifndef json_features_h
+#define json_features_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define ERR_JSON_INVALID -1
+#define ERR_JSON_OUT_OF_MEMORY -2
+#define ERR_JSON_TOO_DEEP -3
+#define ERR_JSON_NOT_AN_ARRAY -4
+
+// Arrays and objects nested deeper than this are rejected
+#define JSON_MAX_DEPTH 512
+
+/*
+ The feature path nodes of a model, the same trie FeaturePathIndex builds:
+ node 0 is the root, the segment of node i is
+ segment_bytes[segment_offsets[i], segment_offsets[i + 1]) and its hash is
+ XXH3_64bits_withSeed of the segment seeded with the hash of parents[i].
+ feature_indexes[i] is the feature of node i or -1.
+ */
+typedef struct json_features json_features_t;
+
+// NULL when out of memory. The arrays are copied.
+json_features_t *json_features_create(size_t node_count, const uint64_t *hashes, const ptrdiff_t *parents, const size_t *segment_offsets, const uint8_t *segment_bytes, const ptrdiff_t *feature_indexes, size_t feature_count);
+
+void json_features_free(json_features_t *features);
+
+/*
+ String values met while encoding. They are hashed by the caller, so they are
+ only collected here, unescaped and packed back to back: string i is
+ bytes[offsets[i], offsets[i + 1]) and goes at positions[i] of the output,
+ where a NaN stands in for it. A later value for the same feature of the same
+ row replaces the string and sets its position to SIZE_MAX.
+
+ Memory comes from the arena passed to the encoder. Zero the struct before
+ first use.
+ */
+typedef struct json_strings {
+    size_t count;
+    uint8_t *bytes;
+    size_t *offsets;
+    size_t *positions;
+
+    size_t byte_capacity;
+    size_t capacity;
+} json_strings_t;
+
+// Number of elements of the JSON array json, or one of the ERR_JSON_* codes
+long json_array_count(const uint8_t *json, size_t length);
+
+/*
+ Parses the JSON value json without building it and writes every number and
+ boolean whose path under node is a feature into row, which holds
+ feature_count floats, as (value + noise_shift) * noise_scale narrowed to
+ float. Keys with dots span several path segments and array elements are
+ keyed by their decimal index, like FeatureEncoder. Strings at feature paths
+ are added to strings with row offsets as positions. Everything else is
+ skipped. Returns 0 or one of the ERR_JSON_* codes.
+ */
+int json_encode(const json_features_t *features, const uint8_t *json, size_t length, ptrdiff_t node, double noise_shift, double noise_scale, float *row, arena_t *arena, json_strings_t *strings);
+
+/*
+ Encodes each element of the JSON array json like json_encode, on top of a
+ copy of context, into row i of out, which holds n_rows rows of
+ feature_count floats for the n_rows elements json_array_count returned.
+ String positions are offsets into out.
+ */
+int json_encode_array(const json_features_t *features, const uint8_t *json, size_t length, ptrdiff_t node, const float *context, double noise_shift, double noise_scale, float *out, size_t n_rows, arena_t *arena, json_strings_t *strings);
+
+#endif /* json_features_h */
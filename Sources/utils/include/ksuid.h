@@ -10,6 +10,7 @@
 #define ksuid_h
 
 #include <stdio.h>
+#include <stdint.h>
 
 // Base62 representation is always of length 27
 #define KSUID_STRING_LENGTH 27
@@ -22,7 +23,7 @@
 
 #define KSUID_BYTES_LENGTH (KSUID_TIME_STAMP_LENGTH+KSUID_PAYLOAD_LENGTH)
 
-int ksuid(char buf[KSUID_BYTES_LENGTH+1]);
+int ksuid(char buf[KSUID_STRING_LENGTH+1]);
 
 int ksuid_with_ts_and_payload(int64_t ts, uint8_t payload[KSUID_PAYLOAD_LENGTH],
                                char data[KSUID_STRING_LENGTH+1]);
@@ -0,0 +1,64 @@
+//
+//  quickscorer.h
+//
+//
+//  Created on 2023/7/31.
+//
+
+#ifndef quickscorer_h
+#define quickscorer_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree_ensemble.h"
+
+// Trees with more leaves than fit in a bitvector are walked node by node
+#define QUICKSCORER_MAX_LEAVES 64
+
+/*
+ QuickScorer layout of a tree_ensemble_t (Lucchese et al., SIGIR 2015).
+
+ Every branch node becomes an entry (threshold, tree, mask) grouped by feature
+ and sorted by ascending threshold. When a feature value x is >= threshold the
+ left subtree of that node can't be reached, and mask clears its leaves from
+ the tree's leaf bitvector. After all features have been scanned the exit leaf
+ of each tree is the lowest set bit, leaves being numbered left to right.
+ */
+typedef struct quickscorer {
+    const tree_ensemble_t *model;
+
+    size_t tree_count;
+    // index of the first (leftmost) leaf of each tree in model->leaves
+    size_t *leaf_offsets;
+
+    // entries of feature f are [offsets[f], offsets[f + 1])
+    size_t *offsets;
+    float *thresholds;
+    uint32_t *trees;
+    uint64_t *masks;
+
+    // entries applied when feature f is missing, i.e. nodes that send NaN right
+    size_t *nan_offsets;
+    uint32_t *nan_trees;
+    uint64_t *nan_masks;
+
+    // trees with more than QUICKSCORER_MAX_LEAVES leaves, indexes into model->roots
+    size_t fallback_count;
+    size_t *fallback_trees;
+} quickscorer_t;
+
+/*
+ Builds the QuickScorer layout. model must outlive the scorer.
+ Returns 0 on success or one of the ERR_TE_* codes.
+ */
+int quickscorer_build(const tree_ensemble_t *model, quickscorer_t **scorer);
+
+void quickscorer_free(quickscorer_t *scorer);
+
+/*
+ Same contract as tree_ensemble_predict.
+ */
+void quickscorer_predict(const quickscorer_t *scorer, const float *features, size_t n_rows, double *out);
+
+#endif /* quickscorer_h */
@@ -0,0 +1,124 @@
+//
+//  tree_ensemble.h
+//
+//
+//  Created on 2023/7/24.
+//
+
+#ifndef tree_ensemble_h
+#define tree_ensemble_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Error Codes
+#define ERR_TE_INVALID_MODEL -1
+#define ERR_TE_UNSUPPORTED_MODEL -2
+#define ERR_TE_OUT_OF_MEMORY -3
+#define ERR_TE_DECOMPRESSION -4
+
+// Set in tree_node_t.feature when a missing (NaN) value follows the left child
+#define TREE_NODE_MISSING_LEFT 0x80000000u
+#define TREE_NODE_FEATURE_MASK 0x7fffffffu
+
+#define TREE_ENSEMBLE_TRANSFORM_NONE 0
+#define TREE_ENSEMBLE_TRANSFORM_LOGISTIC 2
+
+/*
+ A branch node. All CoreML branch behaviors are normalized at load time so that
+ the left child is taken when x < threshold. Thresholds are rounded to float so
+ that the comparison against float32 features is exact.
+
+ Child references >= 0 index tree_ensemble_t.nodes, negative references are
+ ~index into tree_ensemble_t.leaves.
+ */
+typedef struct tree_node {
+    float threshold;
+    uint32_t feature;
+    int32_t left;
+    int32_t right;
+} tree_node_t;
+
+/*
+ A TreeEnsembleRegressor flattened into contiguous arrays. The nodes of each
+ tree are laid out depth first so that the left child directly follows its
+ parent. Feature indexes refer to positions in feature_names, which follow the
+ input order of the model description.
+ */
+typedef struct tree_ensemble {
+    size_t feature_count;
+    char **feature_names;
+
+    size_t metadata_count;
+    char **metadata_keys;
+    char **metadata_values;
+
+    size_t tree_count;
+    int32_t *roots;
+
+    size_t node_count;
+    tree_node_t *nodes;
+
+    size_t leaf_count;
+    double *leaves;
+
+    double base_value;
+    int transform;
+} tree_ensemble_t;
+
+/*
+ Parses a plain or gzip compressed .mlmodel whose top level model is a
+ TreeEnsembleRegressor. Returns 0 on success or one of the ERR_TE_* codes.
+ */
+int tree_ensemble_load(const uint8_t *data, size_t size, tree_ensemble_t **model);
+
+void tree_ensemble_free(tree_ensemble_t *model);
+
+/*
+ Scores n_rows row-major feature vectors of model->feature_count floats each.
+ NaN marks a missing feature.
+ */
+void tree_ensemble_predict(const tree_ensemble_t *model, const float *features, size_t n_rows, double *out);
+
+double tree_ensemble_predict_one(const tree_ensemble_t *model, const float *features);
+
+/*
+ Resolves every branch on a feature whose fixed[] flag is set to the value in
+ features, which holds model->feature_count floats, and keeps only the branches
+ still reachable. Trees that resolve to a single leaf keep it as their root, so
+ predicting with the partial ensemble on any vector that agrees with features
+ on the fixed features is bit identical to predicting with model.
+
+ The partial ensemble has no feature names or metadata and is released with
+ tree_ensemble_free. Returns 0 on success or one of the ERR_TE_* codes.
+ */
+int tree_ensemble_partial(const tree_ensemble_t *model, const float *features, const uint8_t *fixed, tree_ensemble_t **partial);
+
+/*
+ tree_ensemble_partial allocating from arena. The partial ensemble lives until
+ the arena is released or reset and must not be passed to tree_ensemble_free.
+ */
+int tree_ensemble_partial_arena(const tree_ensemble_t *model, const float *features, const uint8_t *fixed, arena_t *arena, tree_ensemble_t **partial);
+
+// Applies the post evaluation transform to base_value + the sum of the leaves
+double tree_ensemble_transform(const tree_ensemble_t *model, double sum);
+
+/*
+ Walks one tree from root (an entry of model->roots) and returns the leaf index
+ reached by features.
+ */
+static inline size_t tree_ensemble_leaf(const tree_ensemble_t *model, int32_t root, const float *features) {
+    int32_t i = root;
+    while (i >= 0) {
+        const tree_node_t *node = &model->nodes[i];
+        float x = features[node->feature & TREE_NODE_FEATURE_MASK];
+        // NaN fails x < threshold and goes right unless flagged
+        int left = x < node->threshold || (x != x && (node->feature & TREE_NODE_MISSING_LEFT));
+        i = left ? node->left : node->right;
+    }
+    return (size_t)~i;
+}
+
+#endif /* tree_ensemble_h */
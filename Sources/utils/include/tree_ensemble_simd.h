@@ -0,0 +1,73 @@
+//
+//  tree_ensemble_simd.h
+//
+//
+//  Created on 2023/8/7.
+//
+
+#ifndef tree_ensemble_simd_h
+#define tree_ensemble_simd_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree_ensemble.h"
+
+#define TREE_SIMD_SCALAR 0
+#define TREE_SIMD_AVX2 1
+#define TREE_SIMD_AVX512 2
+
+// Deeper trees are walked through tree_ensemble_t.nodes instead of being padded
+#define TREE_SIMD_MAX_DEPTH 8
+
+/*
+ Trees of a tree_ensemble_t padded to perfect binary trees in breadth first
+ order, so the children of node i are 2i + 1 and 2i + 2 and every row takes
+ exactly depth steps. A leaf above the bottom level is copied into all the leaf
+ slots below it, which keeps results identical whatever the padding nodes test.
+ Each level is contiguous, so the top levels can be permuted into lanes from
+ registers and only deeper levels need gathers.
+ */
+typedef struct tree_simd {
+    const tree_ensemble_t *model;
+
+    // per tree; depth is 0 for a single leaf and > TREE_SIMD_MAX_DEPTH when not padded
+    uint32_t *depths;
+    size_t *node_offsets;
+    size_t *leaf_offsets;
+
+    float *thresholds;
+    uint32_t *features;
+    double *leaves;
+
+    // TREE_SIMD_* kernel for this CPU, detected once when the layout is built
+    int level;
+} tree_simd_t;
+
+/*
+ Builds the padded layout. model must outlive it.
+ Returns 0 on success or one of the ERR_TE_* codes.
+ */
+int tree_simd_build(const tree_ensemble_t *model, tree_simd_t **simd);
+
+/*
+ tree_simd_build allocating from arena. The layout lives until the arena is
+ released or reset and must not be passed to tree_simd_free.
+ */
+int tree_simd_build_arena(const tree_ensemble_t *model, arena_t *arena, tree_simd_t **simd);
+
+void tree_simd_free(tree_simd_t *simd);
+
+/*
+ Scores n_rows items stored feature-major: the value of feature f for row r is
+ columns[f * n_rows + r]. Blocks of 8 (AVX2) or 16 (AVX-512) rows advance
+ through each tree together, gathering node fields and feature values per lane.
+ The instruction set is simd->level, other CPUs run the same tree at a time
+ order with scalar code. Results are bit identical to tree_ensemble_predict.
+ */
+void tree_simd_predict(const tree_simd_t *simd, const float *columns, size_t n_rows, double *out);
+
+// One of TREE_SIMD_*, the kernel tree_simd_predict uses on this CPU. Queries the CPU on every call.
+int tree_simd_level(void);
+
+#endif /* tree_ensemble_simd_h */
@@ -0,0 +1,37 @@
+//
+//  tree_ensemble_top_k.h
+//
+//
+//  Created on 2023/8/21.
+//
+
+#ifndef tree_ensemble_top_k_h
+#define tree_ensemble_top_k_h
+
+#include <stddef.h>
+
+#include "tree_ensemble.h"
+
+/*
+ Finds the k best of n_rows row-major feature vectors without fully scoring all
+ of them. Trees are evaluated one at a time over the rows still in the running,
+ and every few trees a row is dropped once the sum of its leaves so far plus the
+ largest leaves of the remaining trees falls below the k-th best sum of leaves
+ so far plus the smallest leaves of the remaining trees. Bounds are compared
+ after the transform, and a row is only dropped when it trails by more than
+ margin, which should cover any tie breaking noise added to the scores later.
+
+ Writes the indexes of the surviving rows in ascending order to rows and their
+ scores, bit identical to tree_ensemble_predict, to scores. Both need room for
+ n_rows entries. Returns the number of survivors, which is at least
+ min(k, n_rows) and can be more when rows tie, or ERR_TE_OUT_OF_MEMORY.
+ */
+long tree_ensemble_top_k(const tree_ensemble_t *model, const float *features, size_t n_rows, size_t k, double margin, size_t *rows, double *scores);
+
+/*
+ tree_ensemble_top_k taking its working memory from arena, which is released
+ back to where it was before returning.
+ */
+long tree_ensemble_top_k_arena(const tree_ensemble_t *model, const float *features, size_t n_rows, size_t k, double margin, arena_t *arena, size_t *rows, double *scores);
+
+#endif /* tree_ensemble_top_k_h */
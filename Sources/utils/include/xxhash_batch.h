@@ -0,0 +1,27 @@
+//
+//  xxhash_batch.h
+//
+//
+//  Created on 2023/11/13.
+//
+
+#ifndef xxhash_batch_h
+#define xxhash_batch_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Hashes count byte strings packed back to back in data with
+ XXH3_64bits_withSeed and the same seed. String i is
+ data[offsets[i], offsets[i + 1]), so offsets holds count + 1 entries starting
+ with 0. hashes receives count results, identical to hashing each string on
+ its own.
+
+ Runs of strings of at most 16 bytes, the usual categorical values, are hashed
+ four at a time with no calls or length dispatch between them, so their
+ multiply chains overlap instead of running one string after another.
+ */
+void xxh3_64_batch(const uint8_t *data, const size_t *offsets, size_t count, uint64_t seed, uint64_t *hashes);
+
+#endif /* xxhash_batch_h */
@@ -0,0 +1,746 @@
+//
+//  json_features.c
+//
+//
+//  Created on 2023/11/20.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// strtod_l
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__APPLE__) || defined(__linux__)
+#include <locale.h>
+#include <pthread.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+#define HAVE_STRTOD_L 1
+#endif
+
+#include "xxhash.h"
+#include "json_features.h"
+
+#define MISSING -1
+
+// numbers longer than this are copied to the arena before strtod_l
+#define NUMBER_BUFFER 64
+
+struct json_features {
+    size_t node_count;
+    size_t feature_count;
+
+    uint64_t *hashes;
+    ptrdiff_t *parents;
+    size_t *segment_offsets;
+    uint8_t *segment_bytes;
+    ptrdiff_t *feature_indexes;
+
+    // open addressing by hash, MISSING when empty
+    ptrdiff_t *slots;
+    size_t mask;
+};
+
+typedef struct {
+    const json_features_t *features;
+    const uint8_t *p;
+    const uint8_t *end;
+
+    float *out;
+    // where the current row starts in out
+    size_t row_offset;
+    size_t row;
+    double noise_shift;
+    double noise_scale;
+
+    arena_t *arena;
+    json_strings_t *strings;
+
+    // per feature, the string written to it in row pending_rows[f], if any
+    size_t *pending_strings;
+    size_t *pending_rows;
+
+    int depth;
+} parser_t;
+
+json_features_t *json_features_create(size_t node_count, const uint64_t *hashes, const ptrdiff_t *parents, const size_t *segment_offsets, const uint8_t *segment_bytes, const ptrdiff_t *feature_indexes, size_t feature_count) {
+    json_features_t *features = calloc(1, sizeof(json_features_t));
+    if (!features) {
+        return NULL;
+    }
+    size_t capacity = 16;
+    while (capacity < node_count * 2) {
+        capacity *= 2;
+    }
+    size_t byte_count = segment_offsets[node_count];
+    features->node_count = node_count;
+    features->feature_count = feature_count;
+    features->hashes = malloc(node_count * sizeof(uint64_t));
+    features->parents = malloc(node_count * sizeof(ptrdiff_t));
+    features->segment_offsets = malloc((node_count + 1) * sizeof(size_t));
+    features->segment_bytes = malloc(byte_count + 1);
+    features->feature_indexes = malloc(node_count * sizeof(ptrdiff_t));
+    features->slots = malloc(capacity * sizeof(ptrdiff_t));
+    if (!features->hashes || !features->parents || !features->segment_offsets || !features->segment_bytes || !features->feature_indexes || !features->slots) {
+        json_features_free(features);
+        return NULL;
+    }
+    memcpy(features->hashes, hashes, node_count * sizeof(uint64_t));
+    memcpy(features->parents, parents, node_count * sizeof(ptrdiff_t));
+    memcpy(features->segment_offsets, segment_offsets, (node_count + 1) * sizeof(size_t));
+    if (byte_count) {
+        memcpy(features->segment_bytes, segment_bytes, byte_count);
+    }
+    memcpy(features->feature_indexes, feature_indexes, node_count * sizeof(ptrdiff_t));
+
+    features->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        features->slots[i] = MISSING;
+    }
+    // the root has no segment and is never looked up
+    for (size_t node = 1; node < node_count; node++) {
+        size_t slot = (size_t)hashes[node] & features->mask;
+        while (features->slots[slot] != MISSING) {
+            slot = (slot + 1) & features->mask;
+        }
+        features->slots[slot] = (ptrdiff_t)node;
+    }
+    return features;
+}
+
+void json_features_free(json_features_t *features) {
+    if (!features) {
+        return;
+    }
+    free(features->hashes);
+    free(features->parents);
+    free(features->segment_offsets);
+    free(features->segment_bytes);
+    free(features->feature_indexes);
+    free(features->slots);
+    free(features);
+}
+
+static ptrdiff_t child_segment(const json_features_t *features, ptrdiff_t node, const uint8_t *segment, size_t length) {
+    if (node == MISSING) {
+        return MISSING;
+    }
+    uint64_t hash = XXH3_64bits_withSeed(segment, length, features->hashes[node]);
+    for (size_t slot = (size_t)hash & features->mask; features->slots[slot] != MISSING; slot = (slot + 1) & features->mask) {
+        ptrdiff_t candidate = features->slots[slot];
+        if (features->hashes[candidate] != hash || features->parents[candidate] != node) {
+            continue;
+        }
+        size_t start = features->segment_offsets[candidate], end = features->segment_offsets[candidate + 1];
+        if (end - start == length && (length == 0 || memcmp(features->segment_bytes + start, segment, length) == 0)) {
+            return candidate;
+        }
+    }
+    return MISSING;
+}
+
+// key with dots spans several segments, like FeaturePathIndex.child(of:key:)
+static ptrdiff_t child_key(const json_features_t *features, ptrdiff_t node, const uint8_t *key, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length && node != MISSING; i++) {
+        if (key[i] == '.') {
+            node = child_segment(features, node, key + start, i - start);
+            start = i + 1;
+        }
+    }
+    return child_segment(features, node, key + start, length - start);
+}
+
+static ptrdiff_t child_index(const json_features_t *features, ptrdiff_t node, size_t index) {
+    if (node == MISSING) {
+        return MISSING;
+    }
+    uint8_t digits[24];
+    size_t start = sizeof(digits);
+    do {
+        digits[--start] = (uint8_t)('0' + index % 10);
+        index /= 10;
+    } while (index > 0);
+    return child_segment(features, node, digits + start, sizeof(digits) - start);
+}
+
+static void skip_whitespace(parser_t *parser) {
+    while (parser->p < parser->end && (*parser->p == ' ' || *parser->p == '\n' || *parser->p == '\r' || *parser->p == '\t')) {
+        parser->p++;
+    }
+}
+
+static int literal(parser_t *parser, const char *text, size_t length) {
+    if ((size_t)(parser->end - parser->p) < length || memcmp(parser->p, text, length) != 0) {
+        return ERR_JSON_INVALID;
+    }
+    parser->p += length;
+    return 0;
+}
+
+static int hex_digit(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static int read_hex4(const uint8_t *p, const uint8_t *end, uint32_t *value) {
+    if (end - p < 4) {
+        return ERR_JSON_INVALID;
+    }
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(p[i]);
+        if (digit < 0) {
+            return ERR_JSON_INVALID;
+        }
+        *value = *value << 4 | (uint32_t)digit;
+    }
+    return 0;
+}
+
+static size_t put_utf8(uint8_t *out, uint32_t c) {
+    if (c < 0x80) {
+        out[0] = (uint8_t)c;
+        return 1;
+    }
+    if (c < 0x800) {
+        out[0] = (uint8_t)(0xC0 | c >> 6);
+        out[1] = (uint8_t)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if (c < 0x10000) {
+        out[0] = (uint8_t)(0xE0 | c >> 12);
+        out[1] = (uint8_t)(0x80 | (c >> 6 & 0x3F));
+        out[2] = (uint8_t)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    out[0] = (uint8_t)(0xF0 | c >> 18);
+    out[1] = (uint8_t)(0x80 | (c >> 12 & 0x3F));
+    out[2] = (uint8_t)(0x80 | (c >> 6 & 0x3F));
+    out[3] = (uint8_t)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+/*
+ Reads the string at p, just past its opening quote. Strings without escapes
+ point into the input, the others are unescaped into the arena, which is
+ never more bytes than the escaped form. string is NULL to only skip it.
+ */
+static int read_string(parser_t *parser, const uint8_t **string, size_t *length) {
+    const uint8_t *start = parser->p;
+    const uint8_t *p = start;
+    int escaped = 0;
+    while (p < parser->end && *p != '"') {
+        if (*p < 0x20) {
+            return ERR_JSON_INVALID;
+        }
+        if (*p == '\\') {
+            escaped = 1;
+            p++;
+        }
+        p++;
+    }
+    if (p >= parser->end) {
+        return ERR_JSON_INVALID;
+    }
+    parser->p = p + 1;
+    if (!string) {
+        return 0;
+    }
+    if (!escaped) {
+        *string = start;
+        *length = (size_t)(p - start);
+        return 0;
+    }
+
+    uint8_t *out = arena_alloc(parser->arena, (size_t)(p - start), 1);
+    if (!out) {
+        return ERR_JSON_OUT_OF_MEMORY;
+    }
+    size_t n = 0;
+    for (const uint8_t *q = start; q < p; q++) {
+        if (*q != '\\') {
+            out[n++] = *q;
+            continue;
+        }
+        q++;
+        switch (*q) {
+        case '"': out[n++] = '"'; break;
+        case '\\': out[n++] = '\\'; break;
+        case '/': out[n++] = '/'; break;
+        case 'b': out[n++] = '\b'; break;
+        case 'f': out[n++] = '\f'; break;
+        case 'n': out[n++] = '\n'; break;
+        case 'r': out[n++] = '\r'; break;
+        case 't': out[n++] = '\t'; break;
+        case 'u': {
+            uint32_t c;
+            if (read_hex4(q + 1, p, &c)) {
+                return ERR_JSON_INVALID;
+            }
+            q += 4;
+            if (c >= 0xD800 && c < 0xDC00) {
+                // a high surrogate has to be followed by an escaped low one
+                uint32_t low;
+                if (p - q < 7 || q[1] != '\\' || q[2] != 'u' || read_hex4(q + 3, p, &low) || low < 0xDC00 || low >= 0xE000) {
+                    return ERR_JSON_INVALID;
+                }
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                q += 6;
+            } else if (c >= 0xDC00 && c < 0xE000) {
+                return ERR_JSON_INVALID;
+            }
+            n += put_utf8(out + n, c);
+            break;
+        }
+        default:
+            return ERR_JSON_INVALID;
+        }
+    }
+    *string = out;
+    *length = n;
+    return 0;
+}
+
+#ifdef HAVE_STRTOD_L
+// JSON numbers always use '.', whatever locale the app set with setlocale
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void create_c_locale(void) {
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+#endif
+
+// text is a valid JSON number
+static int parse_double(const char *text, double *value) {
+#ifdef HAVE_STRTOD_L
+    pthread_once(&c_locale_once, create_c_locale);
+    if (!c_locale) {
+        return ERR_JSON_OUT_OF_MEMORY;
+    }
+    *value = strtod_l(text, NULL, c_locale);
+#else
+    *value = strtod(text, NULL);
+#endif
+    return 0;
+}
+
+// value is NULL to only skip the number
+static int read_number(parser_t *parser, double *value) {
+    const uint8_t *start = parser->p, *p = start, *end = parser->end;
+    int integer = 1;
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p < end && *p == '0') {
+        p++;
+    } else if (p < end && *p >= '1' && *p <= '9') {
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    } else {
+        return ERR_JSON_INVALID;
+    }
+    if (p < end && *p == '.') {
+        integer = 0;
+        p++;
+        if (p >= end || *p < '0' || *p > '9') {
+            return ERR_JSON_INVALID;
+        }
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        integer = 0;
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p >= end || *p < '0' || *p > '9') {
+            return ERR_JSON_INVALID;
+        }
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    parser->p = p;
+    if (!value) {
+        return 0;
+    }
+
+    size_t length = (size_t)(p - start);
+    int negative = *start == '-';
+    if (integer && length - (size_t)negative <= 15) {
+        // exact in a double, no need for strtod_l
+        int64_t magnitude = 0;
+        for (const uint8_t *q = start + negative; q < p; q++) {
+            magnitude = magnitude * 10 + (*q - '0');
+        }
+        *value = negative ? -(double)magnitude : (double)magnitude;
+        return 0;
+    }
+    char buffer[NUMBER_BUFFER];
+    char *text = buffer;
+    if (length >= NUMBER_BUFFER) {
+        text = arena_alloc(parser->arena, length + 1, 1);
+        if (!text) {
+            return ERR_JSON_OUT_OF_MEMORY;
+        }
+    }
+    memcpy(text, start, length);
+    text[length] = '\0';
+    return parse_double(text, value);
+}
+
+static int grow_strings(parser_t *parser, size_t byte_count) {
+    json_strings_t *strings = parser->strings;
+    if (strings->count + 1 >= strings->capacity) {
+        size_t capacity = strings->capacity ? strings->capacity * 2 : 64;
+        size_t *offsets = arena_alloc(parser->arena, (capacity + 1) * sizeof(size_t), _Alignof(size_t));
+        size_t *positions = arena_alloc(parser->arena, capacity * sizeof(size_t), _Alignof(size_t));
+        if (!offsets || !positions) {
+            return ERR_JSON_OUT_OF_MEMORY;
+        }
+        if (strings->capacity) {
+            memcpy(offsets, strings->offsets, (strings->count + 1) * sizeof(size_t));
+            memcpy(positions, strings->positions, strings->count * sizeof(size_t));
+        } else {
+            offsets[0] = 0;
+        }
+        strings->offsets = offsets;
+        strings->positions = positions;
+        strings->capacity = capacity;
+    }
+    size_t used = strings->offsets[strings->count];
+    if (used + byte_count > strings->byte_capacity) {
+        size_t byte_capacity = strings->byte_capacity ? strings->byte_capacity * 2 : 1024;
+        while (byte_capacity < used + byte_count) {
+            byte_capacity *= 2;
+        }
+        uint8_t *bytes = arena_alloc(parser->arena, byte_capacity, 1);
+        if (!bytes) {
+            return ERR_JSON_OUT_OF_MEMORY;
+        }
+        if (used) {
+            memcpy(bytes, strings->bytes, used);
+        }
+        strings->bytes = bytes;
+        strings->byte_capacity = byte_capacity;
+    }
+    return 0;
+}
+
+// a value for feature replaces a string written to it earlier in the same row
+static void replace_pending(parser_t *parser, ptrdiff_t feature) {
+    if (parser->pending_rows[feature] == parser->row) {
+        parser->strings->positions[parser->pending_strings[feature]] = SIZE_MAX;
+        parser->pending_rows[feature] = SIZE_MAX;
+    }
+}
+
+static int write_string(parser_t *parser, ptrdiff_t feature, const uint8_t *string, size_t length) {
+    int status = grow_strings(parser, length);
+    if (status) {
+        return status;
+    }
+    replace_pending(parser, feature);
+    json_strings_t *strings = parser->strings;
+    size_t start = strings->offsets[strings->count];
+    if (length) {
+        memcpy(strings->bytes + start, string, length);
+    }
+    strings->offsets[strings->count + 1] = start + length;
+    strings->positions[strings->count] = parser->row_offset + (size_t)feature;
+    parser->pending_strings[feature] = strings->count;
+    parser->pending_rows[feature] = parser->row;
+    strings->count++;
+    parser->out[parser->row_offset + (size_t)feature] = NAN;
+    return 0;
+}
+
+static void write_double(parser_t *parser, ptrdiff_t feature, double value) {
+    replace_pending(parser, feature);
+    parser->out[parser->row_offset + (size_t)feature] = (float)((value + parser->noise_shift) * parser->noise_scale);
+}
+
+static int parse_value(parser_t *parser, ptrdiff_t node);
+
+static int parse_object(parser_t *parser, ptrdiff_t node) {
+    parser->p++;
+    skip_whitespace(parser);
+    if (parser->p < parser->end && *parser->p == '}') {
+        parser->p++;
+        return 0;
+    }
+    while (1) {
+        skip_whitespace(parser);
+        if (parser->p >= parser->end || *parser->p != '"') {
+            return ERR_JSON_INVALID;
+        }
+        parser->p++;
+        const uint8_t *key;
+        size_t length;
+        int status;
+        ptrdiff_t child = MISSING;
+        if (node == MISSING) {
+            status = read_string(parser, NULL, NULL);
+        } else {
+            // a key with escapes is unescaped into the arena until it's resolved
+            arena_mark_t mark = arena_mark(parser->arena);
+            status = read_string(parser, &key, &length);
+            if (!status) {
+                child = child_key(parser->features, node, key, length);
+            }
+            arena_release(parser->arena, mark);
+        }
+        if (status) {
+            return status;
+        }
+
+        skip_whitespace(parser);
+        if (parser->p >= parser->end || *parser->p != ':') {
+            return ERR_JSON_INVALID;
+        }
+        parser->p++;
+        if ((status = parse_value(parser, child))) {
+            return status;
+        }
+        skip_whitespace(parser);
+        if (parser->p >= parser->end) {
+            return ERR_JSON_INVALID;
+        }
+        if (*parser->p == '}') {
+            parser->p++;
+            return 0;
+        }
+        if (*parser->p != ',') {
+            return ERR_JSON_INVALID;
+        }
+        parser->p++;
+    }
+}
+
+static int parse_array(parser_t *parser, ptrdiff_t node) {
+    parser->p++;
+    skip_whitespace(parser);
+    if (parser->p < parser->end && *parser->p == ']') {
+        parser->p++;
+        return 0;
+    }
+    for (size_t index = 0; ; index++) {
+        int status = parse_value(parser, child_index(parser->features, node, index));
+        if (status) {
+            return status;
+        }
+        skip_whitespace(parser);
+        if (parser->p >= parser->end) {
+            return ERR_JSON_INVALID;
+        }
+        if (*parser->p == ']') {
+            parser->p++;
+            return 0;
+        }
+        if (*parser->p != ',') {
+            return ERR_JSON_INVALID;
+        }
+        parser->p++;
+    }
+}
+
+static int parse_value(parser_t *parser, ptrdiff_t node) {
+    skip_whitespace(parser);
+    if (parser->p >= parser->end) {
+        return ERR_JSON_INVALID;
+    }
+    ptrdiff_t feature = node == MISSING ? MISSING : parser->features->feature_indexes[node];
+    int status;
+    switch (*parser->p) {
+    case '{':
+    case '[':
+        if (++parser->depth > JSON_MAX_DEPTH) {
+            return ERR_JSON_TOO_DEEP;
+        }
+        status = *parser->p == '{' ? parse_object(parser, node) : parse_array(parser, node);
+        parser->depth--;
+        return status;
+    case '"': {
+        parser->p++;
+        if (feature == MISSING) {
+            return read_string(parser, NULL, NULL);
+        }
+        const uint8_t *string;
+        size_t length;
+        if ((status = read_string(parser, &string, &length))) {
+            return status;
+        }
+        // an unescaped copy stays in the arena, below what write_string allocates
+        return write_string(parser, feature, string, length);
+    }
+    case 't':
+        if ((status = literal(parser, "true", 4))) {
+            return status;
+        }
+        if (feature != MISSING) {
+            write_double(parser, feature, 1);
+        }
+        return 0;
+    case 'f':
+        if ((status = literal(parser, "false", 5))) {
+            return status;
+        }
+        if (feature != MISSING) {
+            write_double(parser, feature, 0);
+        }
+        return 0;
+    case 'n':
+        return literal(parser, "null", 4);
+    default: {
+        double value;
+        if ((status = read_number(parser, feature == MISSING ? NULL : &value))) {
+            return status;
+        }
+        if (feature != MISSING) {
+            write_double(parser, feature, value);
+        }
+        return 0;
+    }
+    }
+}
+
+static int init_parser(parser_t *parser, const json_features_t *features, const uint8_t *json, size_t length, float *out, double noise_shift, double noise_scale, arena_t *arena, json_strings_t *strings) {
+    memset(parser, 0, sizeof(parser_t));
+    parser->features = features;
+    parser->p = json;
+    parser->end = json + length;
+    parser->out = out;
+    parser->noise_shift = noise_shift;
+    parser->noise_scale = noise_scale;
+    parser->arena = arena;
+    parser->strings = strings;
+    size_t count = features->feature_count ? features->feature_count : 1;
+    parser->pending_strings = arena_alloc(arena, count * sizeof(size_t), _Alignof(size_t));
+    parser->pending_rows = arena_alloc(arena, count * sizeof(size_t), _Alignof(size_t));
+    if (!parser->pending_strings || !parser->pending_rows) {
+        return ERR_JSON_OUT_OF_MEMORY;
+    }
+    memset(parser->pending_rows, 0xFF, count * sizeof(size_t));
+    return 0;
+}
+
+static int finish(parser_t *parser) {
+    skip_whitespace(parser);
+    return parser->p == parser->end ? 0 : ERR_JSON_INVALID;
+}
+
+int json_encode(const json_features_t *features, const uint8_t *json, size_t length, ptrdiff_t node, double noise_shift, double noise_scale, float *row, arena_t *arena, json_strings_t *strings) {
+    parser_t parser;
+    int status = init_parser(&parser, features, json, length, row, noise_shift, noise_scale, arena, strings);
+    if (status || (status = parse_value(&parser, node))) {
+        return status;
+    }
+    return finish(&parser);
+}
+
+// skips the value at p without looking at paths
+static int skip_value(parser_t *parser) {
+    return parse_value(parser, MISSING);
+}
+
+long json_array_count(const uint8_t *json, size_t length) {
+    parser_t parser;
+    memset(&parser, 0, sizeof(parser_t));
+    parser.p = json;
+    parser.end = json + length;
+    // nothing is unescaped or converted while skipping, so no arena
+    skip_whitespace(&parser);
+    if (parser.p >= parser.end || *parser.p != '[') {
+        return ERR_JSON_NOT_AN_ARRAY;
+    }
+    parser.p++;
+    skip_whitespace(&parser);
+    long count = 0;
+    if (parser.p < parser.end && *parser.p == ']') {
+        parser.p++;
+    } else {
+        while (1) {
+            int status = skip_value(&parser);
+            if (status) {
+                return status;
+            }
+            count++;
+            skip_whitespace(&parser);
+            if (parser.p >= parser.end) {
+                return ERR_JSON_INVALID;
+            }
+            if (*parser.p == ']') {
+                parser.p++;
+                break;
+            }
+            if (*parser.p != ',') {
+                return ERR_JSON_INVALID;
+            }
+            parser.p++;
+        }
+    }
+    int status = finish(&parser);
+    return status ? status : count;
+}
+
+int json_encode_array(const json_features_t *features, const uint8_t *json, size_t length, ptrdiff_t node, const float *context, double noise_shift, double noise_scale, float *out, size_t n_rows, arena_t *arena, json_strings_t *strings) {
+    parser_t parser;
+    int status = init_parser(&parser, features, json, length, out, noise_shift, noise_scale, arena, strings);
+    if (status) {
+        return status;
+    }
+    size_t feature_count = features->feature_count;
+    skip_whitespace(&parser);
+    if (parser.p >= parser.end || *parser.p != '[') {
+        return ERR_JSON_NOT_AN_ARRAY;
+    }
+    parser.p++;
+    skip_whitespace(&parser);
+    if (parser.p < parser.end && *parser.p == ']') {
+        parser.p++;
+        return n_rows == 0 ? finish(&parser) : ERR_JSON_INVALID;
+    }
+    for (size_t row = 0; ; row++) {
+        if (row >= n_rows) {
+            return ERR_JSON_INVALID;
+        }
+        parser.row = row;
+        parser.row_offset = row * feature_count;
+        if (feature_count) {
+            memcpy(out + parser.row_offset, context, feature_count * sizeof(float));
+        }
+        if ((status = parse_value(&parser, node))) {
+            return status;
+        }
+        skip_whitespace(&parser);
+        if (parser.p >= parser.end) {
+            return ERR_JSON_INVALID;
+        }
+        if (*parser.p == ']') {
+            parser.p++;
+            return row + 1 == n_rows ? finish(&parser) : ERR_JSON_INVALID;
+        }
+        if (*parser.p != ',') {
+            return ERR_JSON_INVALID;
+        }
+        parser.p++;
+    }
+}
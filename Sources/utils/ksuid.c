@@ -9,11 +9,51 @@
 #include <time.h>
 #include <string.h>
 
-#import <Security/SecRandom.h>
+#if defined(__APPLE__)
+#include <Security/SecRandom.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <stdio.h>
+#include <sys/random.h>
+#else
+#include <stdio.h>
+#endif
 
 #include "ksuid.h"
 #include "base62.h"
 
+// fills buf with cryptographically secure random bytes, returns 0 on success
+static int random_bytes(uint8_t *buf, size_t size) {
+#if defined(__APPLE__)
+    return SecRandomCopyBytes(kSecRandomDefault, size, buf) == errSecSuccess ? 0 : -1;
+#else
+#if defined(__linux__)
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t n = getrandom(buf + filled, size - filled, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        filled += n;
+    }
+    if (filled == size) {
+        return 0;
+    }
+    // kernels older than 3.17 have no getrandom, fall back to the device
+#endif
+    FILE *urandom = fopen("/dev/urandom", "rb");
+    if (urandom == NULL) {
+        return -1;
+    }
+    size_t read = fread(buf, 1, size, urandom);
+    fclose(urandom);
+    return read == size ? 0 : -1;
+#endif
+}
+
 // big endian
 void encode_timestamp(time_t t, uint8_t *buf) {
     buf[0] = (t >> 24) & 0xff;
@@ -45,8 +85,7 @@ int ksuid_with_ts_and_payload(int64_t ts, uint8_t payload[KSUID_PAYLOAD_LENGTH],
 int ksuid(char data[KSUID_STRING_LENGTH+1]) {
     uint8_t payloadBuf[KSUID_PAYLOAD_LENGTH];
     
-    int status = SecRandomCopyBytes(kSecRandomDefault, KSUID_PAYLOAD_LENGTH, payloadBuf);
-    if(status != errSecSuccess) {
+    if(random_bytes(payloadBuf, KSUID_PAYLOAD_LENGTH) != 0) {
         return -2;
     }
     
@@ -0,0 +1,218 @@
+//
+//  quickscorer.c
+//
+//
+//  Created on 2023/7/31.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "quickscorer.h"
+
+typedef struct {
+    uint32_t feature;
+    float threshold;
+    uint32_t tree;
+    int missing_left;
+    uint64_t mask;
+} qs_entry_t;
+
+typedef struct {
+    qs_entry_t *entries;
+    size_t count;
+} qs_entries_t;
+
+// [lo, hi) range of the leaves below ref. Leaves are emitted depth first, so it's contiguous.
+static void leaf_range(const tree_ensemble_t *model, int32_t ref, size_t *lo, size_t *hi) {
+    int32_t first = ref, last = ref;
+    while (first >= 0) {
+        first = model->nodes[first].left;
+    }
+    while (last >= 0) {
+        last = model->nodes[last].right;
+    }
+    *lo = (size_t)~first;
+    *hi = (size_t)~last + 1;
+}
+
+static void collect_entries(const tree_ensemble_t *model, int32_t ref, uint32_t tree, size_t first_leaf, qs_entries_t *out) {
+    if (ref < 0) {
+        return;
+    }
+    const tree_node_t *node = &model->nodes[ref];
+    size_t lo, hi;
+    leaf_range(model, node->left, &lo, &hi);
+    uint64_t width = hi - lo;
+    uint64_t left_leaves = (width == 64 ? ~0ULL : ((1ULL << width) - 1)) << (lo - first_leaf);
+
+    qs_entry_t *entry = &out->entries[out->count++];
+    entry->feature = node->feature & TREE_NODE_FEATURE_MASK;
+    entry->threshold = node->threshold;
+    entry->tree = tree;
+    entry->missing_left = (node->feature & TREE_NODE_MISSING_LEFT) != 0;
+    entry->mask = ~left_leaves;
+
+    collect_entries(model, node->left, tree, first_leaf, out);
+    collect_entries(model, node->right, tree, first_leaf, out);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const qs_entry_t *x = a, *y = b;
+    if (x->feature != y->feature) {
+        return x->feature < y->feature ? -1 : 1;
+    }
+    if (x->threshold != y->threshold) {
+        return x->threshold < y->threshold ? -1 : 1;
+    }
+    return x->tree < y->tree ? -1 : (x->tree > y->tree);
+}
+
+int quickscorer_build(const tree_ensemble_t *model, quickscorer_t **scorer) {
+    quickscorer_t *qs = calloc(1, sizeof(quickscorer_t));
+    qs_entries_t entries = { calloc(model->node_count + 1, sizeof(qs_entry_t)), 0 };
+    if (!qs || !entries.entries) {
+        free(qs);
+        free(entries.entries);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    qs->model = model;
+    qs->leaf_offsets = malloc((model->tree_count + 1) * sizeof(size_t));
+    qs->fallback_trees = malloc((model->tree_count + 1) * sizeof(size_t));
+    qs->offsets = calloc(model->feature_count + 1, sizeof(size_t));
+    qs->nan_offsets = calloc(model->feature_count + 1, sizeof(size_t));
+    if (!qs->leaf_offsets || !qs->fallback_trees || !qs->offsets || !qs->nan_offsets) {
+        free(entries.entries);
+        quickscorer_free(qs);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    for (size_t t = 0; t < model->tree_count; t++) {
+        size_t lo, hi;
+        leaf_range(model, model->roots[t], &lo, &hi);
+        if (hi - lo > QUICKSCORER_MAX_LEAVES) {
+            qs->fallback_trees[qs->fallback_count++] = t;
+            continue;
+        }
+        qs->leaf_offsets[qs->tree_count] = lo;
+        collect_entries(model, model->roots[t], (uint32_t)qs->tree_count, lo, &entries);
+        qs->tree_count++;
+    }
+
+    qsort(entries.entries, entries.count, sizeof(qs_entry_t), compare_entries);
+
+    size_t nan_count = 0;
+    for (size_t i = 0; i < entries.count; i++) {
+        qs->offsets[entries.entries[i].feature + 1]++;
+        if (!entries.entries[i].missing_left) {
+            qs->nan_offsets[entries.entries[i].feature + 1]++;
+            nan_count++;
+        }
+    }
+    for (size_t f = 0; f < model->feature_count; f++) {
+        qs->offsets[f + 1] += qs->offsets[f];
+        qs->nan_offsets[f + 1] += qs->nan_offsets[f];
+    }
+
+    qs->thresholds = malloc((entries.count + 1) * sizeof(float));
+    qs->trees = malloc((entries.count + 1) * sizeof(uint32_t));
+    qs->masks = malloc((entries.count + 1) * sizeof(uint64_t));
+    qs->nan_trees = malloc((nan_count + 1) * sizeof(uint32_t));
+    qs->nan_masks = malloc((nan_count + 1) * sizeof(uint64_t));
+    if (!qs->thresholds || !qs->trees || !qs->masks || !qs->nan_trees || !qs->nan_masks) {
+        free(entries.entries);
+        quickscorer_free(qs);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    // entries are sorted by feature, so both lists fill in order
+    size_t n = 0;
+    for (size_t i = 0; i < entries.count; i++) {
+        const qs_entry_t *entry = &entries.entries[i];
+        qs->thresholds[i] = entry->threshold;
+        qs->trees[i] = entry->tree;
+        qs->masks[i] = entry->mask;
+        if (!entry->missing_left) {
+            qs->nan_trees[n] = entry->tree;
+            qs->nan_masks[n] = entry->mask;
+            n++;
+        }
+    }
+
+    free(entries.entries);
+    *scorer = qs;
+    return 0;
+}
+
+void quickscorer_free(quickscorer_t *scorer) {
+    if (!scorer) {
+        return;
+    }
+    free(scorer->leaf_offsets);
+    free(scorer->offsets);
+    free(scorer->thresholds);
+    free(scorer->trees);
+    free(scorer->masks);
+    free(scorer->nan_offsets);
+    free(scorer->nan_trees);
+    free(scorer->nan_masks);
+    free(scorer->fallback_trees);
+    free(scorer);
+}
+
+static double quickscorer_predict_one(const quickscorer_t *qs, const float *features, uint64_t *leafsets) {
+    const tree_ensemble_t *model = qs->model;
+
+    memset(leafsets, 0xff, qs->tree_count * sizeof(uint64_t));
+
+    for (size_t f = 0; f < model->feature_count; f++) {
+        float x = features[f];
+        if (x != x) {
+            for (size_t k = qs->nan_offsets[f]; k < qs->nan_offsets[f + 1]; k++) {
+                leafsets[qs->nan_trees[k]] &= qs->nan_masks[k];
+            }
+            continue;
+        }
+        // every node with threshold <= x is false, stop at the first true one
+        size_t end = qs->offsets[f + 1];
+        for (size_t k = qs->offsets[f]; k < end && qs->thresholds[k] <= x; k++) {
+            leafsets[qs->trees[k]] &= qs->masks[k];
+        }
+    }
+
+    // in model order like tree_ensemble_predict, the fallback trees in between the others,
+    // so that the sum rounds the same
+    double sum = model->base_value;
+    size_t q = 0, next = 0;
+    for (size_t t = 0; t < model->tree_count; t++) {
+        if (next < qs->fallback_count && qs->fallback_trees[next] == t) {
+            sum += model->leaves[tree_ensemble_leaf(model, model->roots[t], features)];
+            next++;
+        } else {
+            sum += model->leaves[qs->leaf_offsets[q] + (size_t)__builtin_ctzll(leafsets[q])];
+            q++;
+        }
+    }
+    return tree_ensemble_transform(model, sum);
+}
+
+void quickscorer_predict(const quickscorer_t *scorer, const float *features, size_t n_rows, double *out) {
+    uint64_t stack_leafsets[256];
+    uint64_t *leafsets = stack_leafsets;
+    if (scorer->tree_count > 256) {
+        leafsets = malloc(scorer->tree_count * sizeof(uint64_t));
+        if (!leafsets) {
+            tree_ensemble_predict(scorer->model, features, n_rows, out);
+            return;
+        }
+    }
+
+    size_t feature_count = scorer->model->feature_count;
+    for (size_t r = 0; r < n_rows; r++) {
+        out[r] = quickscorer_predict_one(scorer, features + r * feature_count, leafsets);
+    }
+
+    if (leafsets != stack_leafsets) {
+        free(leafsets);
+    }
+}
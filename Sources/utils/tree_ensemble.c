@@ -0,0 +1,803 @@
+//
+//  tree_ensemble.c
+//
+//
+//  Created on 2023/7/24.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+
+#include "tree_ensemble.h"
+
+// CoreML Model.proto field numbers
+#define MODEL_DESCRIPTION 2
+#define MODEL_TREE_ENSEMBLE_REGRESSOR 302
+#define DESCRIPTION_INPUT 1
+#define DESCRIPTION_METADATA 100
+#define FEATURE_DESCRIPTION_NAME 1
+#define METADATA_USER_DEFINED 100
+#define MAP_ENTRY_KEY 1
+#define MAP_ENTRY_VALUE 2
+#define REGRESSOR_PARAMETERS 1
+#define REGRESSOR_TRANSFORM 2
+#define PARAMETERS_NODES 1
+#define PARAMETERS_DIMENSIONS 2
+#define PARAMETERS_BASE_PREDICTION 3
+#define NODE_TREE_ID 1
+#define NODE_NODE_ID 2
+#define NODE_BEHAVIOR 3
+#define NODE_FEATURE_INDEX 10
+#define NODE_FEATURE_VALUE 11
+#define NODE_TRUE_CHILD 12
+#define NODE_FALSE_CHILD 13
+#define NODE_MISSING_TRACKS_TRUE 14
+#define NODE_EVALUATION_INFO 20
+#define EVALUATION_INDEX 1
+#define EVALUATION_VALUE 2
+
+// TreeNodeBehavior
+#define BRANCH_LESS_THAN_EQUAL 0
+#define BRANCH_LESS_THAN 1
+#define BRANCH_GREATER_THAN_EQUAL 2
+#define BRANCH_GREATER_THAN 3
+#define LEAF_NODE 6
+
+#define WIRE_VARINT 0
+#define WIRE_FIXED64 1
+#define WIRE_LENGTH_DELIMITED 2
+#define WIRE_FIXED32 5
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} pb_reader_t;
+
+typedef struct {
+    uint64_t tree_id;
+    uint64_t node_id;
+    uint64_t behavior;
+    uint64_t feature;
+    double value;
+    uint64_t true_child;
+    uint64_t false_child;
+    int missing_tracks_true;
+    double leaf_value;
+} raw_node_t;
+
+typedef struct {
+    raw_node_t *nodes;
+    size_t count;
+    size_t capacity;
+} raw_nodes_t;
+
+static int pb_read_varint(pb_reader_t *r, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        uint8_t byte = *r->p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            *value = result;
+            return 0;
+        }
+    }
+    return ERR_TE_INVALID_MODEL;
+}
+
+static int pb_read_double(pb_reader_t *r, double *value) {
+    if (r->end - r->p < 8) {
+        return ERR_TE_INVALID_MODEL;
+    }
+    // protobuf fixed64 is little endian
+    uint64_t bits = 0;
+    for (int i = 7; i >= 0; i--) {
+        bits = (bits << 8) | r->p[i];
+    }
+    memcpy(value, &bits, sizeof(double));
+    r->p += 8;
+    return 0;
+}
+
+static int pb_read_bytes(pb_reader_t *r, pb_reader_t *sub) {
+    uint64_t length;
+    if (pb_read_varint(r, &length) != 0 || length > (uint64_t)(r->end - r->p)) {
+        return ERR_TE_INVALID_MODEL;
+    }
+    sub->p = r->p;
+    sub->end = r->p + length;
+    r->p += length;
+    return 0;
+}
+
+static int pb_read_tag(pb_reader_t *r, uint64_t *field, int *wire_type) {
+    uint64_t key;
+    if (pb_read_varint(r, &key) != 0) {
+        return ERR_TE_INVALID_MODEL;
+    }
+    *field = key >> 3;
+    *wire_type = (int)(key & 0x7);
+    return 0;
+}
+
+static int pb_skip(pb_reader_t *r, int wire_type) {
+    uint64_t ignored;
+    pb_reader_t sub;
+    switch (wire_type) {
+        case WIRE_VARINT:
+            return pb_read_varint(r, &ignored);
+        case WIRE_FIXED64:
+            if (r->end - r->p < 8) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            r->p += 8;
+            return 0;
+        case WIRE_LENGTH_DELIMITED:
+            return pb_read_bytes(r, &sub);
+        case WIRE_FIXED32:
+            if (r->end - r->p < 4) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            r->p += 4;
+            return 0;
+        default:
+            return ERR_TE_INVALID_MODEL;
+    }
+}
+
+static char *pb_strdup(const pb_reader_t *r) {
+    size_t length = (size_t)(r->end - r->p);
+    char *s = malloc(length + 1);
+    if (s) {
+        memcpy(s, r->p, length);
+        s[length] = '\0';
+    }
+    return s;
+}
+
+static int gunzip(const uint8_t *data, size_t size, uint8_t **out, size_t *out_size) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 15 window bits + 32 to detect the gzip header, same as ModelLoader
+    if (inflateInit2(&stream, 47) != Z_OK) {
+        return ERR_TE_DECOMPRESSION;
+    }
+
+    size_t capacity = size * 4 + 1024;
+    uint8_t *buffer = malloc(capacity);
+    if (!buffer) {
+        inflateEnd(&stream);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = (uInt)size;
+    int status;
+    do {
+        if (stream.total_out == capacity) {
+            uint8_t *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                inflateEnd(&stream);
+                return ERR_TE_OUT_OF_MEMORY;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        stream.next_out = buffer + stream.total_out;
+        stream.avail_out = (uInt)(capacity - stream.total_out);
+        status = inflate(&stream, Z_NO_FLUSH);
+    } while (status == Z_OK);
+
+    *out_size = stream.total_out;
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        free(buffer);
+        return ERR_TE_DECOMPRESSION;
+    }
+    *out = buffer;
+    return 0;
+}
+
+static char **append_string(char **array, size_t count, char *s) {
+    char **grown = realloc(array, (count + 1) * sizeof(char *));
+    if (grown) {
+        grown[count] = s;
+    }
+    return grown;
+}
+
+static int parse_metadata(pb_reader_t r, tree_ensemble_t *model) {
+    uint64_t field;
+    int wire_type;
+    while (r.p < r.end) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        if (field != METADATA_USER_DEFINED || wire_type != WIRE_LENGTH_DELIMITED) {
+            if (pb_skip(&r, wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            continue;
+        }
+
+        pb_reader_t entry, key = { 0 }, value = { 0 }, sub;
+        if (pb_read_bytes(&r, &entry) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        while (entry.p < entry.end) {
+            if (pb_read_tag(&entry, &field, &wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            if (wire_type == WIRE_LENGTH_DELIMITED && (field == MAP_ENTRY_KEY || field == MAP_ENTRY_VALUE)) {
+                if (pb_read_bytes(&entry, &sub) != 0) {
+                    return ERR_TE_INVALID_MODEL;
+                }
+                if (field == MAP_ENTRY_KEY) {
+                    key = sub;
+                } else {
+                    value = sub;
+                }
+            } else if (pb_skip(&entry, wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+        }
+
+        char *k = pb_strdup(&key);
+        char *v = pb_strdup(&value);
+        char **keys = k && v ? append_string(model->metadata_keys, model->metadata_count, k) : NULL;
+        if (keys) {
+            model->metadata_keys = keys;
+        }
+        char **values = keys ? append_string(model->metadata_values, model->metadata_count, v) : NULL;
+        if (!values) {
+            free(k);
+            free(v);
+            return ERR_TE_OUT_OF_MEMORY;
+        }
+        model->metadata_values = values;
+        model->metadata_count++;
+    }
+    return 0;
+}
+
+static int parse_description(pb_reader_t r, tree_ensemble_t *model) {
+    uint64_t field;
+    int wire_type;
+    while (r.p < r.end) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        if (wire_type != WIRE_LENGTH_DELIMITED || (field != DESCRIPTION_INPUT && field != DESCRIPTION_METADATA)) {
+            if (pb_skip(&r, wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            continue;
+        }
+
+        pb_reader_t sub;
+        if (pb_read_bytes(&r, &sub) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+
+        if (field == DESCRIPTION_METADATA) {
+            int status = parse_metadata(sub, model);
+            if (status != 0) {
+                return status;
+            }
+            continue;
+        }
+
+        pb_reader_t name = { 0 };
+        while (sub.p < sub.end) {
+            if (pb_read_tag(&sub, &field, &wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            if (field == FEATURE_DESCRIPTION_NAME && wire_type == WIRE_LENGTH_DELIMITED) {
+                if (pb_read_bytes(&sub, &name) != 0) {
+                    return ERR_TE_INVALID_MODEL;
+                }
+            } else if (pb_skip(&sub, wire_type) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+        }
+
+        char *s = pb_strdup(&name);
+        char **names = s ? append_string(model->feature_names, model->feature_count, s) : NULL;
+        if (!names) {
+            free(s);
+            return ERR_TE_OUT_OF_MEMORY;
+        }
+        model->feature_names = names;
+        model->feature_count++;
+    }
+    return 0;
+}
+
+static int parse_node(pb_reader_t r, raw_nodes_t *raw) {
+    if (raw->count == raw->capacity) {
+        size_t capacity = raw->capacity ? raw->capacity * 2 : 256;
+        raw_node_t *grown = realloc(raw->nodes, capacity * sizeof(raw_node_t));
+        if (!grown) {
+            return ERR_TE_OUT_OF_MEMORY;
+        }
+        raw->nodes = grown;
+        raw->capacity = capacity;
+    }
+
+    raw_node_t *node = &raw->nodes[raw->count++];
+    memset(node, 0, sizeof(raw_node_t));
+
+    uint64_t field, flag = 0;
+    int wire_type;
+    int status = 0;
+    while (r.p < r.end && status == 0) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        if (wire_type == WIRE_VARINT) {
+            switch (field) {
+                case NODE_TREE_ID: status = pb_read_varint(&r, &node->tree_id); continue;
+                case NODE_NODE_ID: status = pb_read_varint(&r, &node->node_id); continue;
+                case NODE_BEHAVIOR: status = pb_read_varint(&r, &node->behavior); continue;
+                case NODE_FEATURE_INDEX: status = pb_read_varint(&r, &node->feature); continue;
+                case NODE_TRUE_CHILD: status = pb_read_varint(&r, &node->true_child); continue;
+                case NODE_FALSE_CHILD: status = pb_read_varint(&r, &node->false_child); continue;
+                case NODE_MISSING_TRACKS_TRUE:
+                    status = pb_read_varint(&r, &flag);
+                    node->missing_tracks_true = flag != 0;
+                    continue;
+            }
+        } else if (wire_type == WIRE_FIXED64 && field == NODE_FEATURE_VALUE) {
+            status = pb_read_double(&r, &node->value);
+            continue;
+        } else if (wire_type == WIRE_LENGTH_DELIMITED && field == NODE_EVALUATION_INFO) {
+            pb_reader_t info;
+            uint64_t index = 0;
+            double value = 0;
+            if (pb_read_bytes(&r, &info) != 0) {
+                return ERR_TE_INVALID_MODEL;
+            }
+            while (info.p < info.end && status == 0) {
+                if (pb_read_tag(&info, &field, &wire_type) != 0) {
+                    return ERR_TE_INVALID_MODEL;
+                }
+                if (field == EVALUATION_INDEX && wire_type == WIRE_VARINT) {
+                    status = pb_read_varint(&info, &index);
+                } else if (field == EVALUATION_VALUE && wire_type == WIRE_FIXED64) {
+                    status = pb_read_double(&info, &value);
+                } else {
+                    status = pb_skip(&info, wire_type);
+                }
+            }
+            if (index != 0) {
+                return ERR_TE_UNSUPPORTED_MODEL;
+            }
+            node->leaf_value += value;
+            continue;
+        }
+        status = pb_skip(&r, wire_type);
+    }
+    return status;
+}
+
+static int parse_parameters(pb_reader_t r, raw_nodes_t *raw, tree_ensemble_t *model) {
+    uint64_t field, dimensions = 1;
+    int wire_type;
+    int status = 0;
+    int has_base_value = 0;
+    while (r.p < r.end && status == 0) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        pb_reader_t sub;
+        if (field == PARAMETERS_NODES && wire_type == WIRE_LENGTH_DELIMITED) {
+            status = pb_read_bytes(&r, &sub);
+            if (status == 0) {
+                status = parse_node(sub, raw);
+            }
+        } else if (field == PARAMETERS_DIMENSIONS && wire_type == WIRE_VARINT) {
+            status = pb_read_varint(&r, &dimensions);
+        } else if (field == PARAMETERS_BASE_PREDICTION && wire_type == WIRE_FIXED64) {
+            status = pb_read_double(&r, &model->base_value);
+            has_base_value++;
+        } else if (field == PARAMETERS_BASE_PREDICTION && wire_type == WIRE_LENGTH_DELIMITED) {
+            // packed repeated double
+            status = pb_read_bytes(&r, &sub);
+            while (status == 0 && sub.p < sub.end) {
+                status = pb_read_double(&sub, &model->base_value);
+                has_base_value++;
+            }
+        } else {
+            status = pb_skip(&r, wire_type);
+        }
+    }
+    if (status == 0 && (dimensions != 1 || has_base_value > 1)) {
+        return ERR_TE_UNSUPPORTED_MODEL;
+    }
+    return status;
+}
+
+static int parse_regressor(pb_reader_t r, raw_nodes_t *raw, tree_ensemble_t *model) {
+    uint64_t field, transform = TREE_ENSEMBLE_TRANSFORM_NONE;
+    int wire_type;
+    int status = 0;
+    while (r.p < r.end && status == 0) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            return ERR_TE_INVALID_MODEL;
+        }
+        if (field == REGRESSOR_PARAMETERS && wire_type == WIRE_LENGTH_DELIMITED) {
+            pb_reader_t sub;
+            status = pb_read_bytes(&r, &sub);
+            if (status == 0) {
+                status = parse_parameters(sub, raw, model);
+            }
+        } else if (field == REGRESSOR_TRANSFORM && wire_type == WIRE_VARINT) {
+            status = pb_read_varint(&r, &transform);
+            if (status == 0 && transform != TREE_ENSEMBLE_TRANSFORM_NONE && transform != TREE_ENSEMBLE_TRANSFORM_LOGISTIC) {
+                return ERR_TE_UNSUPPORTED_MODEL;
+            }
+            model->transform = (int)transform;
+        } else {
+            status = pb_skip(&r, wire_type);
+        }
+    }
+    return status;
+}
+
+static int compare_raw_nodes(const void *a, const void *b) {
+    const raw_node_t *x = a, *y = b;
+    if (x->tree_id != y->tree_id) {
+        return x->tree_id < y->tree_id ? -1 : 1;
+    }
+    if (x->node_id != y->node_id) {
+        return x->node_id < y->node_id ? -1 : 1;
+    }
+    return 0;
+}
+
+static const raw_node_t *find_node(const raw_node_t *tree, size_t count, uint64_t node_id) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (tree[mid].node_id < node_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < count && tree[lo].node_id == node_id ? &tree[lo] : NULL;
+}
+
+// smallest float >= t
+static float float_ceil(double t) {
+    float f = (float)t;
+    return (double)f < t ? nextafterf(f, INFINITY) : f;
+}
+
+// smallest float > t, so that x <= t <=> x < float_above(t) for any float x
+static float float_above(double t) {
+    float f = (float)t;
+    if ((double)f > t) {
+        return f;
+    }
+    return nextafterf(f, INFINITY);
+}
+
+static int emit_node(const raw_node_t *tree, size_t count, const raw_node_t *node, size_t depth, tree_ensemble_t *model, int32_t *ref) {
+    if (depth > count) {
+        // a cycle
+        return ERR_TE_INVALID_MODEL;
+    }
+
+    if (node->behavior == LEAF_NODE) {
+        model->leaves[model->leaf_count] = node->leaf_value;
+        *ref = ~(int32_t)model->leaf_count++;
+        return 0;
+    }
+
+    const raw_node_t *true_child = find_node(tree, count, node->true_child);
+    const raw_node_t *false_child = find_node(tree, count, node->false_child);
+    if (!true_child || !false_child || node->feature >= model->feature_count || isnan(node->value)) {
+        return ERR_TE_INVALID_MODEL;
+    }
+
+    // normalize to "go left when x < threshold"
+    float threshold;
+    int swap;
+    switch (node->behavior) {
+        case BRANCH_LESS_THAN: threshold = float_ceil(node->value); swap = 0; break;
+        case BRANCH_LESS_THAN_EQUAL: threshold = float_above(node->value); swap = 0; break;
+        case BRANCH_GREATER_THAN_EQUAL: threshold = float_ceil(node->value); swap = 1; break;
+        case BRANCH_GREATER_THAN: threshold = float_above(node->value); swap = 1; break;
+        default: return ERR_TE_UNSUPPORTED_MODEL;
+    }
+
+    size_t index = model->node_count++;
+    tree_node_t *out = &model->nodes[index];
+    out->threshold = threshold;
+    out->feature = (uint32_t)node->feature;
+    if (node->missing_tracks_true != swap) {
+        out->feature |= TREE_NODE_MISSING_LEFT;
+    }
+
+    int32_t left, right;
+    int status = emit_node(tree, count, swap ? false_child : true_child, depth + 1, model, &left);
+    if (status == 0) {
+        status = emit_node(tree, count, swap ? true_child : false_child, depth + 1, model, &right);
+    }
+    if (status == 0) {
+        out->left = left;
+        out->right = right;
+    }
+    *ref = (int32_t)index;
+    return status;
+}
+
+static int flatten(raw_nodes_t *raw, tree_ensemble_t *model) {
+    if (raw->count == 0 || raw->count > INT32_MAX) {
+        return ERR_TE_INVALID_MODEL;
+    }
+
+    qsort(raw->nodes, raw->count, sizeof(raw_node_t), compare_raw_nodes);
+
+    size_t tree_count = 1;
+    for (size_t i = 1; i < raw->count; i++) {
+        if (raw->nodes[i].tree_id != raw->nodes[i - 1].tree_id) {
+            tree_count++;
+        } else if (raw->nodes[i].node_id == raw->nodes[i - 1].node_id) {
+            return ERR_TE_INVALID_MODEL;
+        }
+    }
+
+    model->roots = malloc(tree_count * sizeof(int32_t));
+    model->nodes = malloc(raw->count * sizeof(tree_node_t));
+    model->leaves = malloc(raw->count * sizeof(double));
+    uint8_t *referenced = calloc(raw->count, 1);
+    if (!model->roots || !model->nodes || !model->leaves || !referenced) {
+        free(referenced);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    int status = 0;
+    size_t start = 0;
+    while (start < raw->count && status == 0) {
+        size_t end = start + 1;
+        while (end < raw->count && raw->nodes[end].tree_id == raw->nodes[start].tree_id) {
+            end++;
+        }
+
+        // the root is the only node that is nobody's child, every other node is the child of exactly
+        // one branch. A node shared by two branches would be emitted once per path to it, past the
+        // raw->count nodes and leaves allocated above.
+        const raw_node_t *tree = &raw->nodes[start];
+        size_t count = end - start;
+        for (size_t i = 0; i < count && status == 0; i++) {
+            if (tree[i].behavior != LEAF_NODE) {
+                const raw_node_t *t = find_node(tree, count, tree[i].true_child);
+                const raw_node_t *f = find_node(tree, count, tree[i].false_child);
+                if ((t && referenced[start + (size_t)(t - tree)]++) || (f && referenced[start + (size_t)(f - tree)]++)) {
+                    status = ERR_TE_INVALID_MODEL;
+                }
+            }
+        }
+        if (status != 0) {
+            break;
+        }
+        const raw_node_t *root = NULL;
+        for (size_t i = 0; i < count; i++) {
+            if (!referenced[start + i]) {
+                if (root) {
+                    root = NULL;
+                    break;
+                }
+                root = &tree[i];
+            }
+        }
+
+        if (!root) {
+            status = ERR_TE_INVALID_MODEL;
+        } else {
+            status = emit_node(tree, count, root, 0, model, &model->roots[model->tree_count++]);
+        }
+        start = end;
+    }
+
+    free(referenced);
+    return status;
+}
+
+static int parse_model(pb_reader_t r, tree_ensemble_t *model) {
+    raw_nodes_t raw = { 0 };
+    uint64_t field;
+    int wire_type;
+    int status = 0;
+    int has_regressor = 0;
+    while (r.p < r.end && status == 0) {
+        if (pb_read_tag(&r, &field, &wire_type) != 0) {
+            status = ERR_TE_INVALID_MODEL;
+            break;
+        }
+        pb_reader_t sub;
+        if (field == MODEL_DESCRIPTION && wire_type == WIRE_LENGTH_DELIMITED) {
+            status = pb_read_bytes(&r, &sub);
+            if (status == 0) {
+                status = parse_description(sub, model);
+            }
+        } else if (field == MODEL_TREE_ENSEMBLE_REGRESSOR && wire_type == WIRE_LENGTH_DELIMITED) {
+            status = pb_read_bytes(&r, &sub);
+            if (status == 0) {
+                status = parse_regressor(sub, &raw, model);
+            }
+            has_regressor = 1;
+        } else {
+            status = pb_skip(&r, wire_type);
+        }
+    }
+
+    if (status == 0 && !has_regressor) {
+        // pipelines, neural networks etc.
+        status = ERR_TE_UNSUPPORTED_MODEL;
+    }
+    if (status == 0) {
+        status = flatten(&raw, model);
+    }
+    free(raw.nodes);
+    return status;
+}
+
+int tree_ensemble_load(const uint8_t *data, size_t size, tree_ensemble_t **model) {
+    uint8_t *unzipped = NULL;
+    size_t unzipped_size = 0;
+    if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        int status = gunzip(data, size, &unzipped, &unzipped_size);
+        if (status != 0) {
+            return status;
+        }
+        data = unzipped;
+        size = unzipped_size;
+    }
+
+    tree_ensemble_t *result = calloc(1, sizeof(tree_ensemble_t));
+    if (!result) {
+        free(unzipped);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    pb_reader_t r = { data, data + size };
+    int status = parse_model(r, result);
+    free(unzipped);
+    if (status != 0) {
+        tree_ensemble_free(result);
+        return status;
+    }
+    *model = result;
+    return 0;
+}
+
+void tree_ensemble_free(tree_ensemble_t *model) {
+    if (!model) {
+        return;
+    }
+    // partial ensembles don't own feature names
+    for (size_t i = 0; model->feature_names && i < model->feature_count; i++) {
+        free(model->feature_names[i]);
+    }
+    for (size_t i = 0; i < model->metadata_count; i++) {
+        free(model->metadata_keys[i]);
+        free(model->metadata_values[i]);
+    }
+    free(model->feature_names);
+    free(model->metadata_keys);
+    free(model->metadata_values);
+    free(model->roots);
+    free(model->nodes);
+    free(model->leaves);
+    free(model);
+}
+
+typedef struct {
+    const tree_ensemble_t *model;
+    const float *features;
+    const uint8_t *fixed;
+    tree_ensemble_t *partial;
+} partial_state_t;
+
+// Copies the part of a subtree still reachable once fixed features are resolved and returns its new reference
+static int32_t emit_partial(partial_state_t *state, int32_t ref) {
+    const tree_ensemble_t *model = state->model;
+    while (ref >= 0) {
+        const tree_node_t *node = &model->nodes[ref];
+        uint32_t feature = node->feature & TREE_NODE_FEATURE_MASK;
+        if (!state->fixed[feature]) {
+            break;
+        }
+        float x = state->features[feature];
+        int left = x < node->threshold || (x != x && (node->feature & TREE_NODE_MISSING_LEFT));
+        ref = left ? node->left : node->right;
+    }
+
+    tree_ensemble_t *partial = state->partial;
+    if (ref < 0) {
+        partial->leaves[partial->leaf_count] = model->leaves[~ref];
+        return ~(int32_t)partial->leaf_count++;
+    }
+    // left subtree directly follows its parent, like tree_ensemble_load lays it out
+    int32_t index = (int32_t)partial->node_count++;
+    partial->nodes[index] = model->nodes[ref];
+    int32_t left = emit_partial(state, model->nodes[ref].left);
+    int32_t right = emit_partial(state, model->nodes[ref].right);
+    partial->nodes[index].left = left;
+    partial->nodes[index].right = right;
+    return index;
+}
+
+static void build_partial(const tree_ensemble_t *model, const float *features, const uint8_t *fixed, tree_ensemble_t *result) {
+    result->feature_count = model->feature_count;
+    result->base_value = model->base_value;
+    result->transform = model->transform;
+    partial_state_t state = { model, features, fixed, result };
+    for (size_t t = 0; t < model->tree_count; t++) {
+        result->roots[t] = emit_partial(&state, model->roots[t]);
+    }
+    result->tree_count = model->tree_count;
+}
+
+int tree_ensemble_partial(const tree_ensemble_t *model, const float *features, const uint8_t *fixed, tree_ensemble_t **partial) {
+    tree_ensemble_t *result = calloc(1, sizeof(tree_ensemble_t));
+    if (!result) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    result->roots = malloc((model->tree_count + 1) * sizeof(int32_t));
+    result->nodes = malloc((model->node_count + 1) * sizeof(tree_node_t));
+    result->leaves = malloc((model->leaf_count + 1) * sizeof(double));
+    if (!result->roots || !result->nodes || !result->leaves) {
+        tree_ensemble_free(result);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    build_partial(model, features, fixed, result);
+    *partial = result;
+    return 0;
+}
+
+int tree_ensemble_partial_arena(const tree_ensemble_t *model, const float *features, const uint8_t *fixed, arena_t *arena, tree_ensemble_t **partial) {
+    // nothing is freed on failure, the caller releases the arena
+    tree_ensemble_t *result = arena_calloc(arena, sizeof(tree_ensemble_t), _Alignof(tree_ensemble_t));
+    if (!result) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    result->roots = arena_alloc(arena, (model->tree_count + 1) * sizeof(int32_t), _Alignof(int32_t));
+    result->nodes = arena_alloc(arena, (model->node_count + 1) * sizeof(tree_node_t), _Alignof(tree_node_t));
+    result->leaves = arena_alloc(arena, (model->leaf_count + 1) * sizeof(double), _Alignof(double));
+    if (!result->roots || !result->nodes || !result->leaves) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    build_partial(model, features, fixed, result);
+    *partial = result;
+    return 0;
+}
+
+double tree_ensemble_transform(const tree_ensemble_t *model, double sum) {
+    if (model->transform == TREE_ENSEMBLE_TRANSFORM_LOGISTIC) {
+        return 1.0 / (1.0 + exp(-sum));
+    }
+    return sum;
+}
+
+double tree_ensemble_predict_one(const tree_ensemble_t *model, const float *features) {
+    double sum = model->base_value;
+    for (size_t t = 0; t < model->tree_count; t++) {
+        sum += model->leaves[tree_ensemble_leaf(model, model->roots[t], features)];
+    }
+    return tree_ensemble_transform(model, sum);
+}
+
+void tree_ensemble_predict(const tree_ensemble_t *model, const float *features, size_t n_rows, double *out) {
+    for (size_t r = 0; r < n_rows; r++) {
+        out[r] = tree_ensemble_predict_one(model, features + r * model->feature_count);
+    }
+}
@@ -0,0 +1,431 @@
+//
+//  tree_ensemble_simd.c
+//
+//
+//  Created on 2023/8/7.
+//
+
+#include <stdlib.h>
+
+#include "tree_ensemble_simd.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TREE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#define SCALAR_BLOCK 16
+
+// Padding past the last tree so whole levels can be loaded with full width vector loads
+#define NODE_PADDING 32
+
+static uint32_t tree_depth(const tree_ensemble_t *model, int32_t ref) {
+    if (ref < 0) {
+        return 0;
+    }
+    uint32_t left = tree_depth(model, model->nodes[ref].left);
+    uint32_t right = tree_depth(model, model->nodes[ref].right);
+    return 1 + (left > right ? left : right);
+}
+
+static void pad_tree(const tree_ensemble_t *model, int32_t ref, size_t position, uint32_t level, uint32_t depth, float *thresholds, uint32_t *features, double *leaves) {
+    if (level == depth) {
+        leaves[position - (((size_t)1 << depth) - 1)] = model->leaves[~ref];
+        return;
+    }
+    if (ref < 0) {
+        // padding above a leaf, both sides end up in copies of it
+        thresholds[position] = 0;
+        features[position] = 0;
+        pad_tree(model, ref, 2 * position + 1, level + 1, depth, thresholds, features, leaves);
+        pad_tree(model, ref, 2 * position + 2, level + 1, depth, thresholds, features, leaves);
+        return;
+    }
+    const tree_node_t *node = &model->nodes[ref];
+    thresholds[position] = node->threshold;
+    features[position] = node->feature;
+    pad_tree(model, node->left, 2 * position + 1, level + 1, depth, thresholds, features, leaves);
+    pad_tree(model, node->right, 2 * position + 2, level + 1, depth, thresholds, features, leaves);
+}
+
+// depths and offsets of every tree, returns the padded node and leaf counts
+static void layout_trees(const tree_ensemble_t *model, tree_simd_t *result, size_t *node_count, size_t *leaf_count) {
+    *node_count = 0;
+    *leaf_count = 0;
+    for (size_t t = 0; t < model->tree_count; t++) {
+        uint32_t depth = tree_depth(model, model->roots[t]);
+        result->depths[t] = depth;
+        result->node_offsets[t] = *node_count;
+        result->leaf_offsets[t] = *leaf_count;
+        if (depth <= TREE_SIMD_MAX_DEPTH) {
+            *node_count += ((size_t)1 << depth) - 1;
+            *leaf_count += (size_t)1 << depth;
+        }
+    }
+}
+
+static void pad_trees(const tree_ensemble_t *model, tree_simd_t *result) {
+    for (size_t t = 0; t < model->tree_count; t++) {
+        if (result->depths[t] <= TREE_SIMD_MAX_DEPTH) {
+            size_t offset = result->node_offsets[t];
+            pad_tree(model, model->roots[t], 0, 0, result->depths[t], result->thresholds + offset, result->features + offset, result->leaves + result->leaf_offsets[t]);
+        }
+    }
+}
+
+int tree_simd_build(const tree_ensemble_t *model, tree_simd_t **simd) {
+    tree_simd_t *result = calloc(1, sizeof(tree_simd_t));
+    if (!result) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    result->model = model;
+    result->level = tree_simd_level();
+    result->depths = malloc((model->tree_count + 1) * sizeof(uint32_t));
+    result->node_offsets = malloc((model->tree_count + 1) * sizeof(size_t));
+    result->leaf_offsets = malloc((model->tree_count + 1) * sizeof(size_t));
+    if (!result->depths || !result->node_offsets || !result->leaf_offsets) {
+        tree_simd_free(result);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    size_t node_count, leaf_count;
+    layout_trees(model, result, &node_count, &leaf_count);
+
+    result->thresholds = calloc(node_count + NODE_PADDING, sizeof(float));
+    result->features = calloc(node_count + NODE_PADDING, sizeof(uint32_t));
+    result->leaves = malloc((leaf_count + 1) * sizeof(double));
+    if (!result->thresholds || !result->features || !result->leaves) {
+        tree_simd_free(result);
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    pad_trees(model, result);
+    *simd = result;
+    return 0;
+}
+
+int tree_simd_build_arena(const tree_ensemble_t *model, arena_t *arena, tree_simd_t **simd) {
+    // nothing is freed on failure, the caller releases the arena
+    tree_simd_t *result = arena_calloc(arena, sizeof(tree_simd_t), _Alignof(tree_simd_t));
+    if (!result) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+    result->model = model;
+    result->level = tree_simd_level();
+    result->depths = arena_alloc(arena, (model->tree_count + 1) * sizeof(uint32_t), _Alignof(uint32_t));
+    result->node_offsets = arena_alloc(arena, (model->tree_count + 1) * sizeof(size_t), _Alignof(size_t));
+    result->leaf_offsets = arena_alloc(arena, (model->tree_count + 1) * sizeof(size_t), _Alignof(size_t));
+    if (!result->depths || !result->node_offsets || !result->leaf_offsets) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    size_t node_count, leaf_count;
+    layout_trees(model, result, &node_count, &leaf_count);
+
+    // 64 byte aligned so levels start on a cache line like the malloc'd layout usually does
+    result->thresholds = arena_calloc(arena, (node_count + NODE_PADDING) * sizeof(float), 64);
+    result->features = arena_calloc(arena, (node_count + NODE_PADDING) * sizeof(uint32_t), 64);
+    result->leaves = arena_alloc(arena, (leaf_count + 1) * sizeof(double), 64);
+    if (!result->thresholds || !result->features || !result->leaves) {
+        return ERR_TE_OUT_OF_MEMORY;
+    }
+
+    pad_trees(model, result);
+    *simd = result;
+    return 0;
+}
+
+void tree_simd_free(tree_simd_t *simd) {
+    if (!simd) {
+        return;
+    }
+    free(simd->depths);
+    free(simd->node_offsets);
+    free(simd->leaf_offsets);
+    free(simd->thresholds);
+    free(simd->features);
+    free(simd->leaves);
+    free(simd);
+}
+
+// rows [row, row + count), one tree at a time so a tree stays in cache for the whole block
+static void predict_block_scalar(const tree_ensemble_t *model, const float *columns, size_t n_rows, size_t row, size_t count, double *out) {
+    double sums[SCALAR_BLOCK];
+    for (size_t r = 0; r < count; r++) {
+        sums[r] = model->base_value;
+    }
+    for (size_t t = 0; t < model->tree_count; t++) {
+        for (size_t r = 0; r < count; r++) {
+            int32_t i = model->roots[t];
+            while (i >= 0) {
+                const tree_node_t *node = &model->nodes[i];
+                float x = columns[(size_t)(node->feature & TREE_NODE_FEATURE_MASK) * n_rows + row + r];
+                // NaN fails x < threshold and goes right unless flagged
+                int left = x < node->threshold || (x != x && (node->feature & TREE_NODE_MISSING_LEFT));
+                i = left ? node->left : node->right;
+            }
+            sums[r] += model->leaves[~i];
+        }
+    }
+    for (size_t r = 0; r < count; r++) {
+        out[row + r] = tree_ensemble_transform(model, sums[r]);
+    }
+}
+
+#ifdef TREE_SIMD_X86
+
+// leaf indexes of 8 rows for a tree deeper than TREE_SIMD_MAX_DEPTH
+__attribute__((target("avx2")))
+static __m256i walk_avx2(const tree_ensemble_t *model, int32_t root, const float *columns, __m256i stride, __m256i rows) {
+    // tree_node_t is 4 x 32 bits: threshold, feature, left, right
+    const int *nodes = (const int *)model->nodes;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i feature_mask = _mm256_set1_epi32((int)TREE_NODE_FEATURE_MASK);
+
+    __m256i idx = _mm256_set1_epi32(root);
+    __m256i active = _mm256_cmpgt_epi32(idx, ones);
+    while (!_mm256_testz_si256(active, active)) {
+        __m256i offsets = _mm256_slli_epi32(idx, 2);
+        __m256 active_ps = _mm256_castsi256_ps(active);
+        __m256 threshold = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), (const float *)nodes, offsets, active_ps, 4);
+        __m256i feature = _mm256_mask_i32gather_epi32(zero, nodes + 1, offsets, active, 4);
+        __m256i left = _mm256_mask_i32gather_epi32(zero, nodes + 2, offsets, active, 4);
+        __m256i right = _mm256_mask_i32gather_epi32(zero, nodes + 3, offsets, active, 4);
+
+        __m256i cells = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(feature, feature_mask), stride), rows);
+        __m256 x = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), columns, cells, active_ps, 4);
+
+        __m256 less = _mm256_cmp_ps(x, threshold, _CMP_LT_OQ);
+        __m256 missing = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+        __m256 missing_left = _mm256_castsi256_ps(_mm256_srai_epi32(feature, 31));
+        __m256 go_left = _mm256_or_ps(less, _mm256_and_ps(missing, missing_left));
+
+        __m256i next = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(right), _mm256_castsi256_ps(left), go_left));
+        idx = _mm256_blendv_epi8(idx, next, active);
+        active = _mm256_cmpgt_epi32(idx, ones);
+    }
+    return _mm256_xor_si256(idx, ones);
+}
+
+__attribute__((target("avx2")))
+static void predict_block_avx2(const tree_simd_t *simd, const float *columns, size_t n_rows, size_t row, double *out) {
+    const tree_ensemble_t *model = simd->model;
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i feature_mask = _mm256_set1_epi32((int)TREE_NODE_FEATURE_MASK);
+    const __m256i stride = _mm256_set1_epi32((int)n_rows);
+    const __m256i rows = _mm256_add_epi32(_mm256_set1_epi32((int)row), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    __m256d sum_lo = _mm256_set1_pd(model->base_value);
+    __m256d sum_hi = sum_lo;
+
+    for (size_t t = 0; t < model->tree_count; t++) {
+        uint32_t depth = simd->depths[t];
+        const double *leaves;
+        __m256i leaf;
+        if (depth > TREE_SIMD_MAX_DEPTH) {
+            leaves = model->leaves;
+            leaf = walk_avx2(model, model->roots[t], columns, stride, rows);
+        } else {
+            const float *thresholds = simd->thresholds + simd->node_offsets[t];
+            const uint32_t *features = simd->features + simd->node_offsets[t];
+            leaves = simd->leaves + simd->leaf_offsets[t];
+            __m256i idx = _mm256_setzero_si256();
+            if (depth > 0) {
+                // every lane starts at the root: broadcast it and load the rows' values contiguously
+                uint32_t feature = features[0];
+                __m256 x = _mm256_loadu_ps(columns + (size_t)(feature & TREE_NODE_FEATURE_MASK) * n_rows + row);
+                __m256 go_left = _mm256_cmp_ps(x, _mm256_set1_ps(thresholds[0]), _CMP_LT_OQ);
+                if (feature & TREE_NODE_MISSING_LEFT) {
+                    go_left = _mm256_or_ps(go_left, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+                }
+                // go_left lanes are -1: 2i + 2 - 1
+                idx = _mm256_add_epi32(two, _mm256_castps_si256(go_left));
+            }
+            for (uint32_t level = 1; level < depth; level++) {
+                __m256 threshold;
+                __m256i feature;
+                if (level <= 3) {
+                    // up to 8 nodes on this level, permute them into place instead of gathering
+                    int first = (1 << level) - 1;
+                    __m256i local = _mm256_sub_epi32(idx, _mm256_set1_epi32(first));
+                    threshold = _mm256_permutevar8x32_ps(_mm256_loadu_ps(thresholds + first), local);
+                    feature = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(features + first)), local);
+                } else {
+                    threshold = _mm256_i32gather_ps(thresholds, idx, 4);
+                    feature = _mm256_i32gather_epi32((const int *)features, idx, 4);
+                }
+                __m256i cells = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(feature, feature_mask), stride), rows);
+                __m256 x = _mm256_i32gather_ps(columns, cells, 4);
+
+                __m256 less = _mm256_cmp_ps(x, threshold, _CMP_LT_OQ);
+                __m256 missing = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+                __m256 missing_left = _mm256_castsi256_ps(_mm256_srai_epi32(feature, 31));
+                __m256i go_left = _mm256_castps_si256(_mm256_or_ps(less, _mm256_and_ps(missing, missing_left)));
+                idx = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(idx, 1), two), go_left);
+            }
+            leaf = _mm256_sub_epi32(idx, _mm256_set1_epi32((1 << depth) - 1));
+        }
+        sum_lo = _mm256_add_pd(sum_lo, _mm256_i32gather_pd(leaves, _mm256_castsi256_si128(leaf), 8));
+        sum_hi = _mm256_add_pd(sum_hi, _mm256_i32gather_pd(leaves, _mm256_extracti128_si256(leaf, 1), 8));
+    }
+
+    double sums[8];
+    _mm256_storeu_pd(sums, sum_lo);
+    _mm256_storeu_pd(sums + 4, sum_hi);
+    for (int r = 0; r < 8; r++) {
+        out[row + r] = tree_ensemble_transform(model, sums[r]);
+    }
+}
+
+// leaf indexes of 16 rows for a tree deeper than TREE_SIMD_MAX_DEPTH
+__attribute__((target("avx512f")))
+static __m512i walk_avx512(const tree_ensemble_t *model, int32_t root, const float *columns, __m512i stride, __m512i rows) {
+    const int *nodes = (const int *)model->nodes;
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i feature_mask = _mm512_set1_epi32((int)TREE_NODE_FEATURE_MASK);
+    const __m512i missing_bit = _mm512_set1_epi32((int)TREE_NODE_MISSING_LEFT);
+
+    __m512i idx = _mm512_set1_epi32(root);
+    __mmask16 active = _mm512_cmpge_epi32_mask(idx, zero);
+    while (active) {
+        __m512i offsets = _mm512_slli_epi32(idx, 2);
+        __m512 threshold = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), active, offsets, nodes, 4);
+        __m512i feature = _mm512_mask_i32gather_epi32(zero, active, offsets, nodes + 1, 4);
+        __m512i left = _mm512_mask_i32gather_epi32(zero, active, offsets, nodes + 2, 4);
+        __m512i right = _mm512_mask_i32gather_epi32(zero, active, offsets, nodes + 3, 4);
+
+        __m512i cells = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_and_si512(feature, feature_mask), stride), rows);
+        __m512 x = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), active, cells, columns, 4);
+
+        __mmask16 less = _mm512_cmp_ps_mask(x, threshold, _CMP_LT_OQ);
+        __mmask16 missing = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+        __mmask16 missing_left = _mm512_test_epi32_mask(feature, missing_bit);
+        __mmask16 go_left = less | (missing & missing_left);
+
+        __m512i next = _mm512_mask_blend_epi32(go_left, right, left);
+        idx = _mm512_mask_mov_epi32(idx, active, next);
+        active = _mm512_cmpge_epi32_mask(idx, zero);
+    }
+    return _mm512_xor_si512(idx, _mm512_set1_epi32(-1));
+}
+
+__attribute__((target("avx512f")))
+static void predict_block_avx512(const tree_simd_t *simd, const float *columns, size_t n_rows, size_t row, double *out) {
+    const tree_ensemble_t *model = simd->model;
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i two = _mm512_set1_epi32(2);
+    const __m512i feature_mask = _mm512_set1_epi32((int)TREE_NODE_FEATURE_MASK);
+    const __m512i missing_bit = _mm512_set1_epi32((int)TREE_NODE_MISSING_LEFT);
+    const __m512i stride = _mm512_set1_epi32((int)n_rows);
+    const __m512i rows = _mm512_add_epi32(_mm512_set1_epi32((int)row), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+    __m512d sum_lo = _mm512_set1_pd(model->base_value);
+    __m512d sum_hi = sum_lo;
+
+    for (size_t t = 0; t < model->tree_count; t++) {
+        uint32_t depth = simd->depths[t];
+        const double *leaves;
+        __m512i leaf;
+        if (depth > TREE_SIMD_MAX_DEPTH) {
+            leaves = model->leaves;
+            leaf = walk_avx512(model, model->roots[t], columns, stride, rows);
+        } else {
+            const float *thresholds = simd->thresholds + simd->node_offsets[t];
+            const uint32_t *features = simd->features + simd->node_offsets[t];
+            leaves = simd->leaves + simd->leaf_offsets[t];
+            __m512i idx = _mm512_setzero_si512();
+            if (depth > 0) {
+                uint32_t feature = features[0];
+                __m512 x = _mm512_loadu_ps(columns + (size_t)(feature & TREE_NODE_FEATURE_MASK) * n_rows + row);
+                __mmask16 go_left = _mm512_cmp_ps_mask(x, _mm512_set1_ps(thresholds[0]), _CMP_LT_OQ);
+                if (feature & TREE_NODE_MISSING_LEFT) {
+                    go_left |= _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+                }
+                idx = _mm512_mask_sub_epi32(two, go_left, two, one);
+            }
+            for (uint32_t level = 1; level < depth; level++) {
+                __m512 threshold;
+                __m512i feature;
+                int first = (1 << level) - 1;
+                __m512i local = _mm512_sub_epi32(idx, _mm512_set1_epi32(first));
+                if (level <= 4) {
+                    // up to 16 nodes on this level, permute them into place instead of gathering
+                    threshold = _mm512_permutexvar_ps(local, _mm512_loadu_ps(thresholds + first));
+                    feature = _mm512_permutexvar_epi32(local, _mm512_loadu_si512(features + first));
+                } else if (level == 5) {
+                    threshold = _mm512_permutex2var_ps(_mm512_loadu_ps(thresholds + first), local, _mm512_loadu_ps(thresholds + first + 16));
+                    feature = _mm512_permutex2var_epi32(_mm512_loadu_si512(features + first), local, _mm512_loadu_si512(features + first + 16));
+                } else {
+                    threshold = _mm512_i32gather_ps(idx, thresholds, 4);
+                    feature = _mm512_i32gather_epi32(idx, (const int *)features, 4);
+                }
+                __m512i cells = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_and_si512(feature, feature_mask), stride), rows);
+                __m512 x = _mm512_i32gather_ps(cells, columns, 4);
+
+                __mmask16 less = _mm512_cmp_ps_mask(x, threshold, _CMP_LT_OQ);
+                __mmask16 missing = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+                __mmask16 missing_left = _mm512_test_epi32_mask(feature, missing_bit);
+                __mmask16 go_left = less | (missing & missing_left);
+                // 2i + 2, minus one where the row goes left
+                __m512i next = _mm512_add_epi32(_mm512_slli_epi32(idx, 1), two);
+                idx = _mm512_mask_sub_epi32(next, go_left, next, one);
+            }
+            leaf = _mm512_sub_epi32(idx, _mm512_set1_epi32((1 << depth) - 1));
+        }
+        sum_lo = _mm512_add_pd(sum_lo, _mm512_i32gather_pd(_mm512_castsi512_si256(leaf), leaves, 8));
+        sum_hi = _mm512_add_pd(sum_hi, _mm512_i32gather_pd(_mm512_extracti64x4_epi64(leaf, 1), leaves, 8));
+    }
+
+    double sums[16];
+    _mm512_storeu_pd(sums, sum_lo);
+    _mm512_storeu_pd(sums + 8, sum_hi);
+    for (int r = 0; r < 16; r++) {
+        out[row + r] = tree_ensemble_transform(model, sums[r]);
+    }
+}
+
+#endif
+
+int tree_simd_level(void) {
+#ifdef TREE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return TREE_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return TREE_SIMD_AVX2;
+    }
+#endif
+    return TREE_SIMD_SCALAR;
+}
+
+static void predict_columns(const tree_simd_t *simd, const float *columns, size_t n_rows, double *out, int level) {
+    size_t row = 0;
+#ifdef TREE_SIMD_X86
+    const tree_ensemble_t *model = simd->model;
+    // gather offsets are 32 bit
+    if (model->feature_count * n_rows + n_rows > INT32_MAX || model->node_count > INT32_MAX / 4) {
+        level = TREE_SIMD_SCALAR;
+    }
+    if (level == TREE_SIMD_AVX512) {
+        for (; row + 16 <= n_rows; row += 16) {
+            predict_block_avx512(simd, columns, n_rows, row, out);
+        }
+    } else if (level == TREE_SIMD_AVX2) {
+        for (; row + 8 <= n_rows; row += 8) {
+            predict_block_avx2(simd, columns, n_rows, row, out);
+        }
+    }
+#else
+    (void)level;
+#endif
+    for (; row < n_rows; row += SCALAR_BLOCK) {
+        size_t count = n_rows - row < SCALAR_BLOCK ? n_rows - row : SCALAR_BLOCK;
+        predict_block_scalar(simd->model, columns, n_rows, row, count, out);
+    }
+}
+
+void tree_simd_predict(const tree_simd_t *simd, const float *columns, size_t n_rows, double *out) {
+    predict_columns(simd, columns, n_rows, out, simd->level);
+}
@@ -0,0 +1,147 @@
+//
+//  tree_ensemble_top_k.c
+//
+//
+//  Created on 2023/8/21.
+//
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "tree_ensemble_top_k.h"
+
+// Bounds and sums add the same leaves in different orders, allow for the rounding difference
+#define BOUND_SLACK 1e-12
+
+// Trees evaluated between bound checks, bounds of the first trees are too loose to drop much
+#define CHECK_INTERVAL 8
+
+// k-th largest (k >= 1) of values by quickselect, reorders values
+static double kth_largest(double *values, size_t n, size_t k) {
+    size_t lo = 0, hi = n - 1, target = k - 1;
+    while (lo < hi) {
+        double pivot = values[lo + (hi - lo) / 2];
+        size_t i = lo, j = hi;
+        while (i <= j) {
+            while (values[i] > pivot) {
+                i++;
+            }
+            while (values[j] < pivot) {
+                j--;
+            }
+            if (i <= j) {
+                double t = values[i];
+                values[i] = values[j];
+                values[j] = t;
+                i++;
+                if (j == 0) {
+                    break;
+                }
+                j--;
+            }
+        }
+        if (target <= j) {
+            hi = j;
+        } else if (target >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+    return values[target];
+}
+
+// remaining_max and remaining_min hold tree_count + 1 doubles, bounds n_rows
+static long top_k(const tree_ensemble_t *model, const float *features, size_t n_rows, size_t k, double margin, size_t *rows, double *scores, double *remaining_max, double *remaining_min, double *bounds) {
+    size_t tree_count = model->tree_count;
+    // sums of the largest and smallest leaves of trees [t, tree_count)
+    remaining_max[tree_count] = remaining_min[tree_count] = 0;
+    for (size_t t = tree_count; t-- > 0;) {
+        // leaves of a tree are contiguous, from the leftmost to the rightmost
+        int32_t first = model->roots[t], last = model->roots[t];
+        while (first >= 0) {
+            first = model->nodes[first].left;
+        }
+        while (last >= 0) {
+            last = model->nodes[last].right;
+        }
+        double max = model->leaves[~first], min = model->leaves[~first];
+        for (size_t i = (size_t)~first; i <= (size_t)~last; i++) {
+            max = fmax(max, model->leaves[i]);
+            min = fmin(min, model->leaves[i]);
+        }
+        remaining_max[t] = remaining_max[t + 1] + max;
+        remaining_min[t] = remaining_min[t + 1] + min;
+    }
+
+    size_t live = n_rows;
+    for (size_t r = 0; r < n_rows; r++) {
+        rows[r] = r;
+        scores[r] = model->base_value;
+    }
+    size_t feature_count = model->feature_count;
+    for (size_t t = 0; t < tree_count; t++) {
+        int32_t root = model->roots[t];
+        for (size_t i = 0; i < live; i++) {
+            scores[i] += model->leaves[tree_ensemble_leaf(model, root, features + rows[i] * feature_count)];
+        }
+        if (live <= k || t + 1 == tree_count || (t + 1) % CHECK_INTERVAL != 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < live; i++) {
+            bounds[i] = scores[i] + remaining_min[t + 1];
+        }
+        double threshold = tree_ensemble_transform(model, kth_largest(bounds, live, k));
+        threshold -= margin + BOUND_SLACK * (1 + fabs(threshold));
+
+        size_t kept = 0;
+        for (size_t i = 0; i < live; i++) {
+            if (tree_ensemble_transform(model, scores[i] + remaining_max[t + 1]) >= threshold) {
+                rows[kept] = rows[i];
+                scores[kept] = scores[i];
+                kept++;
+            }
+        }
+        live = kept;
+    }
+
+    for (size_t i = 0; i < live; i++) {
+        scores[i] = tree_ensemble_transform(model, scores[i]);
+    }
+
+    return (long)live;
+}
+
+long tree_ensemble_top_k(const tree_ensemble_t *model, const float *features, size_t n_rows, size_t k, double margin, size_t *rows, double *scores) {
+    if (k == 0) {
+        return 0;
+    }
+    double *remaining_max = malloc((model->tree_count + 1) * sizeof(double));
+    double *remaining_min = malloc((model->tree_count + 1) * sizeof(double));
+    double *bounds = malloc((n_rows + 1) * sizeof(double));
+    long result = ERR_TE_OUT_OF_MEMORY;
+    if (remaining_max && remaining_min && bounds) {
+        result = top_k(model, features, n_rows, k, margin, rows, scores, remaining_max, remaining_min, bounds);
+    }
+    free(remaining_max);
+    free(remaining_min);
+    free(bounds);
+    return result;
+}
+
+long tree_ensemble_top_k_arena(const tree_ensemble_t *model, const float *features, size_t n_rows, size_t k, double margin, arena_t *arena, size_t *rows, double *scores) {
+    if (k == 0) {
+        return 0;
+    }
+    arena_mark_t mark = arena_mark(arena);
+    double *remaining_max = arena_alloc(arena, (model->tree_count + 1) * sizeof(double), _Alignof(double));
+    double *remaining_min = arena_alloc(arena, (model->tree_count + 1) * sizeof(double), _Alignof(double));
+    double *bounds = arena_alloc(arena, (n_rows + 1) * sizeof(double), _Alignof(double));
+    long result = ERR_TE_OUT_OF_MEMORY;
+    if (remaining_max && remaining_min && bounds) {
+        result = top_k(model, features, n_rows, k, margin, rows, scores, remaining_max, remaining_min, bounds);
+    }
+    arena_release(arena, mark);
+    return result;
+}
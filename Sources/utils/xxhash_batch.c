@@ -0,0 +1,50 @@
+//
+//  xxhash_batch.c
+//
+//
+//  Created on 2023/11/13.
+//
+
+// private copies of the XXH3 internals, so the short input paths inline here
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "xxhash_batch.h"
+
+#define SHORT_INPUT 16
+
+#define LANES 4
+
+void xxh3_64_batch(const uint8_t *data, const size_t *offsets, size_t count, uint64_t seed, uint64_t *hashes) {
+    static const uint8_t empty[1] = { 0 };
+    if (!data) {
+        // every string is empty, keep the pointer arithmetic below defined
+        data = empty;
+    }
+    size_t i = 0;
+    while (i + LANES <= count) {
+        size_t longest = 0;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            size_t length = offsets[i + lane + 1] - offsets[i + lane];
+            longest = length > longest ? length : longest;
+        }
+        if (longest > SHORT_INPUT) {
+            hashes[i] = XXH3_64bits_withSeed(data + offsets[i], offsets[i + 1] - offsets[i], seed);
+            i++;
+            continue;
+        }
+        // independent of one another, the compiler interleaves them
+        uint64_t h0 = XXH3_len_0to16_64b(data + offsets[i], offsets[i + 1] - offsets[i], XXH3_kSecret, seed);
+        uint64_t h1 = XXH3_len_0to16_64b(data + offsets[i + 1], offsets[i + 2] - offsets[i + 1], XXH3_kSecret, seed);
+        uint64_t h2 = XXH3_len_0to16_64b(data + offsets[i + 2], offsets[i + 3] - offsets[i + 2], XXH3_kSecret, seed);
+        uint64_t h3 = XXH3_len_0to16_64b(data + offsets[i + 3], offsets[i + 4] - offsets[i + 3], XXH3_kSecret, seed);
+        hashes[i] = h0;
+        hashes[i + 1] = h1;
+        hashes[i + 2] = h2;
+        hashes[i + 3] = h3;
+        i += LANES;
+    }
+    for (; i < count; i++) {
+        hashes[i] = XXH3_64bits_withSeed(data + offsets[i], offsets[i + 1] - offsets[i], seed);
+    }
+}
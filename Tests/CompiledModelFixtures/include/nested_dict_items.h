@@ -0,0 +1,18 @@
+//
+//  nested_dict_items.h
+//
+//  Generated by improve-compile from Tests/Resources/SyntheticModels/2_nested_dict_items_20_random_nested_dict_context_large_binary_reward/2_nested_dict_items_20_random_nested_dict_context_large_binary_reward.mlmodel.gz. Do not edit.
+//
+
+#ifndef nested_dict_items_h
+#define nested_dict_items_h
+
+#include <stddef.h>
+
+#include "compiled_model.h"
+
+extern const compiled_model_t nested_dict_items;
+
+void nested_dict_items_score(const float *features, size_t n, double *out);
+
+#endif /* nested_dict_items_h */
@@ -0,0 +1,1030 @@
+//
+//  nested_dict_items.c
+//
+//  Generated by improve-compile from Tests/Resources/SyntheticModels/2_nested_dict_items_20_random_nested_dict_context_large_binary_reward/2_nested_dict_items_20_random_nested_dict_context_large_binary_reward.mlmodel.gz. Do not edit.
+//
+
+#include <math.h>
+#include <stddef.h>
+
+#include "nested_dict_items.h"
+
+static const char *const nested_dict_items_feature_names[] = {
+    "context.a",
+    "context.b.x",
+    "context.b.y.0",
+    "context.b.y.1",
+    "context.b.y.2",
+    "context.b.z",
+    "item.a",
+    "item.b.x.0",
+    "item.b.x.1",
+    "item.b.x.2",
+    "item.b.y",
+    "item.b.z.value",
+    "item.c.q.value",
+    "item.c.u.0",
+    "item.c.u.1",
+    "item.c.v",
+};
+
+static const char *const nested_dict_items_metadata_keys[] = {
+    "ai.improve.version",
+    "ai.improve.seed",
+    "com.github.apple.coremltools.source",
+    "com.github.apple.coremltools.version",
+    "ai.improve.string_tables",
+    "ai.improve.created_at",
+    "ai.improve.model",
+};
+
+static const char *const nested_dict_items_metadata_values[] = {
+    "8.0.0",
+    "3297447744",
+    "xgboost==1.4.2",
+    "6.3.0",
+    "{\"item.b.z.value\":[1],\"item.c.q.value\":[1],\"context.b.z\":[1]}",
+    "2023-04-05T20:03:40.551894",
+    "local_test_model",
+};
+
+static double nested_dict_items_tree_0(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.da9c88p-5;
+    }
+    return -0x1.2a2b02p-1;
+}
+
+static double nested_dict_items_tree_1(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.4c4c06p-5;
+    }
+    return -0x1.a1867ep-2;
+}
+
+static double nested_dict_items_tree_2(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.d14ffp-6;
+    }
+    return -0x1.2454b6p-2;
+}
+
+static double nested_dict_items_tree_3(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.45c93ep-6;
+    }
+    return -0x1.995a04p-3;
+}
+
+static double nested_dict_items_tree_4(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.c831f4p-7;
+    }
+    return -0x1.1e9ba8p-3;
+}
+
+static double nested_dict_items_tree_5(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.3f671ap-7;
+    }
+    return -0x1.91567cp-4;
+}
+
+static double nested_dict_items_tree_6(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.bf41c2p-8;
+    }
+    return -0x1.18ff44p-4;
+}
+
+static double nested_dict_items_tree_7(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.3924fcp-8;
+    }
+    return -0x1.897b22p-5;
+}
+
+static double nested_dict_items_tree_8(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.b67e3ep-9;
+    }
+    return -0x1.137efep-5;
+}
+
+static double nested_dict_items_tree_9(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.330258p-9;
+    }
+    return -0x1.81c71ap-6;
+}
+
+static double nested_dict_items_tree_10(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.ade71cp-10;
+    }
+    return -0x1.0e1a56p-6;
+}
+
+static double nested_dict_items_tree_11(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.2cfe4ap-10;
+    }
+    return -0x1.7a39aep-7;
+}
+
+static double nested_dict_items_tree_12(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.a5795cp-11;
+    }
+    return -0x1.08d086p-7;
+}
+
+static double nested_dict_items_tree_13(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.271838p-11;
+    }
+    return -0x1.72d1bcp-8;
+}
+
+static double nested_dict_items_tree_14(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.9d37fap-12;
+    }
+    return -0x1.03a118p-8;
+}
+
+static double nested_dict_items_tree_15(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.215288p-12;
+    }
+    return -0x1.6b8eacp-9;
+}
+
+static double nested_dict_items_tree_16(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.95242cp-13;
+    }
+    return -0x1.fd164cp-10;
+}
+
+static double nested_dict_items_tree_17(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.1ba9a4p-13;
+    }
+    return -0x1.646f98p-10;
+}
+
+static double nested_dict_items_tree_18(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.8d3b8ep-14;
+    }
+    return -0x1.f31dfap-11;
+}
+
+static double nested_dict_items_tree_19(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.161d86p-14;
+    }
+    return -0x1.5d747ep-11;
+}
+
+static double nested_dict_items_tree_20(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.8582eap-15;
+    }
+    return -0x1.e95a7p-12;
+}
+
+static double nested_dict_items_tree_21(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.10b7cap-15;
+    }
+    return -0x1.569d62p-12;
+}
+
+static double nested_dict_items_tree_22(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.7e03d8p-16;
+    }
+    return -0x1.dfc216p-13;
+}
+
+static double nested_dict_items_tree_23(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.0b7872p-16;
+    }
+    return -0x1.4fe7d8p-13;
+}
+
+static double nested_dict_items_tree_24(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.76d18ap-17;
+    }
+    return -0x1.d65018p-14;
+}
+
+static double nested_dict_items_tree_25(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.06ac3ep-17;
+    }
+    return -0x1.493be8p-14;
+}
+
+static double nested_dict_items_tree_26(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.7038c2p-18;
+    }
+    return -0x1.cd2aep-15;
+}
+
+static double nested_dict_items_tree_27(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.01e008p-18;
+    }
+    return -0x1.42efecp-15;
+}
+
+static double nested_dict_items_tree_28(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.6a398p-19;
+    }
+    return -0x1.c42c0ap-16;
+}
+
+static double nested_dict_items_tree_29(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.fc8dc2p-20;
+    }
+    return -0x1.3ca3eep-16;
+}
+
+static double nested_dict_items_tree_30(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.63073p-20;
+    }
+    return -0x1.bbc6bap-17;
+}
+
+static double nested_dict_items_tree_31(const float *x) {
+    if (x[7] < 0x1.4f8b58p-17f) {
+        return 0x1.f2f55ap-21;
+    }
+    return -0x1.36a4b4p-17;
+}
+
+static double nested_dict_items_tree_32(const float *x) {
+    (void)x;
+    return -0x1.7d75ep-19;
+}
+
+static double nested_dict_items_tree_33(const float *x) {
+    (void)x;
+    return -0x1.0a49f4p-19;
+}
+
+static double nested_dict_items_tree_34(const float *x) {
+    (void)x;
+    return -0x1.73ddaep-20;
+}
+
+static double nested_dict_items_tree_35(const float *x) {
+    (void)x;
+    return -0x1.03246cp-20;
+}
+
+static double nested_dict_items_tree_36(const float *x) {
+    (void)x;
+    return -0x1.6cb8f4p-21;
+}
+
+static double nested_dict_items_tree_37(const float *x) {
+    (void)x;
+    return -0x1.fce4aep-22;
+}
+
+static double nested_dict_items_tree_38(const float *x) {
+    (void)x;
+    return -0x1.6354ccp-22;
+}
+
+static double nested_dict_items_tree_39(const float *x) {
+    (void)x;
+    return -0x1.e051bep-23;
+}
+
+static double nested_dict_items_tree_40(const float *x) {
+    (void)x;
+    return -0x1.46c1dep-23;
+}
+
+static double nested_dict_items_tree_41(const float *x) {
+    (void)x;
+    return -0x1.ccc952p-24;
+}
+
+static double nested_dict_items_tree_42(const float *x) {
+    (void)x;
+    return -0x1.333966p-24;
+}
+
+static double nested_dict_items_tree_43(const float *x) {
+    (void)x;
+    return -0x1.81a7dap-25;
+}
+
+static double nested_dict_items_tree_44(const float *x) {
+    (void)x;
+    return -0x1.3352fp-25;
+}
+
+static double nested_dict_items_tree_45(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_46(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_47(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_48(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_49(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_50(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_51(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_52(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_53(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_54(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_55(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_56(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_57(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_58(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_59(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_60(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_61(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_62(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_63(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_64(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_65(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_66(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_67(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_68(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_69(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_70(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_71(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_72(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_73(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_74(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_75(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_76(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_77(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_78(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_79(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_80(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_81(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_82(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_83(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_84(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_85(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_86(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_87(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_88(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_89(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_90(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_91(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_92(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_93(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_94(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_95(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_96(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_97(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_98(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_99(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_100(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_101(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_102(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_103(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_104(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_105(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_106(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_107(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_108(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_109(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_110(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_111(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_112(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_113(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_114(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_115(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_116(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_117(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_118(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_119(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_120(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_121(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_122(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_123(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_124(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_125(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_126(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_127(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_128(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_129(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_130(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_131(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_132(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_133(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_134(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_135(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_136(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_137(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_138(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_139(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_140(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_141(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_142(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_143(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_144(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_145(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_146(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_147(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_148(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+static double nested_dict_items_tree_149(const float *x) {
+    (void)x;
+    return -0x1.c9fc8ep-26;
+}
+
+void nested_dict_items_score(const float *features, size_t n, double *out) {
+    for (size_t i = 0; i < n; i++) {
+        const float *x = features + i * 16;
+        double sum = 0x1p-1;
+        sum += nested_dict_items_tree_0(x);
+        sum += nested_dict_items_tree_1(x);
+        sum += nested_dict_items_tree_2(x);
+        sum += nested_dict_items_tree_3(x);
+        sum += nested_dict_items_tree_4(x);
+        sum += nested_dict_items_tree_5(x);
+        sum += nested_dict_items_tree_6(x);
+        sum += nested_dict_items_tree_7(x);
+        sum += nested_dict_items_tree_8(x);
+        sum += nested_dict_items_tree_9(x);
+        sum += nested_dict_items_tree_10(x);
+        sum += nested_dict_items_tree_11(x);
+        sum += nested_dict_items_tree_12(x);
+        sum += nested_dict_items_tree_13(x);
+        sum += nested_dict_items_tree_14(x);
+        sum += nested_dict_items_tree_15(x);
+        sum += nested_dict_items_tree_16(x);
+        sum += nested_dict_items_tree_17(x);
+        sum += nested_dict_items_tree_18(x);
+        sum += nested_dict_items_tree_19(x);
+        sum += nested_dict_items_tree_20(x);
+        sum += nested_dict_items_tree_21(x);
+        sum += nested_dict_items_tree_22(x);
+        sum += nested_dict_items_tree_23(x);
+        sum += nested_dict_items_tree_24(x);
+        sum += nested_dict_items_tree_25(x);
+        sum += nested_dict_items_tree_26(x);
+        sum += nested_dict_items_tree_27(x);
+        sum += nested_dict_items_tree_28(x);
+        sum += nested_dict_items_tree_29(x);
+        sum += nested_dict_items_tree_30(x);
+        sum += nested_dict_items_tree_31(x);
+        sum += nested_dict_items_tree_32(x);
+        sum += nested_dict_items_tree_33(x);
+        sum += nested_dict_items_tree_34(x);
+        sum += nested_dict_items_tree_35(x);
+        sum += nested_dict_items_tree_36(x);
+        sum += nested_dict_items_tree_37(x);
+        sum += nested_dict_items_tree_38(x);
+        sum += nested_dict_items_tree_39(x);
+        sum += nested_dict_items_tree_40(x);
+        sum += nested_dict_items_tree_41(x);
+        sum += nested_dict_items_tree_42(x);
+        sum += nested_dict_items_tree_43(x);
+        sum += nested_dict_items_tree_44(x);
+        sum += nested_dict_items_tree_45(x);
+        sum += nested_dict_items_tree_46(x);
+        sum += nested_dict_items_tree_47(x);
+        sum += nested_dict_items_tree_48(x);
+        sum += nested_dict_items_tree_49(x);
+        sum += nested_dict_items_tree_50(x);
+        sum += nested_dict_items_tree_51(x);
+        sum += nested_dict_items_tree_52(x);
+        sum += nested_dict_items_tree_53(x);
+        sum += nested_dict_items_tree_54(x);
+        sum += nested_dict_items_tree_55(x);
+        sum += nested_dict_items_tree_56(x);
+        sum += nested_dict_items_tree_57(x);
+        sum += nested_dict_items_tree_58(x);
+        sum += nested_dict_items_tree_59(x);
+        sum += nested_dict_items_tree_60(x);
+        sum += nested_dict_items_tree_61(x);
+        sum += nested_dict_items_tree_62(x);
+        sum += nested_dict_items_tree_63(x);
+        sum += nested_dict_items_tree_64(x);
+        sum += nested_dict_items_tree_65(x);
+        sum += nested_dict_items_tree_66(x);
+        sum += nested_dict_items_tree_67(x);
+        sum += nested_dict_items_tree_68(x);
+        sum += nested_dict_items_tree_69(x);
+        sum += nested_dict_items_tree_70(x);
+        sum += nested_dict_items_tree_71(x);
+        sum += nested_dict_items_tree_72(x);
+        sum += nested_dict_items_tree_73(x);
+        sum += nested_dict_items_tree_74(x);
+        sum += nested_dict_items_tree_75(x);
+        sum += nested_dict_items_tree_76(x);
+        sum += nested_dict_items_tree_77(x);
+        sum += nested_dict_items_tree_78(x);
+        sum += nested_dict_items_tree_79(x);
+        sum += nested_dict_items_tree_80(x);
+        sum += nested_dict_items_tree_81(x);
+        sum += nested_dict_items_tree_82(x);
+        sum += nested_dict_items_tree_83(x);
+        sum += nested_dict_items_tree_84(x);
+        sum += nested_dict_items_tree_85(x);
+        sum += nested_dict_items_tree_86(x);
+        sum += nested_dict_items_tree_87(x);
+        sum += nested_dict_items_tree_88(x);
+        sum += nested_dict_items_tree_89(x);
+        sum += nested_dict_items_tree_90(x);
+        sum += nested_dict_items_tree_91(x);
+        sum += nested_dict_items_tree_92(x);
+        sum += nested_dict_items_tree_93(x);
+        sum += nested_dict_items_tree_94(x);
+        sum += nested_dict_items_tree_95(x);
+        sum += nested_dict_items_tree_96(x);
+        sum += nested_dict_items_tree_97(x);
+        sum += nested_dict_items_tree_98(x);
+        sum += nested_dict_items_tree_99(x);
+        sum += nested_dict_items_tree_100(x);
+        sum += nested_dict_items_tree_101(x);
+        sum += nested_dict_items_tree_102(x);
+        sum += nested_dict_items_tree_103(x);
+        sum += nested_dict_items_tree_104(x);
+        sum += nested_dict_items_tree_105(x);
+        sum += nested_dict_items_tree_106(x);
+        sum += nested_dict_items_tree_107(x);
+        sum += nested_dict_items_tree_108(x);
+        sum += nested_dict_items_tree_109(x);
+        sum += nested_dict_items_tree_110(x);
+        sum += nested_dict_items_tree_111(x);
+        sum += nested_dict_items_tree_112(x);
+        sum += nested_dict_items_tree_113(x);
+        sum += nested_dict_items_tree_114(x);
+        sum += nested_dict_items_tree_115(x);
+        sum += nested_dict_items_tree_116(x);
+        sum += nested_dict_items_tree_117(x);
+        sum += nested_dict_items_tree_118(x);
+        sum += nested_dict_items_tree_119(x);
+        sum += nested_dict_items_tree_120(x);
+        sum += nested_dict_items_tree_121(x);
+        sum += nested_dict_items_tree_122(x);
+        sum += nested_dict_items_tree_123(x);
+        sum += nested_dict_items_tree_124(x);
+        sum += nested_dict_items_tree_125(x);
+        sum += nested_dict_items_tree_126(x);
+        sum += nested_dict_items_tree_127(x);
+        sum += nested_dict_items_tree_128(x);
+        sum += nested_dict_items_tree_129(x);
+        sum += nested_dict_items_tree_130(x);
+        sum += nested_dict_items_tree_131(x);
+        sum += nested_dict_items_tree_132(x);
+        sum += nested_dict_items_tree_133(x);
+        sum += nested_dict_items_tree_134(x);
+        sum += nested_dict_items_tree_135(x);
+        sum += nested_dict_items_tree_136(x);
+        sum += nested_dict_items_tree_137(x);
+        sum += nested_dict_items_tree_138(x);
+        sum += nested_dict_items_tree_139(x);
+        sum += nested_dict_items_tree_140(x);
+        sum += nested_dict_items_tree_141(x);
+        sum += nested_dict_items_tree_142(x);
+        sum += nested_dict_items_tree_143(x);
+        sum += nested_dict_items_tree_144(x);
+        sum += nested_dict_items_tree_145(x);
+        sum += nested_dict_items_tree_146(x);
+        sum += nested_dict_items_tree_147(x);
+        sum += nested_dict_items_tree_148(x);
+        sum += nested_dict_items_tree_149(x);
+        out[i] = sum;
+    }
+}
+
+const compiled_model_t nested_dict_items = {
+    16,
+    nested_dict_items_feature_names,
+    7,
+    nested_dict_items_metadata_keys,
+    nested_dict_items_metadata_values,
+    nested_dict_items_score,
+};
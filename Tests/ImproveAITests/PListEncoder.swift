@@ -12,18 +12,7 @@
 
 //@_implementationOnly import CoreFoundation
 import Foundation
-
-fileprivate protocol _Optional {
-    var isNil: Bool { get }
-}
-
-extension Optional: _Optional {
-    var isNil: Bool { return self == nil }
-}
-
-func isNil (_ input: Any) -> Bool {
-    return (input as? _Optional)?.isNil ?? false
-}
+@testable import ImproveAI
 
 //===----------------------------------------------------------------------===//
 // Plist Encoder
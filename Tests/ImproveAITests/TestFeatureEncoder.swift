@@ -6,6 +6,7 @@
 //
 
 import XCTest
+import utils
 @testable import ImproveAI
 
 final class TestFeatureEncoder: XCTestCase {
@@ -76,6 +77,123 @@ final class TestFeatureEncoder: XCTestCase {
         }
     }
     
+    // The JSON parser in utils has to encode the fixtures like the encoder does the decoded values
+    func testFeatureEncoder_json() throws {
+        let data = Bundle.stringContentOfFile(filename: "feature_encoder_test_suite.txt")
+        let allTestFileNames = data.components(separatedBy: "\n").filter { !$0.isEmpty }
+        
+        for filename in allTestFileNames {
+            let root = Bundle.dictFromFile(filename: filename)
+            let featureNames = root["feature_names"] as! [String]
+            let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: root["string_tables"] as! [String : [UInt64]], modelSeed: root["model_seed"] as! UInt32)
+            let noise = (root["noise"] as! NSNumber).doubleValue
+            let testcase = root["test_case"] as! [String : Any]
+            let item = testcase["item"]!
+            let context = testcase["context"]
+            
+            let itemsJSON = try JSONSerialization.data(withJSONObject: [item])
+            let contextJSON = try context.map { try JSONSerialization.data(withJSONObject: $0, options: .fragmentsAllowed) }
+            let features = try featureEncoder.encodeFeatureMatrix(itemsJSON: itemsJSON, contextJSON: contextJSON, noise: noise)
+            XCTAssertEqual(features.rowCount, 1, filename)
+            
+            // bit identical to encoding what JSONSerialization decodes from the same bytes
+            let items = try JSONSerialization.jsonObject(with: itemsJSON) as! [Any?]
+            let decodedContext = try contextJSON.map { try JSONSerialization.jsonObject(with: $0, options: .fragmentsAllowed) }
+            let contextVector = try featureEncoder.encodeContextVector(context: decodedContext, noise: noise)
+            let expected = try featureEncoder.encodeFeatureMatrix(items: items[...], contextVector: contextVector, noise: noise)
+            XCTAssertEqual(features.values.map { $0.bitPattern }, expected.values.map { $0.bitPattern }, filename)
+        }
+    }
+    
+    func testFeatureEncoder_json_errors() throws {
+        let featureEncoder = try FeatureEncoder(featureNames: ["item.a", "context"], stringTables: [:], modelSeed: 1)
+        for json in ["", "{}", "[1,]", "[{\"a\" 1}]", "[tru]", "[01]", "[\"\\ud800\"]", "[1] x"] {
+            XCTAssertThrowsError(try featureEncoder.encodeFeatureMatrix(itemsJSON: Data(json.utf8), contextJSON: nil, noise: 0), json)
+        }
+        XCTAssertThrowsError(try featureEncoder.encodeFeatureMatrix(itemsJSON: Data("[]".utf8), contextJSON: Data("{".utf8), noise: 0))
+        
+        let deep = String(repeating: "[", count: Int(JSON_MAX_DEPTH) + 1) + String(repeating: "]", count: Int(JSON_MAX_DEPTH) + 1)
+        XCTAssertThrowsError(try featureEncoder.encodeFeatureMatrix(itemsJSON: Data("[\(deep)]".utf8), contextJSON: nil, noise: 0))
+        
+        // a later value for a feature replaces an earlier string
+        let features = try featureEncoder.encodeFeatureMatrix(itemsJSON: Data("[{\"a\": \"x\", \"a\": 2}, {\"a\": 3, \"a\": \"y\"}]".utf8), contextJSON: Data("7".utf8), noise: 0)
+        XCTAssertEqual(Array(features.row(0)), [2, 7])
+        XCTAssertEqual(features.row(1).first, Float(StringTable(stringTable: [], modelSeed: 1).encode(string: "y")))
+        
+        // fractions and exponents are parsed with '.' even where the process locale writes 1,5
+        do {
+            let previous = String(cString: setlocale(LC_NUMERIC, nil)!)
+            defer { setlocale(LC_NUMERIC, previous) }
+            let _ = setlocale(LC_NUMERIC, "de_DE.UTF-8") ?? setlocale(LC_NUMERIC, "fr_FR.UTF-8")
+            
+            let fractions = try featureEncoder.encodeFeatureMatrix(itemsJSON: Data("[{\"a\": 1.5}, {\"a\": -2.5e-3}, {\"a\": 12345678901234567.5}]".utf8), contextJSON: Data("0.25".utf8), noise: 0)
+            XCTAssertEqual(Array(fractions.row(0)), [1.5, 0.25])
+            XCTAssertEqual(fractions.row(1).first, Float(-2.5e-3))
+            XCTAssertEqual(fractions.row(2).first, Float(12345678901234567.5))
+        }
+        
+        // strings for a model without features
+        let empty = try FeatureEncoder(featureNames: [], stringTables: [:], modelSeed: 1)
+        let emptyFeatures = try empty.encodeFeatureMatrix(itemsJSON: Data("[\"x\", {\"a\": \"y\"}]".utf8), contextJSON: Data("\"z\"".utf8), noise: 0)
+        XCTAssertEqual(emptyFeatures.rowCount, 2)
+        XCTAssertEqual(emptyFeatures.values.count, 0)
+    }
+    
+    func testFeatureEncoder_columns() throws {
+        let featureNames = ["item.a", "item.b.c", "item.s", "context"]
+        let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: ["item.s": [7, 1 << 40, 12345]], modelSeed: 9)
+        let strings = ["", "x", "hello", "a string longer than sixteen bytes", "é"]
+        let doubles = [0.5, Double.nan, -3, 0, 1e10]
+        let integers: [Int64] = [1, -2, 0, Int64.max, 42]
+        let columns: [FeatureColumn] = [
+            .double("a", doubles),
+            .int64("b.c", integers),
+            .strings("s", strings),
+            .double("unused", [1, 2, 3, 4, 5])
+        ]
+        
+        let contextVector = try featureEncoder.encodeContextVector(context: 2.5, noise: 0.3)
+        let features = try featureEncoder.encodeFeatureMatrix(columns: columns, contextVector: contextVector, noise: 0.3)
+        XCTAssertEqual(features.rowCount, 5)
+        
+        // bit identical to encoding the same items as dictionaries
+        let items: [Any?] = (0..<5).map { i in
+            var item: [String : Any] = ["b": ["c": NSNumber(value: integers[i])], "s": strings[i], "unused": i]
+            if !doubles[i].isNaN {
+                item["a"] = doubles[i]
+            }
+            return item
+        }
+        let expected = try featureEncoder.encodeFeatureMatrix(items: items[...], contextVector: contextVector, noise: 0.3)
+        XCTAssertEqual(features.values.map { $0.bitPattern }, expected.values.map { $0.bitPattern })
+        
+        // an empty path is the item itself
+        let plain = try FeatureEncoder(featureNames: ["item", "context"], stringTables: [:], modelSeed: 1)
+        let plainFeatures = try plain.encodeFeatureMatrix(columns: [.double("", [1, 2])], contextVector: [.nan, .nan], noise: 0)
+        XCTAssertEqual(plainFeatures.row(0).first, 1)
+        XCTAssertEqual(plainFeatures.row(1).first, 2)
+        XCTAssertTrue(plainFeatures.values[1].isNaN)
+        
+        XCTAssertThrowsError(try featureEncoder.encodeFeatureMatrix(columns: [.double("a", [1, 2]), .int64("b.c", [1])], contextVector: contextVector, noise: 0)) { error in
+            guard case ImproveAIError.invalidArgument = error else {
+                return XCTFail("\(error)")
+            }
+        }
+        // past the end, negative, decreasing, no offsets at all, on a path the model doesn't use
+        let invalidColumns: [FeatureColumn] = [.strings("s", bytes: [0x61], offsets: [0, 2]),
+                                               .strings("s", bytes: [0x61], offsets: [-1, 1]),
+                                               .strings("s", bytes: [0x61, 0x62], offsets: [0, 2, 1]),
+                                               .strings("s", bytes: [], offsets: []),
+                                               .strings("unused", bytes: [0x61], offsets: [1, 0])]
+        for column in invalidColumns {
+            XCTAssertThrowsError(try featureEncoder.encodeFeatureMatrix(columns: [column], contextVector: contextVector, noise: 0)) { error in
+                guard case ImproveAIError.invalidArgument = error else {
+                    return XCTFail("\(error)")
+                }
+            }
+        }
+    }
+    
     func testCollision() throws {
         let allTestFileNames = ["collisions_none_items_valid_context.json",
                          "collisions_valid_items_and_context.json",
@@ -114,4 +232,337 @@ final class TestFeatureEncoder: XCTestCase {
             }
         }
     }
+    
+    func testFeaturePathIndex() throws {
+        let featureNames = ["item", "item.a", "item.a.b", "item.a.0", "item.list.10", "item..x", "item.a.b.c", "context.a", "é.ü"]
+        let paths = FeaturePathIndex(featureNames: featureNames)
+        for (i, name) in featureNames.enumerated() {
+            XCTAssertEqual(paths.featureIndex(of: paths.node(name)), i, name)
+            XCTAssertEqual(paths.path(of: paths.node(name)), name)
+        }
+        
+        let item = paths.node("item")
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: item, key: "a")), 1)
+        // a key with dots resolves the same as the segments one at a time
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: item, key: "a.b")), 2)
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: paths.child(of: item, key: "a.b"), key: "c")), 6)
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: paths.child(of: item, key: "a"), index: 0)), 3)
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: paths.child(of: item, key: "list"), index: 10)), 4)
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: item, key: ".x")), 5)
+        XCTAssertEqual(paths.featureIndex(of: paths.child(of: paths.child(of: item, key: ""), key: "x")), 5)
+        
+        // prefixes that aren't features, and paths that don't exist
+        XCTAssertNil(paths.featureIndex(of: paths.child(of: item, key: "list")))
+        XCTAssertEqual(paths.child(of: paths.child(of: item, key: "list"), index: 1), FeaturePathIndex.missing)
+        XCTAssertEqual(paths.child(of: item, key: "b"), FeaturePathIndex.missing)
+        XCTAssertEqual(paths.child(of: paths.node("context"), key: "a.b"), FeaturePathIndex.missing)
+        XCTAssertEqual(paths.child(of: FeaturePathIndex.missing, key: "a"), FeaturePathIndex.missing)
+        XCTAssertFalse(featureNames.contains { $0.hasPrefix(paths.unmatchedPath) })
+    }
+    
+    func testPerfectHashTable() throws {
+        for count in [0, 1, 2, 3, 5, 100, 20000] {
+            var map: [UInt64 : Double] = [:]
+            while map.count < count {
+                map[UInt64.random(in: 0...(UInt64(count) * 4))] = Double.random(in: -1...1)
+            }
+            let table = PerfectHashTable(map)
+            for key in UInt64(0)...(UInt64(count) * 4 + 1) {
+                XCTAssertEqual(table.value(for: key), map[key])
+            }
+            XCTAssertNil(table.value(for: UInt64.max))
+        }
+    }
+    
+    func testStringCache() throws {
+        let table = StringTable(stringTable: [1, 2, 3, 0x1234_5678], modelSeed: 7)
+        XCTAssertNil(table.cache)
+        let cached = table.caching(capacity: 4)
+        for string in ["a", "b", "a", "b", "c", "a", "d", "", "é"] {
+            XCTAssertEqual(cached.encode(string: string).bitPattern, table.encode(string: string).bitPattern, string)
+        }
+        // "d" drops "b" while "a", hit in the older generation, survives; "é" then drops "c" and "a"
+        let statistics = cached.cache!.statistics
+        XCTAssertEqual(statistics.hits, 3)
+        XCTAssertEqual(statistics.misses, 6)
+        XCTAssertEqual(statistics.evictions, 3)
+        XCTAssertEqual(statistics.count, 3)
+        XCTAssertEqual(statistics.hitRate, 3.0 / 9.0)
+    }
+    
+    func testContextCache() throws {
+        let featureNames = ["context.a", "context.b.0", "context.b.1", "context.s", "context.nested.a", "context.nested.s", "context"]
+        let encoder = try FeatureEncoder(featureNames: featureNames, stringTables: ["context.s": [1, 2, 3]], modelSeed: 3)
+        let cached = encoder.cachingContexts(capacity: 16)
+        XCTAssertNil(encoder.contextCacheStatistics)
+        
+        let contexts: [Any?] = [
+            ["a": 1.5, "b": [2, -0.0], "s": "x"],
+            ["s": "x", "b": [2, -0.0], "a": 1.5],
+            ["a": 1.5, "b": [2, 0.0], "s": "x"],
+            ["nested": Nested(a: 3, s: "y", flag: true)],
+            "context",
+            7,
+            nil
+        ]
+        for noise in [0.0, 0.3, 0.9] {
+            for context in contexts {
+                let expected = try encoder.encodeContextVector(context: context, noise: noise)
+                let vector = try cached.encodeContextVector(context: context, noise: noise)
+                XCTAssertEqual(vector.map { $0.bitPattern }, expected.map { $0.bitPattern }, "\(String(describing: context))")
+            }
+        }
+        // the reordered dictionary hits the first one's row, -0.0 and 0.0 are different contexts
+        let statistics = cached.contextCacheStatistics!
+        XCTAssertEqual(statistics.misses, 6)
+        XCTAssertEqual(statistics.hits, 15)
+        XCTAssertEqual(statistics.count, 6)
+        
+        XCTAssertEqual(FeatureEncoder.fingerprint(["a": 1, "b": 2]), FeatureEncoder.fingerprint(["b": 2, "a": 1]))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(["a": 1]), FeatureEncoder.fingerprint(["a": "1"]))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint([1, 2]), FeatureEncoder.fingerprint([2, 1]))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(["a": [1]]), FeatureEncoder.fingerprint(["a": 1]))
+    }
+    
+    // Encodables stream through FingerprintEncoder, which has to tell apart whatever encodes differently
+    func testFingerprint_encodable() throws {
+        let nested = Nested(a: 3, s: "y", flag: true)
+        XCTAssertNotNil(FeatureEncoder.fingerprint(nested))
+        XCTAssertEqual(FeatureEncoder.fingerprint(nested), FeatureEncoder.fingerprint(Nested(a: 3, s: "y", flag: true)))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(nested), FeatureEncoder.fingerprint(Nested(a: 3, s: "y", flag: false)))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(nested), FeatureEncoder.fingerprint(Nested(a: 3, s: "", flag: true)))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(Nested(a: 0, s: "", flag: true)), FeatureEncoder.fingerprint(Nested(a: -0.0, s: "", flag: true)))
+        
+        // the same values in other containers
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(Pair(a: Pair(a: 1, b: 2), b: 3)), FeatureEncoder.fingerprint(Pair(a: 1, b: Pair(a: 2, b: 3))))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(Pair(a: [1, 2], b: [3])), FeatureEncoder.fingerprint(Pair(a: [1], b: [2, 3])))
+        XCTAssertNotEqual(FeatureEncoder.fingerprint(Pair(a: "ab", b: "c")), FeatureEncoder.fingerprint(Pair(a: "a", b: "bc")))
+        
+        // nil doesn't take up an index, so these encode the same
+        XCTAssertEqual(FeatureEncoder.fingerprint(Pair(a: [1, nil, 3] as [Double?], b: 0)), FeatureEncoder.fingerprint(Pair(a: [1, 3] as [Double?], b: 0)))
+        
+        // what fails to encode has no fingerprint
+        XCTAssertNil(FeatureEncoder.fingerprint(Dated(date: Date())))
+        XCTAssertNil(FeatureEncoder.fingerprint(Empty()))
+        
+        // a fingerprint taken while streaming another one
+        XCTAssertEqual(FeatureEncoder.fingerprint(Fingerprinting(value: nested)), FeatureEncoder.fingerprint(Pair(a: 3.0, b: FeatureEncoder.fingerprint(nested)!)))
+    }
+    
+    func testItemCache() throws {
+        let featureNames = ["item.a", "item.s", "item", "context"]
+        let encoder = try FeatureEncoder(featureNames: featureNames, stringTables: ["item.s": [5, 6]], modelSeed: 11)
+        let items: [Any?] = [["a": 1.5, "s": "x"], ["s": "y"], 3, "z", nil, ["a": 1.5, "s": "x"]]
+        let contextVector = try encoder.encodeContextVector(context: 2, noise: 0.4)
+        let expected = try encoder.encodeSparseFeatures(items: items[...], contextVector: contextVector, noise: 0.4).dense()
+        
+        let cached = encoder.cachingItems(maxBytes: 1 << 20)
+        for _ in 0..<2 {
+            let features = try cached.encodeSparseFeatures(items: items[...], contextVector: contextVector, noise: 0.4).dense()
+            XCTAssertEqual(features.values.map { $0.bitPattern }, expected.values.map { $0.bitPattern })
+        }
+        // the last item has the same content as the first
+        var statistics = cached.itemCacheStatistics!
+        XCTAssertEqual(statistics.misses, 5)
+        XCTAssertEqual(statistics.hits, 7)
+        
+        // ids take the place of the content, even when it differs
+        let byId = encoder.cachingItems(maxBytes: 1 << 20)
+        let ids: [AnyHashable] = [1, 2, 3, 4, 5, 1]
+        let features = try byId.encodeSparseFeatures(items: items[...], ids: ids[...], contextVector: contextVector, noise: 0.4).dense()
+        XCTAssertEqual(features.values.map { $0.bitPattern }, expected.values.map { $0.bitPattern })
+        let changed: [Any?] = [4]
+        let sameIds: [AnyHashable] = [1]
+        let stale = try byId.encodeSparseFeatures(items: changed[...], ids: sameIds[...], contextVector: contextVector, noise: 0.4).dense()
+        XCTAssertEqual(Array(stale.row(0)).map { $0.bitPattern }, Array(expected.row(0)).map { $0.bitPattern })
+        
+        // a budget smaller than a row still caches the last item
+        let tiny = encoder.cachingItems(maxBytes: 16)
+        for _ in 0..<2 {
+            let features = try tiny.encodeSparseFeatures(items: items[...], contextVector: contextVector, noise: 0.4).dense()
+            XCTAssertEqual(features.values.map { $0.bitPattern }, expected.values.map { $0.bitPattern })
+        }
+        statistics = tiny.itemCacheStatistics!
+        XCTAssertGreaterThan(statistics.evictions, 0)
+        XCTAssertLessThanOrEqual(statistics.count, 2)
+        XCTAssertLessThanOrEqual(tiny.itemCache!.bytes, 2 * ItemCache.Row(indexes: [0, 1], values: [0, 0]).bytes)
+    }
+    
+    func testXXH3Batch() throws {
+        let strings = ["", "a", "brand", "category", "en-US", "a string longer than sixteen bytes", "é", "x", "yz"] + (0..<100).map { "\($0)" }
+        var bytes: [UInt8] = []
+        var offsets = [0]
+        for string in strings {
+            bytes.append(contentsOf: Array(string.utf8))
+            offsets.append(bytes.count)
+        }
+        let seed: UInt64 = 0x1234_5678_9abc
+        var hashes = [UInt64](repeating: 0, count: strings.count)
+        xxh3_64_batch(bytes, offsets, strings.count, seed, &hashes)
+        let table = StringTable(stringTable: [], modelSeed: 0)
+        for (string, hash) in zip(strings, hashes) {
+            XCTAssertEqual(hash, table.xxhash3(string, seed), string)
+        }
+    }
+    
+    // The vector lanes and the scalar tail have to round like the Swift expression
+    func testFeatureSprinkle() throws {
+        let x: [Double] = [0, -0.0, 1, -1.5, .nan, 1e300, -1e-300, .infinity, 3.14159, .nan, 0.1, 1e10, 7, .nan, 2]
+        let base: [Float] = (0..<x.count).map { Float($0) + 0.5 }
+        let shift = Double(Float(0.7 * pow(2, -142))), scale = Double(Float(1 + 0.7 * pow(2, -17)))
+        
+        for count in 0...x.count {
+            var out = [Float](repeating: 0, count: count)
+            feature_sprinkle(x, count, shift, scale, base, &out)
+            var missing = [Float](repeating: 0, count: count)
+            feature_sprinkle(x, count, shift, scale, nil, &missing)
+            for i in 0..<count {
+                let expected = Float((x[i] + shift) * scale)
+                if x[i].isNaN {
+                    XCTAssertEqual(out[i], base[i])
+                    XCTAssertTrue(missing[i].isNaN)
+                } else {
+                    XCTAssertEqual(out[i].bitPattern, expected.bitPattern, "\(x[i])")
+                    XCTAssertEqual(missing[i].bitPattern, expected.bitPattern, "\(x[i])")
+                }
+            }
+        }
+        
+        let matrix = FeatureMatrix(rowCount: 3, repeating: [1, .nan, 2])
+        XCTAssertEqual(Array(matrix.row(2)).map { $0.bitPattern }, [1, Float.nan, 2].map { $0.bitPattern })
+    }
+        
+    struct Nested: Encodable {
+        let a: Double
+        let s: String
+        let flag: Bool
+    }
+    
+    struct Root: Encodable {
+        let x: Int
+        let f: Float
+        let u: UInt8
+        let opt: Double?
+        let list: [Double?]
+        let strings: [String]
+        let nested: Nested
+        let nestedOpt: Nested?
+        let nestedList: [Nested]
+    }
+    
+    struct Dated: Encodable {
+        let date: Date
+    }
+    
+    struct Pair<A: Encodable, B: Encodable>: Encodable {
+        let a: A
+        let b: B
+    }
+    
+    // encodes the fingerprint of value as b, taking it in the middle of its own
+    struct Fingerprinting: Encodable {
+        let value: Nested
+        
+        enum CodingKeys: String, CodingKey {
+            case a, b
+        }
+        
+        func encode(to encoder: Encoder) throws {
+            var container = encoder.container(keyedBy: CodingKeys.self)
+            try container.encode(value.a, forKey: .a)
+            try container.encode(FeatureEncoder.fingerprint(value)!, forKey: .b)
+        }
+    }
+    
+    struct Empty: Encodable {
+        func encode(to encoder: Encoder) throws {}
+    }
+    
+    func testEncodeEncodable_matchesPList() throws {
+        let featureNames = ["item.x", "item.f", "item.u", "item.opt", "item.list.0", "item.list.1", "item.list.2",
+                            "item.strings.0", "item.strings.1", "item.nested.a", "item.nested.s", "item.nested.flag",
+                            "item.nestedOpt.a", "item.nestedList.0.a", "item.nestedList.1.s", "item.nestedList.1.flag"]
+        let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: [:], modelSeed: 1)
+        
+        let items = [
+            Root(x: 3, f: 0.1, u: 255, opt: nil, list: [1, nil, 3], strings: ["a", "b"],
+                 nested: Nested(a: .nan, s: "s", flag: true), nestedOpt: nil,
+                 nestedList: [Nested(a: -1, s: "", flag: false), Nested(a: 2, s: "x", flag: true)]),
+            Root(x: -7, f: .infinity, u: 0, opt: 0.5, list: [nil, nil, 2.5], strings: [],
+                 nested: Nested(a: 1e300, s: "long string value", flag: false), nestedOpt: Nested(a: 4, s: "y", flag: true),
+                 nestedList: [])
+        ]
+        for noise in [0.0, 0.25] {
+            let (noiseShift, noiseScale) = (Float(noise * pow(2, -142)), Float(1 + noise * pow(2, -17)))
+            for item in items {
+                var direct = Array(repeating: Double.nan, count: featureNames.count)
+                var plist = Array(repeating: Double.nan, count: featureNames.count)
+                try featureEncoder.encodeEncodable(encodable: item, path: "item", into: &direct, noiseShift: noiseShift, noiseScale: noiseScale)
+                try featureEncoder.encodeEncodableWithPList(encodable: item, path: "item", into: &plist, noiseShift: noiseShift, noiseScale: noiseScale)
+                for i in 0..<featureNames.count {
+                    XCTAssertEqual(direct[i].bitPattern, plist[i].bitPattern, featureNames[i])
+                }
+            }
+        }
+    }
+    
+    // Items of one type whose shapes differ go through the recorded plan, its revisions and the
+    // string path fallback, all of which have to match the plist path
+    func testEncodeEncodable_plan() throws {
+        let featureNames = ["item.x", "item.opt", "item.list.0", "item.list.1", "item.list.2", "item.list.3",
+                            "item.nested.a", "item.nestedOpt.a", "item.nestedOpt.s", "item.nestedList.1.flag"]
+        let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: [:], modelSeed: 1)
+        
+        let nested = Nested(a: 1, s: "a", flag: true)
+        var items: [Root] = []
+        for i in 0..<40 {
+            items.append(Root(x: i, f: 1, u: 1, opt: i % 3 == 0 ? nil : Double(i),
+                              list: (0..<(i % 5)).map { $0 % 2 == 0 ? Double($0) : nil }, strings: [],
+                              nested: nested, nestedOpt: i % 4 == 0 ? nil : Nested(a: Double(i), s: "\(i)", flag: false),
+                              nestedList: Array(repeating: nested, count: i % 3)))
+        }
+        for _ in 0..<2 {
+            for item in items {
+                var direct = Array(repeating: Double.nan, count: featureNames.count)
+                var plist = Array(repeating: Double.nan, count: featureNames.count)
+                try featureEncoder.encodeEncodable(encodable: item, path: "item", into: &direct, noiseShift: 0, noiseScale: 1)
+                try featureEncoder.encodeEncodableWithPList(encodable: item, path: "item", into: &plist, noiseShift: 0, noiseScale: 1)
+                for i in 0..<featureNames.count {
+                    XCTAssertEqual(direct[i].bitPattern, plist[i].bitPattern, featureNames[i])
+                }
+            }
+        }
+        
+        let cached = featureEncoder.plans.plan(for: Root.self, path: "item")
+        XCTAssertNotNil(cached)
+        XCTAssertLessThanOrEqual(cached!.revision, EncodingPlanCache.maxRevisions)
+        XCTAssertEqual(cached!.plan.featureIndex, nil)
+        var position = 0
+        XCTAssertEqual(cached!.plan.child(forKey: "x", position: &position)?.featureIndex, 0)
+    }
+    
+    func testEncodeEncodable_errors() throws {
+        let featureEncoder = try FeatureEncoder(featureNames: ["item.date"], stringTables: [:], modelSeed: 1)
+        var into = [Double.nan]
+        XCTAssertThrowsError(try featureEncoder.encodeEncodable(encodable: Dated(date: Date()), path: "item", into: &into, noiseShift: 0, noiseScale: 1)) { error in
+            guard case ImproveAIError.typeNotSupported = error else {
+                return XCTFail("unexpected error \(error)")
+            }
+        }
+        XCTAssertThrowsError(try featureEncoder.encodeEncodable(encodable: Empty(), path: "item", into: &into, noiseShift: 0, noiseScale: 1)) { error in
+            XCTAssertTrue(error is EncodingError)
+        }
+        // a nil top-level value encodes nothing
+        let none: Dated? = nil
+        try featureEncoder.encodeEncodable(encodable: none, path: "item", into: &into, noiseShift: 0, noiseScale: 1)
+        XCTAssertTrue(into[0].isNaN)
+    }
+}
+
+extension FeatureEncoder {
+    // The property list round trip encodeEncodable did before FeatureVectorEncoder, which it has to match
+    func encodeEncodableWithPList<T: Encodable, V: FeatureStorage>(encodable: T, path: String, into: inout V, noiseShift: Float, noiseScale: Float) throws {
+        let obj = try PListEncoder().encode(encodable)
+        try encode(obj: obj, path: path, into: &into, noiseShift: noiseShift, noiseScale: noiseScale)
+    }
 }
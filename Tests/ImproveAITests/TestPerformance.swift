@@ -0,0 +1,270 @@
+//
+//  TestPerformance.swift
+//
+//
+//  Created on 2023/7/31.
+//
+
+import XCTest
+import utils
+import MallocCounter
+@testable import ImproveAI
+
+final class TestPerformance: XCTestCase {
+    static let numericItemsModels = [
+        "1000_numeric_items_20_same_nested_context_large_binary_reward",
+        "1000_numeric_items_no_context_small_binary_reward"
+    ]
+    
+    override func setUpWithError() throws {
+        // Put setup code here. This method is called before the invocation of each test method in the class.
+    }
+
+    override func tearDownWithError() throws {
+        // Put teardown code here. This method is called after the invocation of each test method in the class.
+    }
+    
+    // The plain node by node traversal, the baseline for QuickScorer and the SIMD kernel
+    func testPerformance_nodeWalk_1000_numeric_items() throws {
+        try measurePredict(models: Self.numericItemsModels, quickScorer: false, nodeWalk: true)
+    }
+    
+    func testPerformance_native_1000_numeric_items() throws {
+        try measurePredict(models: Self.numericItemsModels, quickScorer: false)
+    }
+    
+    func testPerformance_quickScorer_1000_numeric_items() throws {
+        try measurePredict(models: Self.numericItemsModels, quickScorer: true)
+    }
+    
+    func testPerformance_native_1000_list_of_numeric_items() throws {
+        try measurePredict(models: ["1000_list_of_numeric_items_20_same_nested_context_binary_reward"], quickScorer: false)
+    }
+    
+    // Scores from 1 up to one thread per core through a single shared Scorer and prints the
+    // throughput. With no lock around scoring it should grow close to linearly with threads.
+    func testPerformance_concurrent_scoring() throws {
+        let name = "1000_numeric_items_20_same_nested_context_large_binary_reward"
+        let root = Bundle.dictFromFile(filename: "\(name).json")
+        let testcase = root["test_case"] as! [String : Any]
+        let items = Array((testcase["candidates"] as! [Any]).prefix(100))
+        let context = (testcase["contexts"] as! [Any]).first
+        
+        let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        
+        let callsPerThread = 50
+        var threadCounts = [1]
+        while threadCounts.last! * 2 <= ProcessInfo.processInfo.activeProcessorCount {
+            threadCounts.append(threadCounts.last! * 2)
+        }
+        if threadCounts.last! < ProcessInfo.processInfo.activeProcessorCount {
+            threadCounts.append(ProcessInfo.processInfo.activeProcessorCount)
+        }
+        
+        var baseline = 0.0
+        for threadCount in threadCounts {
+            let start = DispatchTime.now().uptimeNanoseconds
+            DispatchQueue.concurrentPerform(iterations: threadCount) { _ in
+                for _ in 0..<callsPerThread {
+                    let _ = try! scorer.scoreInternal(items: items, context: context, noise: 0)
+                }
+            }
+            let seconds = Double(DispatchTime.now().uptimeNanoseconds - start) / 1e9
+            let throughput = Double(threadCount * callsPerThread) / seconds
+            if threadCount == 1 {
+                baseline = throughput
+            }
+            print("\(threadCount) threads: \(Int(throughput)) calls/s, \(String(format: "%.2f", throughput / baseline))x")
+        }
+    }
+    
+    func testPerformance_threadCount_10000_numeric_items() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_no_context_small_binary_reward.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        let items = (0..<10000).map { _ in Double.random(in: -1...1) }
+        let threadCount = ProcessInfo.processInfo.activeProcessorCount
+        
+        measure {
+            let _ = try! scorer.score(items, threadCount: threadCount)
+        }
+    }
+    
+    struct EncodableItem: Encodable {
+        let id: Int
+        let price: Double
+        let name: String
+        let tags: [String]
+        let dimensions: [Double]
+    }
+    
+    static let encodableItems = (0..<1000).map {
+        EncodableItem(id: $0, price: Double($0) * 0.99, name: "item \($0)", tags: ["a", "b", "\($0 % 7)"], dimensions: [1, 2, Double($0)])
+    }
+    
+    static func encodableFeatureNames(path: String) -> [String] {
+        return ["id", "price", "name", "tags.0", "tags.1", "tags.2", "dimensions.0", "dimensions.1", "dimensions.2"].map { "\(path).\($0)" }
+    }
+    
+    func testPerformance_encodeEncodable_direct() throws {
+        try measureEncodeEncodable(plist: false)
+    }
+    
+    func testPerformance_encodeEncodable_plist() throws {
+        try measureEncodeEncodable(plist: true)
+    }
+    
+    // Compare the two to see the cost of the property list round trip in time,
+    // testPerformance_encodeEncodable_allocations counts what it allocates
+    func measureEncodeEncodable(plist: Bool) throws {
+        let featureNames = Self.encodableFeatureNames(path: "item")
+        let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: [:], modelSeed: 1)
+        let block = {
+            for item in Self.encodableItems {
+                var into = Array(repeating: Double.nan, count: featureNames.count)
+                if plist {
+                    try! featureEncoder.encodeEncodableWithPList(encodable: item, path: "item", into: &into, noiseShift: 0, noiseScale: 1)
+                } else {
+                    try! featureEncoder.encodeEncodable(encodable: item, path: "item", into: &into, noiseShift: 0, noiseScale: 1)
+                }
+            }
+        }
+        measure(block)
+    }
+    
+    // Counts the calls to malloc of both paths over the same items. Peak memory doesn't show the
+    // boxed values of the property list round trip, each is freed soon after it's allocated.
+    func testPerformance_encodeEncodable_allocations() throws {
+        try XCTSkipIf(malloc_counter_available() == 0, "malloc calls aren't counted on this platform")
+        let featureNames = Self.encodableFeatureNames(path: "item")
+        let featureEncoder = try FeatureEncoder(featureNames: featureNames, stringTables: [:], modelSeed: 1)
+        var into = Array(repeating: Double.nan, count: featureNames.count)
+        
+        func encode(_ item: EncodableItem, plist: Bool) {
+            for i in into.indices {
+                into[i] = Double.nan
+            }
+            if plist {
+                try! featureEncoder.encodeEncodableWithPList(encodable: item, path: "item", into: &into, noiseShift: 0, noiseScale: 1)
+            } else {
+                try! featureEncoder.encodeEncodable(encodable: item, path: "item", into: &into, noiseShift: 0, noiseScale: 1)
+            }
+        }
+        
+        func allocations(plist: Bool) -> UInt64 {
+            // records the encoding plan first, which is allocated once per type
+            encode(Self.encodableItems[0], plist: plist)
+            malloc_counter_start()
+            for item in Self.encodableItems {
+                encode(item, plist: plist)
+            }
+            return malloc_counter_stop()
+        }
+        
+        let plist = allocations(plist: true)
+        let direct = allocations(plist: false)
+        let itemCount = Double(Self.encodableItems.count)
+        print("allocations per item, plist: \(Double(plist) / itemCount), direct: \(Double(direct) / itemCount), \(String(format: "%.1f", Double(plist) / Double(max(direct, 1))))x fewer")
+        // the property list boxes every value, the direct path allocates only for its containers
+        XCTAssertLessThan(direct * 2, plist)
+    }
+    
+    func testPerformance_encodeContext_uncached() throws {
+        try measureEncodeContext(cached: false)
+    }
+    
+    func testPerformance_encodeContext_cacheHit() throws {
+        try measureEncodeContext(cached: true)
+    }
+    
+    // Compare the two to see what a hit saves, a hit only takes the fingerprint of the Encodable
+    // context and copies its cached row
+    func measureEncodeContext(cached: Bool) throws {
+        var featureEncoder = try FeatureEncoder(featureNames: Self.encodableFeatureNames(path: "context"), stringTables: [:], modelSeed: 1)
+        if cached {
+            featureEncoder = featureEncoder.cachingContexts(capacity: 64)
+        }
+        let contexts = Array(Self.encodableItems.prefix(16))
+        // the measured calls all hit
+        for context in contexts {
+            let _ = try featureEncoder.encodeContextVector(context: context, noise: 0)
+        }
+        measure {
+            for _ in 0..<100 {
+                for context in contexts {
+                    let _ = try! featureEncoder.encodeContextVector(context: context, noise: 0.5)
+                }
+            }
+        }
+        if cached {
+            XCTAssertEqual(featureEncoder.contextCacheStatistics!.misses, contexts.count)
+        }
+    }
+    
+    func testPerformance_encodeItems_uncached() throws {
+        try measureEncodeItems(cached: false, ids: false)
+    }
+    
+    func testPerformance_encodeItems_cacheHit_ids() throws {
+        try measureEncodeItems(cached: true, ids: true)
+    }
+    
+    func testPerformance_encodeItems_cacheHit_fingerprints() throws {
+        try measureEncodeItems(cached: true, ids: false)
+    }
+    
+    // Compare the three to see what a hit saves when items are looked up by the ids the caller
+    // gives them and when they're looked up by the fingerprint of their contents
+    func measureEncodeItems(cached: Bool, ids: Bool) throws {
+        var featureEncoder = try FeatureEncoder(featureNames: Self.encodableFeatureNames(path: "item"), stringTables: [:], modelSeed: 1)
+        if cached {
+            featureEncoder = featureEncoder.cachingItems(maxBytes: 16 << 20)
+        }
+        let items = Self.encodableItems.map { $0 as Any? }[...]
+        let itemIds: ArraySlice<AnyHashable>? = ids ? Self.encodableItems.map { AnyHashable($0.id) }[...] : nil
+        let contextVector = try featureEncoder.encodeContextVector(context: nil, noise: 0.5)
+        // the measured calls all hit
+        let _ = try featureEncoder.encodeSparseFeatures(items: items, ids: itemIds, contextVector: contextVector, noise: 0.5)
+        measure {
+            let _ = try! featureEncoder.encodeSparseFeatures(items: items, ids: itemIds, contextVector: contextVector, noise: 0.5)
+        }
+        if cached {
+            XCTAssertEqual(featureEncoder.itemCacheStatistics!.misses, items.count)
+        }
+    }
+    
+    // Encodes the test case once, then measures prediction alone. nodeWalk calls tree_ensemble_predict
+    // instead of the predictor, after the same narrowing to Float32.
+    func measurePredict(models: [String], quickScorer: Bool, nodeWalk: Bool = false) throws {
+        var predictors: [TreeEnsemblePredictor] = []
+        var batches: [[[Double]]] = []
+        for name in models {
+            let root = Bundle.dictFromFile(filename: "\(name).json")
+            let testcase = root["test_case"] as! [String : Any]
+            let items = testcase["candidates"] as! [Any]
+            let context = (testcase["contexts"] as! [Any]).first
+            let noise = (testcase["noise"] as! NSNumber).doubleValue
+            
+            let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+            let predictor = try TreeEnsemblePredictor(modelUrl: modelUrl, quickScorer: quickScorer)
+            let metadata = try ModelMetadata(from: predictor.metadata)
+            let featureEncoder = try FeatureEncoder(featureNames: predictor.featureNames, stringTables: metadata.stringTables, modelSeed: metadata.seed)
+            predictors.append(predictor)
+            batches.append(try featureEncoder.encodeFeatureVectors(items: items, context: context, noise: noise))
+        }
+        
+        measure {
+            for _ in 0..<10 {
+                for i in 0..<predictors.count {
+                    if nodeWalk {
+                        let features = FeatureMatrix(featureVectors: batches[i], featureCount: predictors[i].featureNames.count)
+                        var scores = [Double](repeating: 0, count: features.rowCount)
+                        tree_ensemble_predict(predictors[i].model, features.values, features.rowCount, &scores)
+                    } else {
+                        let _ = try! predictors[i].predict(featureVectors: batches[i])
+                    }
+                }
+            }
+        }
+    }
+}
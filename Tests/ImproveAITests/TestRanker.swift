@@ -97,4 +97,62 @@ final class TestRanker: XCTestCase {
             XCTAssertTrue(ranked[i] > ranked[i+1])
         }
     }
+    
+    func testRankTopK_allScored() throws {
+        let variants = Array(-100...100).shuffled()
+        let scored = variants.enumerated().map { (index: $0.offset, score: Double($0.element)) }
+        
+        XCTAssertEqual(Array((91...100).reversed()), Ranker.rank_top_k(items: variants, scored: scored, topK: 10))
+        XCTAssertEqual(Array((-100...100).reversed()), Ranker.rank_top_k(items: variants, scored: scored, topK: 1000))
+        XCTAssertEqual([], Ranker.rank_top_k(items: variants, scored: scored, topK: 0))
+        
+        for _ in 0..<100 {
+            // with ties
+            let scores = variants.map { _ in Double(Int.random(in: 0..<20)) }
+            let scored = scores.enumerated().map { (index: $0.offset, score: $0.element) }
+            let topK = Int.random(in: 1...variants.count)
+            let expected = Ranker.rank_with_score(items: variants, scores: scores).prefix(topK).map { scores[variants.firstIndex(of: $0)!] }
+            let ranked = Ranker.rank_top_k(items: variants, scored: scored, topK: topK).map { scores[variants.firstIndex(of: $0)!] }
+            XCTAssertEqual(expected, ranked)
+        }
+    }
+    
+    func testRankTopKWithScores() throws {
+        let variants = Array(0...200)
+        // only the scored subset takes part in the ranking
+        let scored = variants.shuffled().prefix(50).map { (index: $0, score: Double($0)) }
+        let best = scored.map { $0.index }.sorted(by: >)
+        
+        let ranked = Ranker.rank_top_k(items: variants, scored: scored, topK: 10)
+        XCTAssertEqual(Array(best.prefix(10)), ranked)
+        XCTAssertEqual(best, Ranker.rank_top_k(items: variants, scored: scored, topK: 100))
+    }
+    
+    func testRank_topK_native() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_no_context_small_binary_reward.mlmodel.gz", withExtension: nil)!
+        let ranker = Ranker(scorer: try Scorer(modelUrl: modelUrl, backend: .native))
+        let items = (0..<1000).map { _ in Double.random(in: -1...1) }
+        XCTAssertEqual(10, ranker.rank(items, topK: 10).count)
+        XCTAssertEqual(10, ranker.rank(items, context: 99, topK: 10).count)
+        XCTAssertEqual(1000, ranker.rank(items, topK: 2000).count)
+        XCTAssertEqual(0, ranker.rank(items, topK: 0).count)
+        
+        // the path rank(_:topK:) takes, with fixed noise, against a full ranking of the same scores
+        let noise = 0.5
+        let predictor = ranker.scorer.predictor
+        let metadata = try ModelMetadata(from: predictor.metadata)
+        let featureEncoder = try FeatureEncoder(featureNames: predictor.featureNames, stringTables: metadata.stringTables, modelSeed: metadata.seed)
+        let contextVector = try featureEncoder.encodeContextVector(context: nil, noise: noise)
+        let features = try featureEncoder.encodeFeatureMatrix(items: (items as [Any?])[...], contextVector: contextVector, noise: noise)
+        let scores = try predictor.predict(features: features)
+        let expected = Array(scores.sorted(by: >).prefix(10))
+        
+        let scored = try ranker.scorer.scoreTopK(items: items, topK: 10, noise: noise)
+        let ranked = Ranker.rank_top_k(items: items, scored: scored, topK: 10)
+        XCTAssertEqual(10, ranked.count)
+        for (item, score) in zip(ranked, expected) {
+            // items that tie may trade places, only the tie breaking noise differs
+            XCTAssertEqual(scores[items.firstIndex(of: item)!], score, accuracy: pow(2, -22))
+        }
+    }
 }
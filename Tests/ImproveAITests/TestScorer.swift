@@ -6,6 +6,8 @@
 //
 
 import XCTest
+import utils
+import CompiledModelFixtures
 @testable import ImproveAI
 
 final class TestScorer: XCTestCase {
@@ -84,7 +86,192 @@ final class TestScorer: XCTestCase {
         }
     }
     
-    func verifyModel(name: String) throws {
+    func testValidateModels_native() throws {
+        continueAfterFailure = false
+        let data = Bundle.stringContentOfFile(filename: "model_test_suite.txt")
+        let testcases = data.components(separatedBy: "\n").filter { !$0.isEmpty }
+        XCTAssertGreaterThan(testcases.count, 0)
+        
+        for testcase in testcases {
+            print("verifying \(testcase) with the native backend...")
+            try verifyModel(name: testcase, backend: .native)
+        }
+    }
+    
+    func testScore_native_encodable_items() throws {
+        let candidate = Candidate(a: 0.0, b: B(x: [0, 1.0, 2], y: false, z: ["value": "abc"]), c: nil)
+        let context = ["value": "A"]
+        
+        let modelUrl = Bundle.test.url(forResource: "0_and_nan.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        let scores = try scorer.scoreInternal(items: [candidate], context: context, noise: 0)
+        XCTAssertEqual(scores[0], 2.9701548276917342, accuracy: 0.000001)
+    }
+    
+    func testSIMDMatchesNodeWalk() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_list_of_numeric_items_20_same_nested_context_binary_reward.mlmodel.gz", withExtension: nil)!
+        let predictor = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        let featureCount = predictor.featureNames.count
+        
+        // odd row count to cover both the vector blocks and the scalar tail
+        let rowCount = 1001
+        var rows = [Float](repeating: 0, count: rowCount * featureCount)
+        var columns = [Float](repeating: 0, count: rowCount * featureCount)
+        for row in 0..<rowCount {
+            for i in 0..<featureCount {
+                let value: Float = Int.random(in: 0..<10) == 0 ? Float.nan : Float.random(in: -3...3)
+                rows[row * featureCount + i] = value
+                columns[i * rowCount + row] = value
+            }
+        }
+        
+        var expected = [Double](repeating: 0, count: rowCount)
+        tree_ensemble_predict(predictor.model, rows, rowCount, &expected)
+        
+        // every kernel this CPU can run, not only the one it picks
+        var simd: UnsafeMutablePointer<tree_simd_t>?
+        let status = tree_simd_build(predictor.model, &simd)
+        XCTAssertEqual(0, status)
+        defer { tree_simd_free(simd) }
+        for level in TREE_SIMD_SCALAR...tree_simd_level() {
+            simd!.pointee.level = level
+            var scores = [Double](repeating: 0, count: rowCount)
+            tree_simd_predict(simd, columns, rowCount, &scores)
+            XCTAssertEqual(expected, scores, "level \(level)")
+        }
+    }
+    
+    // Tests/CompiledModelFixtures was generated with
+    // improve-compile 2_nested_dict_items_20_random_nested_dict_context_large_binary_reward.mlmodel.gz nested_dict_items Tests/CompiledModelFixtures
+    func testCompiledModel() throws {
+        let name = "2_nested_dict_items_20_random_nested_dict_context_large_binary_reward"
+        let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+        let predictor = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        let compiled = try CompiledModelPredictor(model: nested_dict_items)
+        XCTAssertEqual(predictor.featureNames, compiled.featureNames)
+        XCTAssertEqual(predictor.metadata, compiled.metadata)
+        
+        let featureCount = predictor.featureNames.count
+        let rowCount = 1001
+        let rows: [Float] = (0..<rowCount * featureCount).map { _ in Int.random(in: 0..<10) == 0 ? Float.nan : Float.random(in: -3...3) }
+        var expected = [Double](repeating: 0, count: rowCount)
+        var scores = [Double](repeating: 0, count: rowCount)
+        tree_ensemble_predict(predictor.model, rows, rowCount, &expected)
+        nested_dict_items.score(rows, rowCount, &scores)
+        XCTAssertEqual(expected, scores)
+        
+        try verifyModel(name: name, scorer: try Scorer(compiledModel: nested_dict_items))
+    }
+    
+    func testValidateModels_contextPruning() throws {
+        continueAfterFailure = false
+        let data = Bundle.stringContentOfFile(filename: "model_test_suite.txt")
+        let testcases = data.components(separatedBy: "\n").filter { !$0.isEmpty }
+        XCTAssertGreaterThan(testcases.count, 0)
+        
+        for testcase in testcases {
+            print("verifying \(testcase) with context pruning...")
+            try verifyModel(name: testcase, backend: .contextPruning)
+        }
+    }
+    
+    func testContextPruningMatchesNative() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let native = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        let pruning = try TreeEnsemblePredictor(modelUrl: modelUrl, contextPruning: true)
+        let contextFeatures = pruning.contextFeatures!
+        XCTAssertTrue(contextFeatures.contains(1))
+        
+        // rows share the context features and differ in the item features
+        let rowCount = TreeEnsemblePredictor.contextPruningMinRows * 3 + 1
+        let context = contextFeatures.map { _ in Int.random(in: 0..<10) == 0 ? Double.nan : Double.random(in: -3...3) }
+        let featureVectors = (0..<rowCount).map { _ in
+            (0..<context.count).map { i in contextFeatures[i] == 1 ? context[i] : Double.random(in: -3...3) }
+        }
+        XCTAssertEqual(try native.predict(featureVectors: featureVectors), try pruning.predict(featureVectors: featureVectors))
+    }
+    
+    func testTopKMatchesPredict() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let predictor = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        let featureVectors = (0..<2000).map { _ in
+            predictor.featureNames.map { _ in Int.random(in: 0..<10) == 0 ? Double.nan : Double.random(in: -3...3) }
+        }
+        let expected = try predictor.predict(featureVectors: featureVectors)
+        
+        for k in [1, 5, 20, 100] {
+            let margin = pow(2, -23)
+            let scored = try predictor.predictTopK(featureVectors: featureVectors, k: k, margin: margin)
+            XCTAssertLessThan(scored.count, featureVectors.count)
+            for (index, score) in scored {
+                XCTAssertEqual(expected[index], score)
+            }
+            // everything within margin of the k-th best survives
+            let kth = expected.sorted(by: >)[k - 1]
+            let survivors = Set(scored.map { $0.index })
+            for (index, score) in expected.enumerated() where score >= kth - margin {
+                XCTAssertTrue(survivors.contains(index))
+            }
+        }
+    }
+    
+    // The Float32 matrix and sparse paths have to produce the same bits as narrowing the Double feature vectors
+    func testFeatureMatrixMatchesFeatureVectors() throws {
+        let data = Bundle.stringContentOfFile(filename: "model_test_suite.txt")
+        let names = data.components(separatedBy: "\n").filter { !$0.isEmpty }
+        XCTAssertGreaterThan(names.count, 0)
+        
+        for name in names {
+            let root = Bundle.dictFromFile(filename: "\(name).json")
+            let testcase = root["test_case"] as! [String : Any]
+            let items = testcase["candidates"] as! [Any?]
+            let contexts = testcase["contexts"] as! [Any]
+            let noise = (testcase["noise"] as! NSNumber).doubleValue
+            
+            let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+            let predictors = [try TreeEnsemblePredictor(modelUrl: modelUrl),
+                              try TreeEnsemblePredictor(modelUrl: modelUrl, quickScorer: true),
+                              try TreeEnsemblePredictor(modelUrl: modelUrl, contextPruning: true)]
+            let metadata = try ModelMetadata(from: predictors[0].metadata)
+            let featureEncoder = try FeatureEncoder(featureNames: predictors[0].featureNames, stringTables: metadata.stringTables, modelSeed: metadata.seed)
+            
+            for context in contexts {
+                let contextVector = try featureEncoder.encodeContextVector(context: context, noise: noise)
+                let featureVectors = try featureEncoder.encodeFeatureVectors(items: items[...], contextVector: contextVector, noise: noise)
+                let features = try featureEncoder.encodeFeatureMatrix(items: items[...], contextVector: contextVector, noise: noise)
+                XCTAssertEqual(features.rowCount, items.count)
+                XCTAssertEqual(features.values.map { $0.bitPattern }, featureVectors.flatMap { $0.map { Float($0).bitPattern } })
+                
+                let sparseFeatures = try featureEncoder.encodeSparseFeatures(items: items[...], contextVector: contextVector, noise: noise)
+                XCTAssertEqual(sparseFeatures.rowCount, items.count)
+                XCTAssertEqual(sparseFeatures.dense().values.map { $0.bitPattern }, features.values.map { $0.bitPattern })
+                var rows: [Float] = []
+                try sparseFeatures.forEachRow { _, row in rows.append(contentsOf: row) }
+                XCTAssertEqual(rows.map { $0.bitPattern }, features.values.map { $0.bitPattern })
+                
+                for predictor in predictors {
+                    let expected = try predictor.predict(featureVectors: featureVectors)
+                    XCTAssertEqual(try predictor.predict(features: features).map { $0.bitPattern }, expected.map { $0.bitPattern }, name)
+                    XCTAssertEqual(try predictor.predict(sparseFeatures: sparseFeatures).map { $0.bitPattern }, expected.map { $0.bitPattern }, name)
+                    
+                    let k = max(1, items.count / 8)
+                    let topK = try predictor.predictTopK(features: features, k: k, margin: 0)
+                    for (index, score) in topK {
+                        XCTAssertEqual(score.bitPattern, expected[index].bitPattern, name)
+                    }
+                    // nothing that scores at least the k-th best may be left out
+                    let kth = expected.sorted(by: >)[k - 1]
+                    let returned = Set(topK.map { $0.index })
+                    for (index, score) in expected.enumerated() where score >= kth {
+                        XCTAssertTrue(returned.contains(index), "\(name) dropped item \(index) scoring \(score), k-th best \(kth)")
+                    }
+                }
+            }
+        }
+    }
+    
+    func testScore_concurrent_native() throws {
+        let name = "2_numeric_items_100_random_nested_dict_context_binary_reward"
         let root = Bundle.dictFromFile(filename: "\(name).json")
         let testcase = root["test_case"] as! [String : Any]
         let items = testcase["candidates"] as! [Any]
@@ -93,7 +280,277 @@ final class TestScorer: XCTestCase {
         let noise = (testcase["noise"] as! NSNumber).doubleValue
         
         let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
-        let scorer = try Scorer(modelUrl: modelUrl)
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        
+        // one Scorer shared by all threads, each scoring every context
+        let mismatches = UnsafeMutablePointer<Int>.allocate(capacity: 8)
+        mismatches.initialize(repeating: 0, count: 8)
+        defer { mismatches.deallocate() }
+        DispatchQueue.concurrentPerform(iterations: 8) { thread in
+            for i in 0..<contexts.count {
+                let expected = (outputs[i] as! [String : Any])["scores"] as! [Double]
+                let scores = try! scorer.scoreInternal(items: items, context: contexts[i], noise: noise)
+                mismatches[thread] += zip(expected, scores).filter { abs($0 - $1) > 0.000004 }.count
+            }
+        }
+        XCTAssertEqual(0, (0..<8).reduce(0) { $0 + mismatches[$1] })
+    }
+    
+    func testScore_batching() throws {
+        let name = "2_numeric_items_100_random_nested_dict_context_binary_reward"
+        let root = Bundle.dictFromFile(filename: "\(name).json")
+        let testcase = root["test_case"] as! [String : Any]
+        let items = testcase["candidates"] as! [Any]
+        let contexts = testcase["contexts"] as! [Any]
+        let outputs = root["expected_output"] as! [Any]
+        let noise = (testcase["noise"] as! NSNumber).doubleValue
+        
+        let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native).batching(maxDelay: 0.01, maxItems: 1000)
+        
+        // dedicated threads so calls overlap even on a single core
+        let threadCount = 8
+        let group = DispatchGroup()
+        let mismatches = UnsafeMutablePointer<Int>.allocate(capacity: threadCount)
+        mismatches.initialize(repeating: 0, count: threadCount)
+        defer { mismatches.deallocate() }
+        for thread in 0..<threadCount {
+            group.enter()
+            Thread {
+                for i in 0..<contexts.count {
+                    let expected = (outputs[i] as! [String : Any])["scores"] as! [Double]
+                    let scores = try! scorer.scoreInternal(items: items, context: contexts[i], noise: noise)
+                    mismatches[thread] += zip(expected, scores).filter { abs($0 - $1) > 0.000004 }.count
+                }
+                group.leave()
+            }.start()
+        }
+        group.wait()
+        XCTAssertEqual(0, (0..<threadCount).reduce(0) { $0 + mismatches[$1] })
+        
+        let batchCount = (scorer.predictor as! BatchingPredictor).batchCount
+        print("\(threadCount * contexts.count) calls in \(batchCount) batches")
+        XCTAssertLessThan(batchCount, threadCount * contexts.count)
+    }
+    
+    // Calls with different contexts may overlap but must not share a pruned batch
+    func testBatching_contextPruning() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let native = try TreeEnsemblePredictor(modelUrl: modelUrl)
+        let pruning = try TreeEnsemblePredictor(modelUrl: modelUrl, contextPruning: true)
+        let contextFeatures = pruning.contextFeatures!
+        
+        // together the calls are big enough to prune, and the leader waits for both of them
+        let rowCount = TreeEnsemblePredictor.contextPruningMinRows
+        let batching = BatchingPredictor(predictor: pruning, maxDelay: 10, maxItems: rowCount * 2)
+        let requests: [FeatureMatrix] = (0..<2).map { _ in
+            let context = contextFeatures.map { _ in Double.random(in: -3...3) }
+            let featureVectors = (0..<rowCount).map { _ in
+                (0..<context.count).map { i in contextFeatures[i] == 1 ? context[i] : Double.random(in: -3...3) }
+            }
+            return FeatureMatrix(featureVectors: featureVectors, featureCount: context.count)
+        }
+        
+        let group = DispatchGroup()
+        var results = [[Double]](repeating: [], count: requests.count)
+        let lock = NSLock()
+        for (i, request) in requests.enumerated() {
+            group.enter()
+            Thread {
+                let scores = try! batching.predict(features: request)
+                lock.lock()
+                results[i] = scores
+                lock.unlock()
+                group.leave()
+            }.start()
+        }
+        group.wait()
+        
+        XCTAssertEqual(1, batching.batchCount)
+        for (i, request) in requests.enumerated() {
+            XCTAssertEqual(try native.predict(features: request), results[i])
+        }
+    }
+    
+    func testScore_threadCount_matches_serial() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        // not a multiple of the chunk size
+        let items: [Any] = (0..<(Scorer.parallelChunkSize * 5 + 7)).map { _ in Double.random(in: -3...3) }
+        let context = ["a": 1.5, "b": -2]
+        
+        let serial = try scorer.scoreInternal(items: items, context: context, noise: 0.5)
+        let parallel = try scorer.scoreInternal(items: items, context: context, noise: 0.5, threadCount: 4)
+        XCTAssertEqual(serial.count, parallel.count)
+        for i in 0..<serial.count {
+            // only the tie breaking noise differs
+            XCTAssertEqual(serial[i], parallel[i], accuracy: pow(2, -22))
+        }
+    }
+    
+    func testScore_json() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        let items: [Any] = (0..<100).map { _ in Double.random(in: -3...3) }
+        let context = ["a": 1.5, "b": -2]
+        
+        let itemsJSON = try JSONSerialization.data(withJSONObject: items)
+        let contextJSON = try JSONSerialization.data(withJSONObject: context)
+        let scores = try scorer.scoreInternal(itemsJSON: itemsJSON, contextJSON: contextJSON, noise: 0.5)
+        let expected = try scorer.scoreInternal(items: JSONSerialization.jsonObject(with: itemsJSON) as! [Any], context: JSONSerialization.jsonObject(with: contextJSON), noise: 0.5)
+        XCTAssertEqual(scores.count, expected.count)
+        for i in 0..<scores.count {
+            // only the tie breaking noise differs
+            XCTAssertEqual(scores[i], expected[i], accuracy: pow(2, -22))
+        }
+        
+        XCTAssertThrowsError(try scorer.score(itemsJSON: Data("[]".utf8))) { error in
+            guard case ImproveAIError.emptyVariants = error else {
+                return XCTFail("\(error)")
+            }
+        }
+    }
+    
+    func testScore_itemCache() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .native)
+        let cached = scorer.cachingItems().cachingContexts()
+        let items: [Any] = (0..<100).map { _ in Double.random(in: -3...3) }
+        let context = ["a": 1.5, "b": -2]
+        
+        let expected = try scorer.scoreInternal(items: items, context: context, noise: 0.5)
+        for _ in 0..<3 {
+            let scores = try cached.scoreInternal(items: items, context: context, noise: 0.5)
+            for i in 0..<scores.count {
+                // only the tie breaking noise differs
+                XCTAssertEqual(scores[i], expected[i], accuracy: pow(2, -22))
+            }
+        }
+        XCTAssertEqual(cached.itemCacheStatistics!.misses, Set(items.map { $0 as! Double }).count)
+        XCTAssertEqual(cached.contextCacheStatistics!.hits, 2)
+        
+        XCTAssertThrowsError(try cached.score([1.0, 2.0], ids: ["a"])) { error in
+            guard case ImproveAIError.invalidArgument = error else {
+                return XCTFail("\(error)")
+            }
+        }
+    }
+    
+    // Once a thread has scored a request of a given size its scratch arena stops calling malloc
+    func testScore_arenaSteadyState() throws {
+        let modelUrl = Bundle.test.url(forResource: "1000_numeric_items_20_same_nested_context_large_binary_reward.mlmodel.gz", withExtension: nil)!
+        let scorer = try Scorer(modelUrl: modelUrl, backend: .contextPruning)
+        let items: [Any] = (0..<(TreeEnsemblePredictor.contextPruningMinRows * 8)).map { _ in Double.random(in: -3...3) }
+        let context = ["a": 1.5, "b": -2]
+        
+        for _ in 0..<3 {
+            _ = try scorer.scoreInternal(items: items, context: context, noise: 0.5)
+            _ = try scorer.scoreTopK(items: items, context: context, topK: 3, noise: 0.5)
+        }
+        let warm = ScratchBuffer.current.arenaStats
+        for _ in 0..<20 {
+            _ = try scorer.scoreInternal(items: items, context: context, noise: 0.5)
+            _ = try scorer.scoreTopK(items: items, context: context, topK: 3, noise: 0.5)
+        }
+        let stats = ScratchBuffer.current.arenaStats
+        XCTAssertGreaterThan(stats.allocations, warm.allocations)
+        XCTAssertGreaterThan(stats.resets, warm.resets)
+        XCTAssertEqual(stats.system_allocations, warm.system_allocations)
+        XCTAssertEqual(stats.system_frees, warm.system_frees)
+        XCTAssertEqual(stats.used, 0)
+    }
+    
+    #if canImport(CoreML)
+    func testFeatureProvider() throws {
+        let schema = FeatureSchema(names: ["a", "b", "c"])
+        let features = FeatureMatrix(featureVectors: [[1, 2, 3], [4, Double.nan, 6.1]], featureCount: 3)
+        let providers = (0..<features.rowCount).map { FeatureProvider(features: features, row: $0, schema: schema) }
+        for (r, provider) in providers.enumerated() {
+            XCTAssertEqual(provider.featureNames, ["a", "b", "c"])
+            for (i, name) in schema.names.enumerated() {
+                let value = provider.featureValue(for: name)!.doubleValue
+                XCTAssertEqual(value.bitPattern, Double(features.values[r * 3 + i]).bitPattern)
+            }
+            XCTAssertNil(provider.featureValue(for: "d"))
+        }
+    }
+    #endif
+    
+    func testInvalidModel_native() throws {
+        let modelUrl = Bundle.test.url(forResource: "feature_names.txt", withExtension: nil)!
+        do {
+            let _ = try Scorer(modelUrl: modelUrl, backend: .native)
+            XCTFail("expecting .invalidModel error")
+        } catch {
+            if case .invalidModel = (error as! ImproveAIError) {
+            } else {
+                XCTFail("expecting .invalidModel error")
+            }
+        }
+    }
+    
+    // A chain of branches whose true and false children are both the next node, every path through
+    // it reaches the leaf, 2^depth paths in all, while the model has only depth + 1 nodes.
+    func testInvalidModel_sharedNode() throws {
+        let depth = 8
+        let nodes = (0..<depth).map { i in TreeEnsembleBytes.branch(tree: 0, node: i, feature: 0, value: 0.5, trueChild: i + 1, falseChild: i + 1) }
+        let data = TreeEnsembleBytes.model(featureCount: 1, nodes: nodes + [TreeEnsembleBytes.leaf(tree: 0, node: depth, value: 1)])
+        
+        var model: UnsafeMutablePointer<tree_ensemble_t>?
+        let status = data.withUnsafeBufferPointer { tree_ensemble_load($0.baseAddress, $0.count, &model) }
+        XCTAssertEqual(ERR_TE_INVALID_MODEL, status)
+        XCTAssertNil(model)
+    }
+    
+    // A tree with more leaves than fit in a bitvector between two others. The leaf values are chosen
+    // so that the sum depends on the order the trees are added in.
+    func testQuickScorerFallbackTreeOrder() throws {
+        let featureCount = 4
+        var nodes = [TreeEnsembleBytes.branch(tree: 0, node: 0, feature: 0, value: 0, trueChild: 1, falseChild: 2),
+                     TreeEnsembleBytes.leaf(tree: 0, node: 1, value: 1e16),
+                     TreeEnsembleBytes.leaf(tree: 0, node: 2, value: 1e16)]
+        // complete, 2 * QUICKSCORER_MAX_LEAVES leaves
+        let branchCount = Int(QUICKSCORER_MAX_LEAVES) * 2 - 1
+        nodes += (0..<branchCount).map { i in
+            TreeEnsembleBytes.branch(tree: 1, node: i, feature: i % featureCount, value: 0, trueChild: 2 * i + 1, falseChild: 2 * i + 2)
+        }
+        nodes += (branchCount..<branchCount * 2 + 1).map { i in TreeEnsembleBytes.leaf(tree: 1, node: i, value: 1) }
+        nodes += [TreeEnsembleBytes.branch(tree: 2, node: 0, feature: 1, value: 0, trueChild: 1, falseChild: 2),
+                  TreeEnsembleBytes.leaf(tree: 2, node: 1, value: -1e16),
+                  TreeEnsembleBytes.leaf(tree: 2, node: 2, value: -1e16)]
+        let data = TreeEnsembleBytes.model(featureCount: featureCount, nodes: nodes)
+        
+        var model: UnsafeMutablePointer<tree_ensemble_t>?
+        let status = data.withUnsafeBufferPointer { tree_ensemble_load($0.baseAddress, $0.count, &model) }
+        XCTAssertEqual(0, status)
+        defer { tree_ensemble_free(model) }
+        var quickScorer: UnsafeMutablePointer<quickscorer_t>?
+        let built = quickscorer_build(model, &quickScorer)
+        XCTAssertEqual(0, built)
+        defer { quickscorer_free(quickScorer) }
+        XCTAssertEqual(1, quickScorer!.pointee.fallback_count)
+        
+        let rowCount = 100
+        let rows: [Float] = (0..<rowCount * featureCount).map { _ in Int.random(in: 0..<10) == 0 ? Float.nan : Float.random(in: -3...3) }
+        var expected = [Double](repeating: 0, count: rowCount)
+        var scores = [Double](repeating: 0, count: rowCount)
+        tree_ensemble_predict(model, rows, rowCount, &expected)
+        quickscorer_predict(quickScorer, rows, rowCount, &scores)
+        XCTAssertEqual(expected.map { $0.bitPattern }, scores.map { $0.bitPattern })
+    }
+    
+    func verifyModel(name: String, backend: Scorer.Backend = .coreML) throws {
+        let modelUrl = Bundle.test.url(forResource: "\(name).mlmodel.gz", withExtension: nil)!
+        try verifyModel(name: name, scorer: try Scorer(modelUrl: modelUrl, backend: backend))
+    }
+    
+    func verifyModel(name: String, scorer: Scorer) throws {
+        let root = Bundle.dictFromFile(filename: "\(name).json")
+        let testcase = root["test_case"] as! [String : Any]
+        let items = testcase["candidates"] as! [Any]
+        let contexts = testcase["contexts"] as! [Any]
+        let outputs = root["expected_output"] as! [Any]
+        let noise = (testcase["noise"] as! NSNumber).doubleValue
         
         XCTAssertGreaterThan(contexts.count, 0)
         
@@ -111,6 +568,45 @@ final class TestScorer: XCTestCase {
     }
 }
 
+// Serialized CoreML tree ensemble regressors, for models the synthetic ones don't have
+fileprivate enum TreeEnsembleBytes {
+    static func varint(_ v: UInt64) -> [UInt8] {
+        var v = v
+        var bytes: [UInt8] = []
+        while v >= 0x80 {
+            bytes.append(UInt8(v & 0x7f) | 0x80)
+            v >>= 7
+        }
+        return bytes + [UInt8(v)]
+    }
+    
+    static func field(_ number: UInt64, _ value: Int) -> [UInt8] {
+        return varint(number << 3) + varint(UInt64(value))
+    }
+    
+    static func field(_ number: UInt64, _ value: Double) -> [UInt8] {
+        return varint(number << 3 | 1) + withUnsafeBytes(of: value.bitPattern.littleEndian, Array.init)
+    }
+    
+    static func field(_ number: UInt64, _ message: [UInt8]) -> [UInt8] {
+        return varint(number << 3 | 2) + varint(UInt64(message.count)) + message
+    }
+    
+    // x[feature] <= value goes to trueChild
+    static func branch(tree: Int, node: Int, feature: Int, value: Double, trueChild: Int, falseChild: Int) -> [UInt8] {
+        return field(1, field(1, tree) + field(2, node) + field(3, 0) + field(10, feature) + field(11, value) + field(12, trueChild) + field(13, falseChild))
+    }
+    
+    static func leaf(tree: Int, node: Int, value: Double) -> [UInt8] {
+        return field(1, field(1, tree) + field(2, node) + field(3, 6) + field(20, field(1, 0) + field(2, value)))
+    }
+    
+    static func model(featureCount: Int, nodes: [[UInt8]]) -> [UInt8] {
+        let inputs = (0..<featureCount).flatMap { field(1, field(1, Array("f\($0)".utf8))) }
+        return field(2, inputs) + field(302, field(1, nodes.flatMap { $0 }))
+    }
+}
+
 struct Candidate: Encodable {
     let a: Double
     let b: B
@@ -0,0 +1,30 @@
+//
+//  malloc_counter.h
+//
+//
+//  Created on 2023/12/22.
+//
+
+#ifndef malloc_counter_h
+#define malloc_counter_h
+
+#include <stdint.h>
+
+/*
+ Counts calls to malloc, calloc and realloc, from every thread, between
+ malloc_counter_start and malloc_counter_stop. For the allocation benchmarks,
+ peak memory doesn't show allocations that are freed right away.
+
+ On glibc the test binary defines malloc, calloc and realloc, forwarding to
+ the __libc_ ones. On Apple platforms start swaps counting functions into the
+ default malloc zone and stop swaps the originals back. Elsewhere nothing is
+ counted and malloc_counter_available returns 0.
+ */
+int malloc_counter_available(void);
+
+void malloc_counter_start(void);
+
+// Allocations since malloc_counter_start
+uint64_t malloc_counter_stop(void);
+
+#endif /* malloc_counter_h */
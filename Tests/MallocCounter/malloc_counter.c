@@ -0,0 +1,127 @@
+//
+//  malloc_counter.c
+//
+//
+//  Created on 2023/12/22.
+//
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#endif
+
+#include "malloc_counter.h"
+
+static atomic_int counting;
+
+static atomic_uint_fast64_t allocations;
+
+static inline void count(void) {
+    if (atomic_load_explicit(&counting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    }
+}
+
+#if defined(__GLIBC__)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+    count();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count_, size_t size) {
+    count();
+    return __libc_calloc(count_, size);
+}
+
+void *realloc(void *p, size_t size) {
+    count();
+    return __libc_realloc(p, size);
+}
+
+int malloc_counter_available(void) {
+    return 1;
+}
+
+static void install(int on) {
+    (void)on;
+}
+
+#elif defined(__APPLE__)
+
+static void *(*original_malloc)(malloc_zone_t *zone, size_t size);
+static void *(*original_calloc)(malloc_zone_t *zone, size_t count, size_t size);
+static void *(*original_realloc)(malloc_zone_t *zone, void *p, size_t size);
+
+static void *counting_malloc(malloc_zone_t *zone, size_t size) {
+    count();
+    return original_malloc(zone, size);
+}
+
+static void *counting_calloc(malloc_zone_t *zone, size_t count_, size_t size) {
+    count();
+    return original_calloc(zone, count_, size);
+}
+
+static void *counting_realloc(malloc_zone_t *zone, void *p, size_t size) {
+    count();
+    return original_realloc(zone, p, size);
+}
+
+int malloc_counter_available(void) {
+    return 1;
+}
+
+static void install(int on) {
+    malloc_zone_t *zone = malloc_default_zone();
+    // zones are read only from version 8
+    if (zone->version >= 8) {
+        vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+    }
+    if (on) {
+        original_malloc = zone->malloc;
+        original_calloc = zone->calloc;
+        original_realloc = zone->realloc;
+        zone->malloc = counting_malloc;
+        zone->calloc = counting_calloc;
+        zone->realloc = counting_realloc;
+    } else {
+        zone->malloc = original_malloc;
+        zone->calloc = original_calloc;
+        zone->realloc = original_realloc;
+    }
+    if (zone->version >= 8) {
+        vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+    }
+}
+
+#else
+
+int malloc_counter_available(void) {
+    return 0;
+}
+
+static void install(int on) {
+    (void)on;
+}
+
+#endif
+
+void malloc_counter_start(void) {
+    atomic_store(&allocations, 0);
+    install(1);
+    atomic_store(&counting, 1);
+}
+
+uint64_t malloc_counter_stop(void) {
+    atomic_store(&counting, 0);
+    install(0);
+    return atomic_load(&allocations);
+}